@@ -0,0 +1,196 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <charconv>
+#include <stdexcept>
+
+#include "acmacs-base/read-file.hh"
+#include "seqdb/align-cache.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+static constexpr const char* ALIGN_CACHE_VERSION = "seqdb-align-cache-v3";
+
+static std::vector<std::string_view> split(std::string_view aSource, char aSeparator);
+template <typename T> static T to_number(std::string_view aSource, int aBase = 10);
+
+// ----------------------------------------------------------------------
+
+AlignCache& seqdb::align_cache()
+{
+    static AlignCache cache;
+    return cache;
+
+} // seqdb::align_cache
+
+// ----------------------------------------------------------------------
+
+  // first line: version and alignment table version (hex), then for each sequence:
+  // high and low halves of hash (hex), size, shift, offset, aa_begin, aa_size, subtype, lineage, gene separated by tabs
+void AlignCache::open(std::string_view aFilename)
+{
+    std::unique_lock<std::shared_mutex> lock(mAccess);
+    mFilename = aFilename;
+    mData.clear();
+    mModified = false;
+    if (!acmacs::file::exists(mFilename))
+        return;
+    const std::string source = acmacs::file::read(mFilename);
+    const auto lines = split(source, '\n');
+    if (lines.empty())
+        return;
+    if (const auto header = split(lines.front(), '\t'); header.size() != 2 || header[0] != ALIGN_CACHE_VERSION || to_number<uint64_t>(header[1], 16) != alignment_table_version()) {
+        std::cerr << "INFO: alignment cache " << mFilename << " was made by a different version of the aligner, ignored\n";
+        return;
+    }
+    mData.reserve(lines.size());
+    for (auto line = std::next(lines.begin()); line != lines.end(); ++line) {
+        if (line->empty())
+            continue;
+        const auto fields = split(*line, '\t');
+        if (fields.size() != 10)
+            throw std::runtime_error("AlignCache: cannot parse line in " + mFilename + ": \"" + std::string{*line} + "\"");
+        mData.emplace(key_t{hash128_t{to_number<uint64_t>(fields[0], 16), to_number<uint64_t>(fields[1], 16)}, to_number<size_t>(fields[2])},
+                      value_t{to_number<Shift::ShiftT>(fields[3]), to_number<int>(fields[4]), to_number<size_t>(fields[5]), to_number<size_t>(fields[6]), std::string{fields[7]}, std::string{fields[8]}, std::string{fields[9]}});
+    }
+
+} // AlignCache::open
+
+// ----------------------------------------------------------------------
+
+void AlignCache::save() const
+{
+    std::shared_lock<std::shared_mutex> lock(mAccess);
+    if (!enabled() || !mModified)
+        return;
+      // sorted by key to make file independent of the order sequences were aligned in
+    std::vector<const std::pair<const key_t, value_t>*> sorted(mData.size());
+    std::transform(mData.begin(), mData.end(), sorted.begin(), [](const auto& en) { return &en; });
+    std::sort(sorted.begin(), sorted.end(), [](const auto* e1, const auto* e2) { return e1->first < e2->first; });
+
+    std::ostringstream os;
+    os << ALIGN_CACHE_VERSION << '\t' << std::hex << alignment_table_version() << std::dec << '\n';
+    for (const auto* en : sorted) {
+        const auto& [key, value] = *en;
+        os << std::hex << key.hash.high << '\t' << key.hash.low << std::dec << '\t' << key.size << '\t' << value.shift << '\t' << value.offset << '\t' << value.aa_begin << '\t' << value.aa_size << '\t'
+           << value.subtype << '\t' << value.lineage << '\t' << value.gene << '\n';
+    }
+    acmacs::file::write(mFilename, os.str());
+
+} // AlignCache::save
+
+// ----------------------------------------------------------------------
+
+AlignAminoAcidsData AlignCache::translate_and_align(std::string_view aNucleotides, Messages& aMessages, std::string_view aName)
+{
+    if (!enabled())
+        return seqdb::translate_and_align(aNucleotides, aMessages, aName);
+
+    const auto key = make_key('n', aNucleotides);
+    Messages translation_messages;
+    if (const auto* cached = find(key); cached) {
+        AlignAminoAcidsData result(AlignData(cached->subtype, cached->lineage, cached->gene, cached->shift), std::string{}, cached->offset);
+        if (cached->aa_size > 0)
+            result.amino_acids = translate_nucleotides_to_amino_acids(aNucleotides, static_cast<size_t>(cached->offset), translation_messages).substr(cached->aa_begin, cached->aa_size);
+        return result;
+    }
+
+    auto result = seqdb::translate_and_align(aNucleotides, aMessages, aName);
+    size_t aa_begin = 0;
+    if (!result.amino_acids.empty()) {
+          // amino_acids is either the whole translation or its longest part between stop codons
+        aa_begin = translate_nucleotides_to_amino_acids(aNucleotides, static_cast<size_t>(result.offset), translation_messages).find(result.amino_acids);
+        if (aa_begin == std::string::npos)
+            return result;      // unexpected, do not cache
+    }
+    add(key, {result.shift.raw(), result.offset, aa_begin, result.amino_acids.size(), result.subtype, result.lineage, result.gene});
+    return result;
+
+} // AlignCache::translate_and_align
+
+// ----------------------------------------------------------------------
+
+AlignAminoAcidsData AlignCache::align_amino_acids(std::string_view aAminoAcids, Messages& aMessages)
+{
+    if (!enabled())
+        return seqdb::align_amino_acids(aAminoAcids, aMessages);
+
+    const auto key = make_key('a', aAminoAcids);
+    if (const auto* cached = find(key); cached)
+        return AlignAminoAcidsData(AlignData(cached->subtype, cached->lineage, cached->gene, cached->shift));
+
+    auto result = seqdb::align_amino_acids(aAminoAcids, aMessages);
+    add(key, {result.shift.raw(), 0, 0, 0, result.subtype, result.lineage, result.gene});
+    return result;
+
+} // AlignCache::align_amino_acids
+
+// ----------------------------------------------------------------------
+
+const AlignCache::value_t* AlignCache::find(const key_t& aKey) const
+{
+    std::shared_lock<std::shared_mutex> lock(mAccess);
+      // pointers to elements of unordered_map stay valid when other elements are inserted
+    if (const auto found = mData.find(aKey); found != mData.end()) {
+        ++mHits;
+        return &found->second;
+    }
+    ++mMisses;
+    return nullptr;
+
+} // AlignCache::find
+
+// ----------------------------------------------------------------------
+
+void AlignCache::add(const key_t& aKey, value_t&& aValue)
+{
+    std::unique_lock<std::shared_mutex> lock(mAccess);
+    mData.emplace(aKey, std::move(aValue));
+    mModified = true;
+
+} // AlignCache::add
+
+// ----------------------------------------------------------------------
+
+std::string AlignCache::report() const
+{
+    std::shared_lock<std::shared_mutex> lock(mAccess);
+    std::ostringstream os;
+    os << "alignment cache " << mFilename << ": " << mData.size() << " sequences, hits: " << mHits << ", misses: " << mMisses;
+    return os.str();
+
+} // AlignCache::report
+
+// ----------------------------------------------------------------------
+
+std::vector<std::string_view> split(std::string_view aSource, char aSeparator)
+{
+    std::vector<std::string_view> result;
+    for (size_t start = 0; start <= aSource.size(); ) {
+        const auto end = std::min(aSource.find(aSeparator, start), aSource.size());
+        result.push_back(aSource.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+
+} // split
+
+// ----------------------------------------------------------------------
+
+template <typename T> T to_number(std::string_view aSource, int aBase)
+{
+    T result{};
+    if (const auto [end, ec] = std::from_chars(aSource.data(), aSource.data() + aSource.size(), result, aBase); ec != std::errc{} || end != (aSource.data() + aSource.size()))
+        throw std::runtime_error("AlignCache: invalid number: \"" + std::string{aSource} + "\"");
+    return result;
+
+} // to_number
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "seqdb/amino-acids.hh"
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+      // Changes whenever ALIGN_RAW_DATA or the alignment algorithm changes (amino-acids.cc),
+      // cached alignment results made with another version are not used.
+    uint64_t alignment_table_version();
+
+      // 64-bit FNV-1a
+    inline uint64_t fnv1a_hash(std::string_view aData, uint64_t aHash = 0xcbf29ce484222325ULL)
+    {
+        for (const char symbol : aData) {
+            aHash ^= static_cast<unsigned char>(symbol);
+            aHash *= 0x100000001b3ULL;
+        }
+        return aHash;
+    }
+
+      // 128-bit FNV-1a, prime is 2^88 + 0x13b, hash is multiplied by it in two 64-bit halves
+    struct hash128_t
+    {
+        uint64_t high = 0x6c62272e07bb0142ULL;
+        uint64_t low = 0x62b821756295c58dULL;
+
+        bool operator==(const hash128_t& aNother) const { return high == aNother.high && low == aNother.low; }
+        bool operator<(const hash128_t& aNother) const { return high == aNother.high ? low < aNother.low : high < aNother.high; }
+    };
+
+    inline hash128_t fnv1a_hash_128(std::string_view aData, hash128_t aHash = {})
+    {
+        for (const char symbol : aData) {
+            aHash.low ^= static_cast<unsigned char>(symbol);
+            const uint64_t low_low = (aHash.low & 0xFFFFFFFFULL) * 0x13bULL, low_high = (aHash.low >> 32) * 0x13bULL;
+            const uint64_t carry = (low_high + (low_low >> 32)) >> 32;
+            aHash.high = aHash.high * 0x13bULL + (aHash.low << 24) + carry;
+            aHash.low = low_low + (low_high << 32);
+        }
+        return aHash;
+    }
+
+// ----------------------------------------------------------------------
+
+      // Results of translate_and_align() and align_amino_acids() keyed by a 128-bit hash and the size of the
+      // raw sequence (the sequence itself is not stored), kept in a file between runs, so rebuilding seqdb from
+      // fasta does not align again sequences seen before. Translation of nucleotides is not stored, it is made again for the offset found
+      // (much cheaper than alignment). Messages produced by alignment are not stored either.
+      // Disabled (calls are just forwarded) until open() is called. Safe to use from several threads.
+    class AlignCache
+    {
+     public:
+          // reads aFilename if it exists and was made with the current alignment_table_version(),
+          // save() writes to aFilename
+        void open(std::string_view aFilename);
+        void save() const;      // if anything was added since open()
+        bool enabled() const { return !mFilename.empty(); }
+
+        AlignAminoAcidsData translate_and_align(std::string_view aNucleotides, Messages& aMessages, std::string_view aName);
+        AlignAminoAcidsData align_amino_acids(std::string_view aAminoAcids, Messages& aMessages);
+
+        std::string report() const;
+
+     private:
+        struct key_t
+        {
+            hash128_t hash;
+            size_t size;
+
+            bool operator==(const key_t& aNother) const { return hash == aNother.hash && size == aNother.size; }
+            bool operator<(const key_t& aNother) const { return hash == aNother.hash ? size < aNother.size : hash < aNother.hash; }
+        };
+
+        struct key_hash_t
+        {
+            size_t operator()(const key_t& aKey) const { return static_cast<size_t>(aKey.hash.low); }
+        };
+
+        struct value_t
+        {
+            Shift::ShiftT shift;
+            int offset;
+              // part of the translation with offset stored in AlignAminoAcidsData::amino_acids
+            size_t aa_begin;
+            size_t aa_size;
+            std::string subtype;
+            std::string lineage;
+            std::string gene;
+        };
+
+        std::string mFilename;
+        std::unordered_map<key_t, value_t, key_hash_t> mData;
+        mutable std::shared_mutex mAccess;
+        bool mModified = false;
+        mutable std::atomic<size_t> mHits{0};
+        mutable std::atomic<size_t> mMisses{0};
+
+        static key_t make_key(char aKind, std::string_view aSequence) { return {fnv1a_hash_128(aSequence, fnv1a_hash_128(std::string_view(&aKind, 1))), aSequence.size()}; }
+        const value_t* find(const key_t& aKey) const;
+        void add(const key_t& aKey, value_t&& aValue);
+
+    }; // class AlignCache
+
+      // used by SeqdbSeq::align
+    AlignCache& align_cache();
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+      // Part of the aligned sequence kept after dropping stop codons: [begin, end) in aligned
+      // coordinates (position 0 is the first position of the aligned sequence).
+    struct aligned_window_t
+    {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+      // Longest part of the sequence shifted by aShift (prepended with aShift fill symbols if aShift > 0,
+      // -aShift symbols removed from the beginning if aShift < 0) not having *, the first one if there are several.
+    inline aligned_window_t longest_stop_free_window(std::string_view aSource, int aShift)
+    {
+        const auto shifted_size = std::max(std::ptrdiff_t{0}, static_cast<std::ptrdiff_t>(aSource.size()) + aShift);
+        aligned_window_t result;
+        size_t longest = 0, start = 0;
+        const auto check_part = [&result, &longest, &start](size_t part_end) {
+            if (longest < (part_end - start)) {
+                longest = part_end - start;
+                result = {start, part_end};
+            }
+            start = part_end + 1;
+        };
+        const size_t first = aShift < 0 ? static_cast<size_t>(-aShift) : 0;
+        for (auto stop = aSource.find('*', first); stop != std::string_view::npos; stop = aSource.find('*', stop + 1))
+            check_part(static_cast<size_t>(static_cast<std::ptrdiff_t>(stop) + aShift));
+        check_part(static_cast<size_t>(shifted_size));
+        return result;
+    }
+
+// ----------------------------------------------------------------------
+
+      // Aligned sequence presented over the stored (not aligned) one without copying it:
+      // symbol at aligned position i is source[i - shift] if i is within the window, fill symbol otherwise.
+      // Valid while the sequence it was obtained from is not modified.
+    class AlignedView
+    {
+     public:
+        class const_iterator
+        {
+         public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = char;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const char*;
+            using reference = char;
+
+            const_iterator() = default;
+            char operator*() const { return (*mView)[mPos]; }
+            char operator[](difference_type aOffset) const { return (*mView)[static_cast<size_t>(static_cast<difference_type>(mPos) + aOffset)]; }
+            const_iterator& operator++() { ++mPos; return *this; }
+            const_iterator operator++(int) { auto result = *this; ++mPos; return result; }
+            const_iterator& operator--() { --mPos; return *this; }
+            const_iterator operator--(int) { auto result = *this; --mPos; return result; }
+            const_iterator& operator+=(difference_type aOffset) { mPos = static_cast<size_t>(static_cast<difference_type>(mPos) + aOffset); return *this; }
+            const_iterator& operator-=(difference_type aOffset) { return operator+=(-aOffset); }
+            const_iterator operator+(difference_type aOffset) const { auto result = *this; return result += aOffset; }
+            const_iterator operator-(difference_type aOffset) const { auto result = *this; return result -= aOffset; }
+            difference_type operator-(const const_iterator& aNother) const { return static_cast<difference_type>(mPos) - static_cast<difference_type>(aNother.mPos); }
+            bool operator==(const const_iterator& aNother) const { return mPos == aNother.mPos; }
+            bool operator!=(const const_iterator& aNother) const { return mPos != aNother.mPos; }
+            bool operator<(const const_iterator& aNother) const { return mPos < aNother.mPos; }
+            bool operator>(const const_iterator& aNother) const { return mPos > aNother.mPos; }
+            bool operator<=(const const_iterator& aNother) const { return mPos <= aNother.mPos; }
+            bool operator>=(const const_iterator& aNother) const { return mPos >= aNother.mPos; }
+
+         private:
+            const AlignedView* mView = nullptr;
+            size_t mPos = 0;
+
+            const_iterator(const AlignedView* aView, size_t aPos) : mView(aView), mPos(aPos) {}
+            friend class AlignedView;
+        };
+
+        using value_type = char;
+        using size_type = size_t;
+        using iterator = const_iterator;
+
+        AlignedView() = default; // empty, e.g. for not aligned sequences
+        AlignedView(std::string_view aSource, int aShift, aligned_window_t aWindow, size_t aSize, char aFill)
+            : mSource(aSource), mShift(aShift), mWindow(aWindow), mSize(aSize), mFill(aFill) {}
+
+        size_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+
+        char operator[](size_t aPos) const
+            {
+                if (aPos < mWindow.begin || aPos >= mWindow.end)
+                    return mFill;
+                const auto offset = static_cast<std::ptrdiff_t>(aPos) - mShift;
+                return offset < 0 ? mFill : mSource[static_cast<size_t>(offset)];
+            }
+
+        char at(size_t aPos) const
+            {
+                if (aPos >= mSize)
+                    throw std::out_of_range("AlignedView::at: position " + std::to_string(aPos) + " is out of range (" + std::to_string(mSize) + ")");
+                return operator[](aPos);
+            }
+
+        const_iterator begin() const { return {this, 0}; }
+        const_iterator end() const { return {this, mSize}; }
+
+          // the only place where memory is allocated
+        std::string str() const
+            {
+                std::string result;
+                result.reserve(mSize);
+                const size_t source_begin = std::min(std::max(mWindow.begin, static_cast<size_t>(std::max(mShift, 0))), mSize);
+                const size_t source_end = std::max(std::min(mWindow.end, mSize), source_begin);
+                result.append(source_begin, mFill);
+                if (source_end > source_begin)
+                    result.append(mSource.substr(static_cast<size_t>(static_cast<std::ptrdiff_t>(source_begin) - mShift), source_end - source_begin));
+                result.append(mSize - source_end, mFill);
+                return result;
+            }
+
+        bool operator==(const AlignedView& aNother) const { return mSize == aNother.mSize && std::equal(begin(), end(), aNother.begin()); }
+        bool operator!=(const AlignedView& aNother) const { return !operator==(aNother); }
+        bool operator<(const AlignedView& aNother) const { return std::lexicographical_compare(begin(), end(), aNother.begin(), aNother.end()); }
+        bool operator==(std::string_view aNother) const { return mSize == aNother.size() && std::equal(begin(), end(), aNother.begin()); }
+        bool operator!=(std::string_view aNother) const { return !operator==(aNother); }
+
+     private:
+        std::string_view mSource;
+        int mShift = 0;
+        aligned_window_t mWindow;
+        size_t mSize = 0;
+        char mFill = 'X';
+
+    }; // class AlignedView
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
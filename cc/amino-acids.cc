@@ -1,7 +1,9 @@
 #include <iostream>
 #include <map>
+#include <set>
+#include <sstream>
+#include <cstdint>
 #include <array>
-#include <regex>
 #include <numeric>
 #include <algorithm>
 
@@ -9,6 +11,7 @@
 #include "acmacs-base/range.hh"
 #include "acmacs-base/stream.hh"
 #include "seqdb/amino-acids.hh"
+#include "seqdb/align-cache.hh"
 
 using namespace seqdb;
 
@@ -28,15 +31,15 @@ AlignAminoAcidsData seqdb::translate_and_align(std::string_view aNucleotides, Me
     }
 
     std::array<std::string, 3> translated;
-    std::transform(acmacs::index_iterator(0UL), acmacs::index_iterator(translated.size()), std::begin(translated),
-                   [&aNucleotides, &aMessages](auto offset) { return translate_nucleotides_to_amino_acids(aNucleotides, offset, aMessages); });
+    const size_t longest_part = translate_nucleotides_to_amino_acids(aNucleotides, translated);
+    if (longest_part < MINIMUM_SEQUENCE_AA_LENGTH)
+        return not_aligned; // no part is long enough to be aligned in any translation
+
     std::vector<AlignAminoAcidsData> r;
-    size_t longest_part = 0;
     for (auto offset : acmacs::range(translated.size())) {
         const auto aa_parts = acmacs::string::split(translated[offset], "*");
         size_t prefix_len = 0;
         for (const auto& part : aa_parts) {
-            longest_part = std::max(longest_part, part.size());
             if (part.size() >= MINIMUM_SEQUENCE_AA_LENGTH) {
                 // std::cerr << "part is big enough " << part.size() << std::endl;
                 Messages messages;
@@ -63,9 +66,10 @@ AlignAminoAcidsData seqdb::translate_and_align(std::string_view aNucleotides, Me
     // std::cerr << "translate_and_align " << r.size() << std::endl;
     if (r.empty()) {
         if (longest_part >= MINIMUM_SEQUENCE_AA_LENGTH) {
-            std::cerr << "WARNING: not aligned: " << name << " longest part: " << longest_part << '\n';
+              // reported via aMessages (not std::cerr), seqdb aligns sequences on several threads
+            aMessages.warning() << "not aligned: " << name << " longest part: " << longest_part << '\n';
             for (const auto& aa : translated) {
-                std::cerr << "    " << string::replace(aa, "*", " --- ") << '\n';
+                aMessages.warning() << "    " << string::replace(aa, "*", " --- ") << '\n';
             }
         }
         return not_aligned;
@@ -85,50 +89,211 @@ AlignAminoAcidsData seqdb::translate_and_align(std::string_view aNucleotides, Me
 
 // ----------------------------------------------------------------------
 
-static const std::map<std::string, char> CODON_TO_PROTEIN = {
-    {"UGC", 'C'}, {"GTA", 'V'}, {"GTG", 'V'}, {"CCT", 'P'}, {"CUG", 'L'}, {"AGG", 'R'}, {"CTT", 'L'}, {"CUU", 'L'},
-    {"CTG", 'L'}, {"GCU", 'A'}, {"CCG", 'P'}, {"AUG", 'M'}, {"GGC", 'G'}, {"UUA", 'L'}, {"GAG", 'E'}, {"UGG", 'W'},
-    {"UUU", 'F'}, {"UUG", 'L'}, {"ACU", 'T'}, {"TTA", 'L'}, {"AAT", 'N'}, {"CGU", 'R'}, {"CCA", 'P'}, {"GCC", 'A'},
-    {"GCG", 'A'}, {"TTG", 'L'}, {"CAT", 'H'}, {"AAC", 'N'}, {"GCA", 'A'}, {"GAU", 'D'}, {"UAU", 'Y'}, {"CAC", 'H'},
-    {"AUA", 'I'}, {"GUC", 'V'}, {"TCG", 'S'}, {"GGG", 'G'}, {"AGC", 'S'}, {"CTA", 'L'}, {"GCT", 'A'}, {"CCC", 'P'},
-    {"ACC", 'T'}, {"GAT", 'D'}, {"TCC", 'S'}, {"UAC", 'Y'}, {"CAU", 'H'}, {"UCG", 'S'}, {"CAA", 'Q'}, {"UCC", 'S'},
-    {"AGU", 'S'}, {"TTT", 'F'}, {"ACA", 'T'}, {"ACG", 'T'}, {"CGC", 'R'}, {"TGT", 'C'}, {"CAG", 'Q'}, {"GUA", 'V'},
-    {"GGU", 'G'}, {"AAG", 'K'}, {"AGA", 'R'}, {"ATA", 'I'}, {"TAT", 'Y'}, {"UCU", 'S'}, {"TCA", 'S'}, {"GAA", 'E'},
-    {"AGT", 'S'}, {"TCT", 'S'}, {"ACT", 'T'}, {"CGA", 'R'}, {"GGT", 'G'}, {"TGC", 'C'}, {"UGU", 'C'}, {"CUC", 'L'},
-    {"GAC", 'D'}, {"UUC", 'F'}, {"GTC", 'V'}, {"ATT", 'I'}, {"TAC", 'Y'}, {"CUA", 'L'}, {"TTC", 'F'}, {"GTT", 'V'},
-    {"UCA", 'S'}, {"AUC", 'I'}, {"GGA", 'G'}, {"GUG", 'V'}, {"GUU", 'V'}, {"AUU", 'I'}, {"CGT", 'R'}, {"CCU", 'P'},
-    {"ATG", 'M'}, {"AAA", 'K'}, {"TGG", 'W'}, {"CGG", 'R'}, {"AAU", 'N'}, {"CTC", 'L'}, {"ATC", 'I'},
-    {"TAA", '*'}, {"UAA", '*'}, {"TAG", '*'}, {"UAG", '*'}, {"TGA", '*'}, {"UGA", '*'}, {"TAR", '*'}, {"TRA", '*'}, {"UAR", '*'}, {"URA", '*'},
-};
+  // Nucleotide symbol to bit mask of bases it stands for (A=1, C=2, G=4, T/U=8), IUPAC ambiguity codes
+  // are combinations of bits, gaps and unknown symbols are 0.
+static constexpr std::array<uint8_t, 256> make_base_codes()
+{
+    std::array<uint8_t, 256> codes{};
+    constexpr const std::pair<char, uint8_t> symbols[] = {
+        {'A', 1}, {'C', 2}, {'G', 4}, {'T', 8}, {'U', 8},
+        {'R', 1|4}, {'Y', 2|8}, {'S', 2|4}, {'W', 1|8}, {'K', 4|8}, {'M', 1|2},
+        {'B', 2|4|8}, {'D', 1|4|8}, {'H', 1|2|8}, {'V', 1|2|4}, {'N', 1|2|4|8},
+    };
+    for (const auto& [symbol, code] : symbols) {
+        codes[static_cast<unsigned char>(symbol)] = code;
+        codes[static_cast<unsigned char>(symbol - 'A' + 'a')] = code;
+    }
+    return codes;
+}
+
+  // Standard genetic code, index is 16 * first + 4 * second + third base, A=0, C=1, G=2, T=3
+static constexpr const char STANDARD_CODE[] = "KNKNTTTTRSRSIIMIQHQHPPPPRRRRLLLLEDEDAAAAGGGGVVVV*Y*YSSSS*CWCLFLF";
+
+  // Amino acid for every combination of three base codes (index is (code1 << 8) | (code2 << 4) | code3):
+  // the one all the codons denoted by ambiguity codes translate to (e.g. TAR and TRA are stops), X if they
+  // translate to different amino acids or a symbol is not a nucleotide.
+static constexpr std::array<char, 4096> make_codon_table()
+{
+    std::array<char, 4096> table{};
+    for (size_t index = 0; index < table.size(); ++index) {
+        const size_t codes[] = {(index >> 8) & 0xF, (index >> 4) & 0xF, index & 0xF};
+        char aa = 0;
+        for (size_t b1 = 0; b1 < 4; ++b1) {
+            for (size_t b2 = 0; b2 < 4; ++b2) {
+                for (size_t b3 = 0; b3 < 4; ++b3) {
+                    if ((codes[0] & (1U << b1)) && (codes[1] & (1U << b2)) && (codes[2] & (1U << b3))) {
+                        const char standard = STANDARD_CODE[b1 * 16 + b2 * 4 + b3];
+                        aa = (aa == 0 || aa == standard) ? standard : 'X';
+                    }
+                }
+            }
+        }
+        table[index] = aa == 0 ? 'X' : aa;
+    }
+    return table;
+}
+
+static constexpr const auto BASE_CODES = make_base_codes();
+static constexpr const auto CODON_TABLE = make_codon_table();
+
+static inline size_t base_code(char aNucleotide) { return BASE_CODES[static_cast<unsigned char>(aNucleotide)]; }
+
+// ----------------------------------------------------------------------
 
 std::string seqdb::translate_nucleotides_to_amino_acids(std::string_view aNucleotides, size_t aOffset, Messages& /*aMessages*/)
 {
-    typedef decltype(CODON_TO_PROTEIN)::difference_type Diff;
     std::string result;
-    result.resize((aNucleotides.size() - aOffset) / 3 + 1, '-');
-    auto result_p = result.begin();
-    for (auto offset = aOffset; offset < aNucleotides.size(); offset += 3, ++result_p) {
-        auto const it = CODON_TO_PROTEIN.find(std::string(aNucleotides.begin() + static_cast<Diff>(offset), aNucleotides.begin() + static_cast<Diff>(offset) + 3));
-        if (it != CODON_TO_PROTEIN.end())
-            *result_p = it->second;
-        else
-            *result_p = 'X';
+    if (aOffset < aNucleotides.size()) {
+        result.reserve((aNucleotides.size() - aOffset) / 3 + 1);
+        size_t offset = aOffset;
+        for (; (offset + 3) <= aNucleotides.size(); offset += 3)
+            result.push_back(CODON_TABLE[(base_code(aNucleotides[offset]) << 8) | (base_code(aNucleotides[offset + 1]) << 4) | base_code(aNucleotides[offset + 2])]);
+        if (offset < aNucleotides.size()) // incomplete codon at the end
+            result.push_back('X');
     }
-    result.resize(static_cast<size_t>(result_p - result.begin()));
     return result;
 
 } // translate_nucleotides_to_amino_acids
 
+// ----------------------------------------------------------------------
+
+  // Translates with offsets 0, 1, 2 in one pass over nucleotides, returns the length of the longest
+  // part without stop codons in all three translations.
+size_t seqdb::translate_nucleotides_to_amino_acids(std::string_view aNucleotides, std::array<std::string, 3>& aTranslated)
+{
+    std::array<size_t, 3> part{0, 0, 0};
+    size_t longest_part = 0;
+    const auto append = [&aTranslated, &part, &longest_part](size_t frame, char aa) {
+        aTranslated[frame].push_back(aa);
+        if (aa == '*') {
+            longest_part = std::max(longest_part, part[frame]);
+            part[frame] = 0;
+        }
+        else
+            ++part[frame];
+    };
+
+    for (size_t frame = 0; frame < aTranslated.size(); ++frame) {
+        aTranslated[frame].clear();
+        aTranslated[frame].reserve(aNucleotides.size() / 3 + 1);
+    }
+      // codes of the last three nucleotides, the codon ending at position pos belongs to frame (pos - 2) % 3
+    size_t window = 0;
+    size_t frame = 0;
+    for (size_t pos = 0; pos < aNucleotides.size(); ++pos) {
+        window = ((window << 4) | base_code(aNucleotides[pos])) & 0xFFF;
+        if (pos >= 2) {
+            append(frame, CODON_TABLE[window]);
+            frame = frame == 2 ? 0 : frame + 1;
+        }
+    }
+    for (frame = 0; frame < aTranslated.size(); ++frame) {
+        if (frame < aNucleotides.size() && ((aNucleotides.size() - frame) % 3) != 0) // incomplete codon at the end
+            append(frame, 'X');
+        longest_part = std::max(longest_part, part[frame]);
+    }
+    return longest_part;
+
+} // translate_nucleotides_to_amino_acids
+
+// ----------------------------------------------------------------------
+
+enum symbol_class : uint8_t {
+    symbol_nucleotide = 1, symbol_nucleotide_ambiguous = 2, symbol_amino_acid_ambiguous = 4,
+    symbol_letter = 8, symbol_lower_case = 16, symbol_gap = 32, symbol_stop = 64
+};
+
+static constexpr std::array<uint8_t, 256> make_symbol_classes()
+{
+    std::array<uint8_t, 256> classes{};
+    for (char symbol = 'A'; symbol <= 'Z'; ++symbol) {
+        classes[static_cast<unsigned char>(symbol)] = symbol_letter;
+        classes[static_cast<unsigned char>(symbol - 'A' + 'a')] = symbol_letter | symbol_lower_case;
+    }
+    for (const char symbol : {'-', 'A', 'C', 'G', 'T', 'U'})
+        classes[static_cast<unsigned char>(symbol)] |= symbol_nucleotide;
+    for (const char symbol : {'B', 'D', 'H', 'K', 'M', 'N', 'R', 'S', 'V', 'W', 'Y', 'X'}) {
+        classes[static_cast<unsigned char>(symbol)] |= symbol_nucleotide | symbol_nucleotide_ambiguous;
+        classes[static_cast<unsigned char>(symbol - 'A' + 'a')] |= symbol_nucleotide_ambiguous; // lower case is not nucleotide for is_nucleotides()
+    }
+    for (const char symbol : {'B', 'J', 'Z', 'X'}) {
+        classes[static_cast<unsigned char>(symbol)] |= symbol_amino_acid_ambiguous;
+        classes[static_cast<unsigned char>(symbol - 'A' + 'a')] |= symbol_amino_acid_ambiguous;
+    }
+    for (const char symbol : {'-', '~', '.', ':', '/'})
+        classes[static_cast<unsigned char>(symbol)] |= symbol_gap;
+    classes[static_cast<unsigned char>('*')] = symbol_stop;
+    return classes;
+}
+
+static constexpr const auto SYMBOL_CLASSES = make_symbol_classes();
+
+// ----------------------------------------------------------------------
+
+bool seqdb::is_nucleotides(std::string_view aSequence)
+{
+    return std::all_of(aSequence.begin(), aSequence.end(), [](char symbol) { return SYMBOL_CLASSES[static_cast<unsigned char>(symbol)] & symbol_nucleotide; });
+
+} // seqdb::is_nucleotides
+
+// ----------------------------------------------------------------------
+
+  // One pass collecting the histogram of symbols, everything else is computed from the histogram.
+SequenceClass seqdb::classify_sequence(std::string_view aSequence)
+{
+    std::array<size_t, 256> histogram{};
+    for (const char symbol : aSequence)
+        ++histogram[static_cast<unsigned char>(symbol)];
+
+    uint8_t all = 0xFF;         // classes common to all the symbols present
+    for (size_t symbol = 0; symbol < histogram.size(); ++symbol) {
+        if (histogram[symbol])
+            all &= SYMBOL_CLASSES[symbol];
+    }
+    const auto count = [&histogram](uint8_t aClasses) {
+        size_t result = 0;
+        for (size_t symbol = 0; symbol < histogram.size(); ++symbol) {
+            if (SYMBOL_CLASSES[symbol] & aClasses)
+                result += histogram[symbol];
+        }
+        return result;
+    };
+
+    SequenceClass result;
+    result.size = aSequence.size();
+    result.nucleotides = aSequence.empty() || (all & symbol_nucleotide);
+    result.ambiguous = count(result.nucleotides ? symbol_nucleotide_ambiguous : symbol_amino_acid_ambiguous);
+    result.gaps = count(symbol_gap);
+    result.stops = histogram[static_cast<unsigned char>('*')];
+    result.lower_case = count(symbol_lower_case);
+    result.invalid = result.size - count(symbol_letter | symbol_gap | symbol_stop);
+    result.valid = !aSequence.empty() && result.invalid == 0;
+    return result;
+
+} // seqdb::classify_sequence
+
+// ----------------------------------------------------------------------
+
+void seqdb::normalize_sequence(std::string& aSequence)
+{
+    std::transform(aSequence.begin(), aSequence.end(), aSequence.begin(), [](char symbol) {
+        if (symbol == '/')
+            return '-';
+        return (SYMBOL_CLASSES[static_cast<unsigned char>(symbol)] & symbol_lower_case) ? static_cast<char>(symbol - 'a' + 'A') : symbol;
+    });
+
+} // seqdb::normalize_sequence
+
 // ----------------------------------------------------------------------
 
 struct AlignEntry : public AlignData
 {
     inline AlignEntry() = default;
     inline AlignEntry(const AlignEntry&) = default;
-    inline AlignEntry(std::string_view aSubtype, std::string_view aLineage, std::string_view aGene, Shift aShift, const std::regex& aRe, size_t aEndpos, bool aSignalpeptide, std::string_view aName)
-        : AlignData(aSubtype, aLineage, aGene, aShift), re(aRe), endpos(aEndpos), signalpeptide(aSignalpeptide), name(aName) {}
+    inline AlignEntry(std::string_view aSubtype, std::string_view aLineage, std::string_view aGene, Shift aShift, std::string_view aPattern, size_t aEndpos, bool aSignalpeptide, std::string_view aName)
+        : AlignData(aSubtype, aLineage, aGene, aShift), pattern(aPattern), endpos(aEndpos), signalpeptide(aSignalpeptide), name(aName) {}
 
-    std::regex re;
+    std::string_view pattern;   // fixed length: symbols, [symbol classes] and . (any symbol)
     size_t endpos;
     bool signalpeptide;
     std::string name;           // for debugging
@@ -144,95 +309,257 @@ inline std::ostream& operator<<(std::ostream& out, const AlignEntry& data)
 // ~/AD/sources/seqdb/bin/seq-aa-regex-gen.py
 
 static AlignEntry ALIGN_RAW_DATA[] = {
-    {"A(H3N2)", "", "HA", Shift(),   std::regex("MKTIIA[FL][CS][CHY]I[FLS]C[LQ][AGIV][FL][AGS]"), 40,  true, "h3-MKT-1"},
-    {"A(H3N2)", "", "HA", Shift(),   std::regex("MKTIIVLSCFFCLAFS"),                        40,  true, "h3-MKT-12"},
-    {"A(H3N2)", "", "HA", Shift(),   std::regex("MKTLIALSYIFCLVLG"),                        40,  true, "h3-MKT-13"},
-    {"A(H3N2)", "", "HA", Shift(),   std::regex("MKTTTILILLTHWVHS"),                        40,  true, "h3-MKT-14"},
-    {"A(H3N2)", "", "HA",  0,        std::regex("QK[IL]PGN[DN]NSTATLCLGHHAVPNGTIVKTI"),    100, false, "h3-QKIP"},
-    {"A(H3N2)", "", "HA", 10,        std::regex("ATLCLGHHAV"),                             100, false, "h3-ATL"},
-    {"A(H3N2)", "", "HA", 36,        std::regex("TNATELVQ"),                               100, false, "h3-TNA"},
-    {"A(H3N2)", "", "HA", 87,        std::regex("VERSKAYSN"),                              100, false, "h3-VER"},
-
-    {"A(H3N2)", "", "NA",  0,        std::regex("MNP[NS]QKI[IM]TIGS[IVX]SL[IT][ILV]"),      20, false, "h3-NA-1"}, // Kim, http://www.ncbi.nlm.nih.gov/nuccore/DQ415347.1
-
-
-    {"A(H1N1)", "",         "HA", Shift(), std::regex("MKVK[LY]LVLLCTFTATYA"),                             20,  true, "h1-MKV-1"},
-    {"A(H1N1)", "SEASONAL", "HA", Shift(), std::regex("MKVKLLVLLCTFSATYA"),                                20,  true, "h1-MKV-2"},
-    {"A(H1N1)", "2009PDM",  "HA", Shift(), std::regex("M[EK][AV]IL.[VX][LM]L[CHY][TA][FL][AT]T[AT][NS]A"), 100,  true, "h1-MKA-2"},
-    {"A(H1N1)", "",         "HA",       0, std::regex("DT[IL]CI[GX][HY]H[AT][DNTX][DN]"),                  100, false, "h1-DTL-1"},
-    {"A(H1N1)", "",         "HA",       5, std::regex("GYHANNS[AT]DTV"),                                   100, false, "h1-GYH"},
-    {"A(H1N1)", "",         "HA",      96, std::regex("[DN]YEELREQL"),                                     120, false, "h1-DYE"},
-      // leads to wrong alignment due to insertion before the regex {"A(H1N1)", "",         "HA",     162, std::regex("[KQ]SY[AI]N[ND]K[EG]KEVLVLWG[IV]HHP"),           220, false, "h1-KSY"},
-    {"A(H1N1)", "",         "HA",     105, std::regex("SSISSFER"),                                         200, false, "h1-SSI"},
-
-    {"A(H1N1)", "",         "NA",       0, std::regex("MNPNQKIITIG[SW][VI]CMTI"),                        20, false, "h1-NA-1"},
-    {"A(H1N1)", "",         "NA",      73, std::regex("FAAGQSVVSVKLAGNSSLCPVSGWAIYSK"),                 200, false, "h1-NA-2"},
-    {"A(H1N1)", "",         "NA",     249, std::regex("QASYKIFRIEKGKI"),                                300, false, "h1-NA-3"},
-
-    {"A(H1N1)", "",         "M1", Shift(), std::regex("MSLLTEVETYVLSIIPSGPLKAEIAQRLESVFAGKNTDLEAL"),    100, false, "h1-M1-1"},
-    {"A(H1N1)", "",         "M1", Shift(), std::regex("MGLIYNRMGTVTTEAAFGLVCA"),                        200, false, "h1-M1-2"},
-    {"A(H1N1)", "",         "M1", Shift(), std::regex("QRLESVFAGKNTDLEALMEWL"),                         200, false, "h1-M1-3"},
+    {"A(H3N2)", "", "HA", Shift(),   "MKTIIA[FL][CS][CHY]I[FLS]C[LQ][AGIV][FL][AGS]", 40,  true, "h3-MKT-1"},
+    {"A(H3N2)", "", "HA", Shift(),   "MKTIIVLSCFFCLAFS",                        40,  true, "h3-MKT-12"},
+    {"A(H3N2)", "", "HA", Shift(),   "MKTLIALSYIFCLVLG",                        40,  true, "h3-MKT-13"},
+    {"A(H3N2)", "", "HA", Shift(),   "MKTTTILILLTHWVHS",                        40,  true, "h3-MKT-14"},
+    {"A(H3N2)", "", "HA",  0,        "QK[IL]PGN[DN]NSTATLCLGHHAVPNGTIVKTI",    100, false, "h3-QKIP"},
+    {"A(H3N2)", "", "HA", 10,        "ATLCLGHHAV",                             100, false, "h3-ATL"},
+    {"A(H3N2)", "", "HA", 36,        "TNATELVQ",                               100, false, "h3-TNA"},
+    {"A(H3N2)", "", "HA", 87,        "VERSKAYSN",                              100, false, "h3-VER"},
+
+    {"A(H3N2)", "", "NA",  0,        "MNP[NS]QKI[IM]TIGS[IVX]SL[IT][ILV]",      20, false, "h3-NA-1"}, // Kim, http://www.ncbi.nlm.nih.gov/nuccore/DQ415347.1
+
+
+    {"A(H1N1)", "",         "HA", Shift(), "MKVK[LY]LVLLCTFTATYA",                             20,  true, "h1-MKV-1"},
+    {"A(H1N1)", "SEASONAL", "HA", Shift(), "MKVKLLVLLCTFSATYA",                                20,  true, "h1-MKV-2"},
+    {"A(H1N1)", "2009PDM",  "HA", Shift(), "M[EK][AV]IL.[VX][LM]L[CHY][TA][FL][AT]T[AT][NS]A", 100,  true, "h1-MKA-2"},
+    {"A(H1N1)", "",         "HA",       0, "DT[IL]CI[GX][HY]H[AT][DNTX][DN]",                  100, false, "h1-DTL-1"},
+    {"A(H1N1)", "",         "HA",       5, "GYHANNS[AT]DTV",                                   100, false, "h1-GYH"},
+    {"A(H1N1)", "",         "HA",      96, "[DN]YEELREQL",                                     120, false, "h1-DYE"},
+      // leads to wrong alignment due to insertion before the regex {"A(H1N1)", "",         "HA",     162, "[KQ]SY[AI]N[ND]K[EG]KEVLVLWG[IV]HHP",           220, false, "h1-KSY"},
+    {"A(H1N1)", "",         "HA",     105, "SSISSFER",                                         200, false, "h1-SSI"},
+
+    {"A(H1N1)", "",         "NA",       0, "MNPNQKIITIG[SW][VI]CMTI",                        20, false, "h1-NA-1"},
+    {"A(H1N1)", "",         "NA",      73, "FAAGQSVVSVKLAGNSSLCPVSGWAIYSK",                 200, false, "h1-NA-2"},
+    {"A(H1N1)", "",         "NA",     249, "QASYKIFRIEKGKI",                                300, false, "h1-NA-3"},
+
+    {"A(H1N1)", "",         "M1", Shift(), "MSLLTEVETYVLSIIPSGPLKAEIAQRLESVFAGKNTDLEAL",    100, false, "h1-M1-1"},
+    {"A(H1N1)", "",         "M1", Shift(), "MGLIYNRMGTVTTEAAFGLVCA",                        200, false, "h1-M1-2"},
+    {"A(H1N1)", "",         "M1", Shift(), "QRLESVFAGKNTDLEALMEWL",                         200, false, "h1-M1-3"},
 
       // * in front means do not update subtype in sequences (because this very subtype is for different NA types)
-    {"*A(H2)",   "", "HA",       -15,   std::regex("M[AT]I....LLFT...GDQIC"), 60, false, "h2-MAI"},
-    {"*A(H4)",   "", "HA",       -16,   std::regex("MLS...........SSQNY"), 60, false, "h4-MLS"},
-    {"*A(H5)",   "", "HA",       -16,   std::regex("ME[KR]IV........VK[GS]D[HQR]IC"), 60, false, "h5-MEK"},
-    {"*A(H6)",   "", "HA",       -16,   std::regex("MIAIIV.AIL.....SDKIC"), 60, false, "h6-MIA"},
-    {"*A(H7)",   "", "HA",       -18,   std::regex("MN[IT]Q[IM]L...........[GA]DKIC"), 60, false, "h7-MNT"},
-    {"*A(H8)",   "", "HA",       -16,   std::regex("MEKFIA.......NAYDRIC"), 60, false, "h8-MEK"},
-    {"*A(H9)",   "", "HA",       -18,   std::regex("ME[AT]..............ADKIC"), 60, false, "h9-MET"},
-    {"*A(H10)",  "", "HA",       -17,   std::regex("MYK............GLDKIC"), 60, false, "h10-MYK"},
-    {"*A(H11)",  "", "HA",       -16,   std::regex("M[EK]K.............DEIC"), 60, false, "h11-MEK"},
-    {"*A(H12)",  "", "HA",       -17,   std::regex("MEK...........[FL]AYDKIC"), 60, false, "h12-MEK"},
-    {"*A(H13)",  "", "HA",       -18,   std::regex("MDI............[IV]QADRIC"), 60, false, "h13-MDI"},
-    {"*A(H14)",  "", "HA",       -17,   std::regex("MIA...........AYSQITN"), 60, false, "h14-MIA"},
-
-    {"*A(H5)",   "", "HA",       0,   std::regex("DQICIGYHANNST.Q.DTIMEKNVTVT"), 100, false, "h5-DQIC"},
-
-      //{"*A(H5)",   "", "HA", Shift(),   std::regex("MEKIVLL[FL]AI[IV]SLVKS"),     20,  true, "h5-MEK-1"}, // http://signalpeptide.com
-      // {"*A(H5)",   "", "HA", Shift(),   std::regex("MEKIVLLLAVVSLVRS"),           20,  true, "h5-MEK-2"}, // http://signalpeptide.com H5N6, H5N2
-      // {"*A(H5)",   "", "HA", Shift(),   std::regex("MEKIVLLFA[AT]ISLVKS"),        20,  true, "h5-MEK-3"}, // http://sbkb.org/
-      // {"*A(H5)",   "", "HA",       0,   std::regex("D[HQR]IC[IV]GY[HQ]ANNST[EK][KQR][IV]"), 60, false, "h5-DQI-1"},
-    // {"*A(H5)",   "", "HA",       0,   std::regex("D[HQR]IC[IV]GY[HQ]AN[KN]S[KT][EK][KQR][IV]"), 60, false, "h5-DQI-1"},
+    {"*A(H2)",   "", "HA",       -15,   "M[AT]I....LLFT...GDQIC", 60, false, "h2-MAI"},
+    {"*A(H4)",   "", "HA",       -16,   "MLS...........SSQNY", 60, false, "h4-MLS"},
+    {"*A(H5)",   "", "HA",       -16,   "ME[KR]IV........VK[GS]D[HQR]IC", 60, false, "h5-MEK"},
+    {"*A(H6)",   "", "HA",       -16,   "MIAIIV.AIL.....SDKIC", 60, false, "h6-MIA"},
+    {"*A(H7)",   "", "HA",       -18,   "MN[IT]Q[IM]L...........[GA]DKIC", 60, false, "h7-MNT"},
+    {"*A(H8)",   "", "HA",       -16,   "MEKFIA.......NAYDRIC", 60, false, "h8-MEK"},
+    {"*A(H9)",   "", "HA",       -18,   "ME[AT]..............ADKIC", 60, false, "h9-MET"},
+    {"*A(H10)",  "", "HA",       -17,   "MYK............GLDKIC", 60, false, "h10-MYK"},
+    {"*A(H11)",  "", "HA",       -16,   "M[EK]K.............DEIC", 60, false, "h11-MEK"},
+    {"*A(H12)",  "", "HA",       -17,   "MEK...........[FL]AYDKIC", 60, false, "h12-MEK"},
+    {"*A(H13)",  "", "HA",       -18,   "MDI............[IV]QADRIC", 60, false, "h13-MDI"},
+    {"*A(H14)",  "", "HA",       -17,   "MIA...........AYSQITN", 60, false, "h14-MIA"},
+
+    {"*A(H5)",   "", "HA",       0,   "DQICIGYHANNST.Q.DTIMEKNVTVT", 100, false, "h5-DQIC"},
+
+      //{"*A(H5)",   "", "HA", Shift(),   "MEKIVLL[FL]AI[IV]SLVKS",     20,  true, "h5-MEK-1"}, // http://signalpeptide.com
+      // {"*A(H5)",   "", "HA", Shift(),   "MEKIVLLLAVVSLVRS",           20,  true, "h5-MEK-2"}, // http://signalpeptide.com H5N6, H5N2
+      // {"*A(H5)",   "", "HA", Shift(),   "MEKIVLLFA[AT]ISLVKS",        20,  true, "h5-MEK-3"}, // http://sbkb.org/
+      // {"*A(H5)",   "", "HA",       0,   "D[HQR]IC[IV]GY[HQ]ANNST[EK][KQR][IV]", 60, false, "h5-DQI-1"},
+    // {"*A(H5)",   "", "HA",       0,   "D[HQR]IC[IV]GY[HQ]AN[KN]S[KT][EK][KQR][IV]", 60, false, "h5-DQI-1"},
 
       // * in front means do not update subtype in sequences (because this very subtype is for different NA types)
-    // {"*A(H7)", "", "HA",       Shift(),   std::regex("MNTQIL[IV][FL][AIT][ALTI][SICV][AV][FLAIV][FLI][YECPHK][ATV][NKR][GA]"), 60, true, "h7-1"}, // DKICL...
-
-    // {"*A(H9)", "", "HA",       Shift(),   std::regex("ME[AT][KVI][AT][IL][MI][AT][AI]LL[ML][AV]T[AT][AS][NL]A"), 60, false, "h9-MET"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H9N + Organism
-    // {"*A(H10)","", "HA",       Shift(),   std::regex("MYK[IV][TV][LV][VI][LVI][TA]L[LF]GAV[KRN]GL"), 60, false, "h10-MYK"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H10 + Organism
-    // {"*A(H11)","", "HA",       Shift(),   std::regex("M[KE]K[LTVI]LLF[TA][TVA]I[FI][IFL][YC][AVI][RK]A"), 60, false, "h11-MEK"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H11N + Organism
-
-    {"B", "", "HA", Shift(), std::regex("M[EKT][AGT][AIL][ICX]V[IL]L[IMT][AEILVX][AIVX][AMT]S[DHKNSTX][APX]"), 100,  true, "B-MKT"}, // http://repository.kulib.kyoto-u.ac.jp/dspace/bitstream/2433/49327/1/8_1.pdf, inferred by Eu for B/INDONESIA/NIHRD-JBI152/2015, B/CAMEROON/14V-8639/2014
-    {"B", "", "HA",       0, std::regex("DR[ISV]C[AST][GX][ITV][IT][SWX]S[DKNX]SP[HXY][ILTVX][VX][KX]T[APT]T[QX][GV][EK][IV]NVTG[AV][IX][LPS]LT[AITX][AIST][LP][AIT][KRX]"), 50, false, "B-DRICT"},
-    {"B", "", "HA",       3, std::regex("CTG[IVX]TS[AS]NSPHVVKTATQGEVNVTGVIPLTTTP"),                           50, false, "B-CTG"},
-    {"B", "", "HA",      23, std::regex("[XV]NVTGVIPLTTTPTK"),                                                 50, false, "B-VNV"},
-    {"B", "", "HA",      59, std::regex("CTDLDVALGRP"),                                                       150, false, "B-CTD"},
-    {"B", "", "HA", Shift(), std::regex("MVVTSNA"),                                                            20,  true, "B-MVV"},
-
-    {"B", "", "NA",  Shift(), std::regex("MLPSTIQ[MT]LTL[FY][IL]TSGGVLLSLY[AV]S[AV][LS]LSYLLY[SX]DIL[LX][KR]F"), 45, false, "B-NA"},
-    {"B", "", "NS1", Shift(), std::regex("MA[DN]NMTT[AT]QIEVGPGATNAT[IM]NFEAGILECYERLSWQ[KR]AL"),                45, false, "B-NS1-1"},
-    {"B", "", "NS1", Shift(), std::regex("MA[NX][DN][NX]MTTTQIEVGPGATNATINFEAGILECYERLSWQR"),                    45, false, "B-NS1-2"}, // has insertion at 2 or 3 compared to the above
-    {"B", "", "",    Shift(), std::regex("GNFLWLLHV"),                                                           45, false, "B-CNIC"}, // Only CNIC sequences 2008-2009 have it, perhaps not HA
+    // {"*A(H7)", "", "HA",       Shift(),   "MNTQIL[IV][FL][AIT][ALTI][SICV][AV][FLAIV][FLI][YECPHK][ATV][NKR][GA]", 60, true, "h7-1"}, // DKICL...
+
+    // {"*A(H9)", "", "HA",       Shift(),   "ME[AT][KVI][AT][IL][MI][AT][AI]LL[ML][AV]T[AT][AS][NL]A", 60, false, "h9-MET"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H9N + Organism
+    // {"*A(H10)","", "HA",       Shift(),   "MYK[IV][TV][LV][VI][LVI][TA]L[LF]GAV[KRN]GL", 60, false, "h10-MYK"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H10 + Organism
+    // {"*A(H11)","", "HA",       Shift(),   "M[KE]K[LTVI]LLF[TA][TVA]I[FI][IFL][YC][AVI][RK]A", 60, false, "h11-MEK"}, // http://signalpeptide.com/index.php?m=listspdb_viruses -> H11N + Organism
+
+    {"B", "", "HA", Shift(), "M[EKT][AGT][AIL][ICX]V[IL]L[IMT][AEILVX][AIVX][AMT]S[DHKNSTX][APX]", 100,  true, "B-MKT"}, // http://repository.kulib.kyoto-u.ac.jp/dspace/bitstream/2433/49327/1/8_1.pdf, inferred by Eu for B/INDONESIA/NIHRD-JBI152/2015, B/CAMEROON/14V-8639/2014
+    {"B", "", "HA",       0, "DR[ISV]C[AST][GX][ITV][IT][SWX]S[DKNX]SP[HXY][ILTVX][VX][KX]T[APT]T[QX][GV][EK][IV]NVTG[AV][IX][LPS]LT[AITX][AIST][LP][AIT][KRX]", 50, false, "B-DRICT"},
+    {"B", "", "HA",       3, "CTG[IVX]TS[AS]NSPHVVKTATQGEVNVTGVIPLTTTP",                           50, false, "B-CTG"},
+    {"B", "", "HA",      23, "[XV]NVTGVIPLTTTPTK",                                                 50, false, "B-VNV"},
+    {"B", "", "HA",      59, "CTDLDVALGRP",                                                       150, false, "B-CTD"},
+    {"B", "", "HA", Shift(), "MVVTSNA",                                                            20,  true, "B-MVV"},
+
+    {"B", "", "NA",  Shift(), "MLPSTIQ[MT]LTL[FY][IL]TSGGVLLSLY[AV]S[AV][LS]LSYLLY[SX]DIL[LX][KR]F", 45, false, "B-NA"},
+    {"B", "", "NS1", Shift(), "MA[DN]NMTT[AT]QIEVGPGATNAT[IM]NFEAGILECYERLSWQ[KR]AL",                45, false, "B-NS1-1"},
+    {"B", "", "NS1", Shift(), "MA[NX][DN][NX]MTTTQIEVGPGATNATINFEAGILECYERLSWQR",                    45, false, "B-NS1-2"}, // has insertion at 2 or 3 compared to the above
+    {"B", "", "",    Shift(), "GNFLWLLHV",                                                           45, false, "B-CNIC"}, // Only CNIC sequences 2008-2009 have it, perhaps not HA
 };
 
+// ----------------------------------------------------------------------
+
+// All ALIGN_RAW_DATA patterns compiled into one bit-parallel (shift-and)
+// automaton. Each pattern occupies a range of bits within a 64-bit
+// word, bit i of the range is set after processing a symbol if the
+// first i+1 elements of the pattern match the text ending at that
+// symbol. Words are updated together for every symbol, i.e. all
+// patterns are searched in one linear pass over the sequence.
+
+class AlignAutomaton
+{
+ public:
+    AlignAutomaton(const AlignEntry* first, const AlignEntry* last);
+
+      // for every pattern (in the ALIGN_RAW_DATA order): offset of its leftmost match ending before the pattern endpos, npos if not found
+    void find(std::string_view aAminoAcids, std::vector<size_t>& aStarts) const;
+    size_t pattern_length(size_t aPatternNo) const { return mPatterns[aPatternNo].length; }
+
+    static constexpr const size_t npos = std::string_view::npos;
+
+ private:
+    using word_t = uint64_t;
+    static constexpr const size_t word_bits = 64;
+
+    struct pattern_t
+    {
+        size_t word;
+        word_t final_bit;
+        size_t length;
+        size_t endpos;
+    };
+
+    std::vector<pattern_t> mPatterns;
+    std::vector<std::array<word_t, 256>> mMasks; // per word: pattern elements matching a symbol
+    std::vector<word_t> mStartBits;              // per word: first elements of patterns
+    std::vector<word_t> mFinalBits;              // per word: last elements of patterns
+    std::vector<std::vector<size_t>> mPatternsOfWord;
+    size_t mMaxEndpos = 0;
+
+    static std::vector<std::array<bool, 256>> parse(std::string_view aPattern);
+
+}; // class AlignAutomaton
+
+// ----------------------------------------------------------------------
+
+std::vector<std::array<bool, 256>> AlignAutomaton::parse(std::string_view aPattern)
+{
+    std::vector<std::array<bool, 256>> result;
+    for (size_t pos = 0; pos < aPattern.size(); ++pos) {
+        auto& element = result.emplace_back();
+        switch (aPattern[pos]) {
+          case '.':
+              element.fill(true);
+              break;
+          case '[': {
+              const auto close = aPattern.find(']', pos + 1);
+              if (close == std::string_view::npos || close == (pos + 1))
+                  throw std::runtime_error("AlignAutomaton: invalid symbol class in " + std::string(aPattern));
+              element.fill(false);
+              for (++pos; pos < close; ++pos)
+                  element[static_cast<unsigned char>(aPattern[pos])] = true;
+          }
+              break;
+          case ']': case '(': case ')': case '*': case '+': case '?': case '{': case '}': case '|': case '^': case '$': case '\\':
+              throw std::runtime_error("AlignAutomaton: unsupported pattern syntax in " + std::string(aPattern));
+          default:
+              element.fill(false);
+              element[static_cast<unsigned char>(aPattern[pos])] = true;
+              break;
+        }
+    }
+    return result;
+
+} // AlignAutomaton::parse
+
+// ----------------------------------------------------------------------
+
+AlignAutomaton::AlignAutomaton(const AlignEntry* first, const AlignEntry* last)
+{
+    std::vector<size_t> used_bits; // per word
+    for (; first != last; ++first) {
+        const auto elements = parse(first->pattern);
+        if (elements.empty() || elements.size() > word_bits)
+            throw std::runtime_error("AlignAutomaton: pattern length out of range: " + std::string(first->pattern));
+          // first word having enough room for the pattern, patterns do not cross word boundaries
+        const auto word = static_cast<size_t>(std::find_if(std::begin(used_bits), std::end(used_bits), [&elements](size_t used) { return (word_bits - used) >= elements.size(); }) - std::begin(used_bits));
+        if (word == used_bits.size()) {
+            used_bits.push_back(0);
+            mMasks.emplace_back().fill(0);
+            mStartBits.push_back(0);
+            mFinalBits.push_back(0);
+            mPatternsOfWord.emplace_back();
+        }
+        const auto first_bit = used_bits[word];
+        for (size_t element_no = 0; element_no < elements.size(); ++element_no) {
+            for (size_t symbol = 0; symbol < elements[element_no].size(); ++symbol) {
+                if (elements[element_no][symbol])
+                    mMasks[word][symbol] |= word_t{1} << (first_bit + element_no);
+            }
+        }
+        const word_t final_bit = word_t{1} << (first_bit + elements.size() - 1);
+        mStartBits[word] |= word_t{1} << first_bit;
+        mFinalBits[word] |= final_bit;
+        used_bits[word] += elements.size();
+        mPatternsOfWord[word].push_back(mPatterns.size());
+        mPatterns.push_back({word, final_bit, elements.size(), first->endpos});
+        mMaxEndpos = std::max(mMaxEndpos, first->endpos);
+    }
+
+} // AlignAutomaton::AlignAutomaton
+
+// ----------------------------------------------------------------------
+
+void AlignAutomaton::find(std::string_view aAminoAcids, std::vector<size_t>& aStarts) const
+{
+    aStarts.assign(mPatterns.size(), npos);
+    std::vector<word_t> state(mMasks.size(), 0);
+    size_t not_found = mPatterns.size();
+    const auto scan_end = std::min(aAminoAcids.size(), mMaxEndpos);
+    for (size_t pos = 0; pos < scan_end && not_found > 0; ++pos) {
+        const auto symbol = static_cast<unsigned char>(aAminoAcids[pos]);
+        for (size_t word = 0; word < state.size(); ++word) {
+              // bit leaking from the last element of a pattern into the first one of the next pattern is masked by mStartBits
+            state[word] = ((state[word] << 1) | mStartBits[word]) & mMasks[word][symbol];
+            if (state[word] & mFinalBits[word]) {
+                for (auto pattern_no : mPatternsOfWord[word]) {
+                    const auto& pattern = mPatterns[pattern_no];
+                    if ((state[word] & pattern.final_bit) && aStarts[pattern_no] == npos && pos < pattern.endpos) {
+                        aStarts[pattern_no] = pos + 1 - pattern.length;
+                        --not_found;
+                    }
+                }
+            }
+        }
+    }
+
+} // AlignAutomaton::find
+
+// ----------------------------------------------------------------------
+
+  // to be changed when the alignment or translation algorithm changes in a way affecting results
+static constexpr const char* ALIGNMENT_ALGORITHM_VERSION = "align-1";
+
+uint64_t seqdb::alignment_table_version()
+{
+    static const uint64_t version = [] {
+        auto hash = fnv1a_hash(ALIGNMENT_ALGORITHM_VERSION);
+        for (const auto& raw_data : ALIGN_RAW_DATA) {
+            for (const std::string_view field : {std::string_view{raw_data.subtype}, std::string_view{raw_data.lineage}, std::string_view{raw_data.gene}, raw_data.pattern, std::string_view{raw_data.name}})
+                hash = fnv1a_hash(field, fnv1a_hash("\t", hash));
+            for (const auto number : {static_cast<int64_t>(raw_data.shift.raw()), static_cast<int64_t>(raw_data.endpos), static_cast<int64_t>(raw_data.signalpeptide)})
+                hash = fnv1a_hash(std::to_string(number), fnv1a_hash("\t", hash));
+        }
+        return hash;
+    }();
+    return version;
+
+} // seqdb::alignment_table_version
+
+// ----------------------------------------------------------------------
+
 AlignData seqdb::align(std::string_view aAminoAcids, Messages& aMessages)
 {
+    static const AlignAutomaton automaton(std::begin(ALIGN_RAW_DATA), std::end(ALIGN_RAW_DATA));
+    thread_local std::vector<size_t> starts;
+    automaton.find(aAminoAcids, starts);
+
     std::vector<AlignEntry> results;
-    for (auto raw_data = std::begin(ALIGN_RAW_DATA); raw_data != std::end(ALIGN_RAW_DATA); ++raw_data) {
-        std::cmatch m;
-        if (std::regex_search(aAminoAcids.cbegin(), aAminoAcids.cbegin() + std::min(aAminoAcids.size(), raw_data->endpos), m, raw_data->re)) {
-            AlignEntry r(*raw_data);
-            if (raw_data->signalpeptide) {
-                r.shift = - (m[0].second - aAminoAcids.cbegin());
+    for (size_t pattern_no = 0; pattern_no < starts.size(); ++pattern_no) {
+        if (const auto start = starts[pattern_no]; start != AlignAutomaton::npos) {
+            const auto& raw_data = ALIGN_RAW_DATA[pattern_no];
+            AlignEntry r(raw_data);
+            if (raw_data.signalpeptide) {
+                r.shift = - static_cast<std::string::difference_type>(start + automaton.pattern_length(pattern_no));
             }
             else if (r.shift.aligned()) {
-                r.shift -= m[0].first - aAminoAcids.cbegin();
+                r.shift -= start;
             }
             results.push_back(r);
         }
-        // else {
-        //     std::cerr << "DEBUG: no match " << raw_data->name << ' ' << std::string_view(aAminoAcids.data(), std::min(aAminoAcids.size(), raw_data->endpos)) << '\n';
-        // }
     }
     // std::cerr << "DEBUG: seqdb::align: " << results << '\n';
     if (results.empty()) {
@@ -253,18 +580,17 @@ AlignData seqdb::align(std::string_view aAminoAcids, Messages& aMessages)
                    << "    ";
                 std::transform(std::begin(results), std::end(results), polyfill::make_ostream_joiner(os, " "), [](const auto& e) -> std::string { return e.name; });
 
-                std::cerr << "DEBUG: seqdb::align: " << os.str() << std::endl;
                 aMessages.warning() << os.str() << std::endl;
             }
         }
         catch (InvalidShift&) {
-            std::cerr << "INTERNAL ERROR: InvalidShift " << aAminoAcids << std::endl;
+            aMessages.warning() << "INTERNAL ERROR: InvalidShift " << aAminoAcids << std::endl;
         }
         return results[0];
     }
     else {
         if (results[0].name == "h3-ATL")
-            std::cerr << "%%% " << results[0].name << " " << results[0].shift << " " << aAminoAcids << std::endl;
+            aMessages.warning() << "%%% " << results[0].name << " " << results[0].shift << " " << aAminoAcids << std::endl;
         return results[0];
     }
 
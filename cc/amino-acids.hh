@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <array>
 
 #include "seqdb/messages.hh"
 #include "seqdb/sequence-shift.hh"
@@ -50,7 +51,7 @@ namespace seqdb
             }
 
         std::string amino_acids;
-        int offset;
+        int offset = 0;
     };
 
 // ----------------------------------------------------------------------
@@ -58,6 +59,8 @@ namespace seqdb
     AlignAminoAcidsData translate_and_align(std::string_view aNucleotides, Messages& aMessages, std::string_view name);
 
     std::string translate_nucleotides_to_amino_acids(std::string_view aNucleotides, size_t aOffset, Messages& aMessages);
+      // all three reading frames in one pass, returns length of the longest part without stop codons
+    size_t translate_nucleotides_to_amino_acids(std::string_view aNucleotides, std::array<std::string, 3>& aTranslated);
     AlignData align(std::string_view aAminoAcids, Messages& aMessages);
 
 // ----------------------------------------------------------------------
@@ -69,14 +72,25 @@ namespace seqdb
 
 // ----------------------------------------------------------------------
 
-    inline bool is_nucleotides(std::string_view aSequence)
+      // https://en.wikipedia.org/wiki/Nucleic_acid_notation + X (gisaid nuc seqs contain X) and -, case sensitive
+    bool is_nucleotides(std::string_view aSequence);
+
+      // Result of the single pass over a raw sequence at ingest
+    struct SequenceClass
     {
-        constexpr char sNucleotideElements[] = "-ABCDGHKMNRSTUVWXY"; // https://en.wikipedia.org/wiki/Nucleic_acid_notation + X (gisaid nuc seqs contain X)
-        std::string sorted_seq{aSequence};
-        std::sort(std::begin(sorted_seq), std::end(sorted_seq));
-        const auto last = std::unique(std::begin(sorted_seq), std::end(sorted_seq));
-        return std::includes(std::begin(sNucleotideElements), std::end(sNucleotideElements), begin(sorted_seq), last);
-    }
+        bool nucleotides = false;  // the same as is_nucleotides()
+        bool valid = false;        // not empty, just letters, gaps (- ~ . : /) and stops, i.e. acceptable in fasta
+        size_t size = 0;
+        size_t ambiguous = 0;      // nucleotides: IUPAC ambiguity codes and X, amino acids: B, J, Z, X
+        size_t gaps = 0;
+        size_t stops = 0;
+        size_t lower_case = 0;
+        size_t invalid = 0;        // neither letters nor gaps nor stops
+    };
+
+    SequenceClass classify_sequence(std::string_view aSequence);
+      // upper-cases and replaces / (found in H1pdm sequences) with -, in place
+    void normalize_sequence(std::string& aSequence);
 
 // ----------------------------------------------------------------------
 
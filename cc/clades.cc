@@ -1,161 +1,246 @@
 #include <iostream>
 #include <algorithm>
 #include <array>
-#include <vector>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
+#include "acmacs-base/acmacsd.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/json-importer.hh"
 #include "clades.hh"
+#include "align-cache.hh"
 
+namespace jsi = json_importer;
 using namespace seqdb;
 
 // ----------------------------------------------------------------------
 
-std::vector<std::string> seqdb::clades_b_yamagata(std::string_view aSequence, Shift aShift, std::string_view /*aName*/)
+static constexpr const char* CLADES_JSON_VERSION = "seqdb-clades-v1";
+
+static constexpr const uint32_t residue_deletion = 1U << 26;
+static constexpr const uint32_t residue_other = 1U << 27;
+static constexpr const uint32_t residue_beyond = 1U << 28;
+static constexpr const uint32_t residue_any = (residue_beyond << 1) - 1;
+
+// ----------------------------------------------------------------------
+
+namespace
+{
+    class CladeDefinitionData
+    {
+     public:
+        void virus_type(const char* str, size_t length) { mVirusType.assign(str, length); }
+        void lineage(const char* str, size_t length) { mLineage.assign(str, length); }
+        void clade(const char* str, size_t length) { mClade.assign(str, length); }
+        void group(const char* str, size_t length) { mGroup.assign(str, length); }
+        void comment(const char* /*str*/, size_t /*length*/) {}
+        std::vector<std::string>& aa() { return mAA; }
+
+        std::string mVirusType, mLineage, mClade, mGroup;
+        std::vector<std::string> mAA;
+    };
+
+    class CladesFile
+    {
+     public:
+        void version(const char* str, size_t length)
+            {
+                const std::string version{str, length};
+                if (version != CLADES_JSON_VERSION)
+                    throw std::runtime_error("Unsupported clade definitions version: \"" + version + "\"");
+            }
+
+        void comment(const char* /*str*/, size_t /*length*/) {}
+        std::vector<CladeDefinitionData>& clades() { return mClades; }
+
+        std::vector<CladeDefinitionData> mClades;
+    };
+
+} // namespace
+
+// ----------------------------------------------------------------------
+
+CladeDefinitions::CladeDefinitions(std::string_view aFilename)
+    : mFilename(aFilename), mHash(fnv1a_hash(CLADES_JSON_VERSION))
 {
-      // 165N -> Y2, 165Y -> Y3 (yamagata numeration, 163 is not -)
-      // 166N -> Y2, 166Y -> Y3 (victoria numeration, 163 is -)
-    auto r = std::vector<std::string>();
-    auto const pos = 165 - aShift; // use victoria numeration
-    if (aSequence.size() > static_cast<size_t>(pos) && pos > 0) {
-        switch (aSequence[static_cast<size_t>(pos)]) {
-          case 'N':
-              r.push_back("Y2");
-              break;
-          case 'Y':
-              r.push_back("Y3");
-              break;
-          default:
-              break;
+    jsi::data<CladeDefinitionData> clade_data = {
+        {"virus_type", jsi::field(&CladeDefinitionData::virus_type)},
+        {"lineage", jsi::field(&CladeDefinitionData::lineage)},
+        {"clade", jsi::field(&CladeDefinitionData::clade)},
+        {"group", jsi::field(&CladeDefinitionData::group)},
+        {"aa", jsi::field(&CladeDefinitionData::aa)},
+        {"?", jsi::field(&CladeDefinitionData::comment)},
+    };
+
+    jsi::data<CladesFile> clades_file_data = {
+        {"  version", jsi::field(&CladesFile::version)},
+        {"_", jsi::field(&CladesFile::comment)},
+        {"clades", jsi::field(&CladesFile::clades, clade_data)},
+    };
+
+    if (!acmacs::file::exists(mFilename))
+        throw std::runtime_error("clade definitions not found: " + mFilename + " (installed by make install of seqdb, another file can be set by clade_definitions_setup())");
+    CladesFile data;
+    jsi::import(acmacs::file::read(mFilename), data, clades_file_data);
+    for (const auto& definition : data.mClades) {
+        try {
+            add(definition.mVirusType, definition.mLineage, definition.mClade, definition.mGroup, definition.mAA);
+        }
+        catch (std::exception& err) {
+            throw std::runtime_error(mFilename + ": clade " + definition.mClade + ": " + err.what());
         }
     }
-    return r;
+    for (auto& subtype : mSubtypes) {
+        for (auto& clade : subtype.clades)
+            clade.tests.resize((subtype.tests.size() + 63) / 64, 0);
+        for (const auto& test : subtype.tests)
+            subtype.positions.push_back(test.pos);
+        std::sort(subtype.positions.begin(), subtype.positions.end());
+        subtype.positions.erase(std::unique(subtype.positions.begin(), subtype.positions.end()), subtype.positions.end());
+    }
 
-} // clades_b_yamagata
+} // CladeDefinitions::CladeDefinitions
 
 // ----------------------------------------------------------------------
 
-std::vector<std::string> seqdb::clades_b_victoria(std::string_view aSequence, Shift aShift, std::string_view aName)
+void CladeDefinitions::add(std::string_view aVirusType, std::string_view aLineage, std::string_view aClade, std::string_view aGroup, const std::vector<std::string>& aTests)
 {
-    auto r = std::vector<std::string>();
-    const size_t
-            pos58 = static_cast<size_t>(57 - aShift),
-            pos75 = static_cast<size_t>(74 - aShift),
-            pos162 = static_cast<size_t>(161 - aShift),
-            pos163 = static_cast<size_t>(162 - aShift),
-            pos164 = static_cast<size_t>(163 - aShift),
-              // pos165 = static_cast<size_t>(164 - aShift),
-              // pos166 = static_cast<size_t>(165 - aShift),
-              // pos167 = static_cast<size_t>(166 - aShift),
-            pos172 = static_cast<size_t>(171 - aShift);
-
-      // before 2018-09-03
-      // if (aSequence.size() > pos172 && aSequence[pos75] == 'K' && aSequence[pos165] == 'K' && aSequence[pos172] == 'P' && aSequence[pos58] != 'P')
-      //     r.push_back("1A");
-
-      // 2018-09-03, Sarah: clades should (technically) be defined by a phylogenetic tree rather than a set of amino acids
-    if (aSequence.size() > pos172 && aSequence[pos75] == 'K' && aSequence[pos172] == 'P' && aSequence[pos58] != 'P')
-        r.push_back("1A");
-    else if (aSequence.size() > pos58 && aSequence[pos58] == 'P')
-        r.push_back("1B");
-    else
-        r.push_back("1");
+    if (aVirusType.empty() || aClade.empty())
+        throw std::runtime_error("virus_type and clade must not be empty");
 
-    if (aSequence.size() > pos164 && aSequence[pos162] == '-' && aSequence[pos163] == '-' && aSequence[pos164] == '-')
-        r.push_back("TRIPLEDEL2017"); // B/Vic triple deletion mutant 2017 162,163,164 by convention
-    else if (aSequence.size() > pos163 && aSequence[pos162] == '-' && aSequence[pos163] == '-')
-        r.push_back("DEL2017"); // B/Vic deletion mutant 2017
-    else if (aSequence.size() > pos164 && (aSequence[pos162] == '-' || aSequence[pos163] == '-' || aSequence[pos164] == '-'))
-        std::cerr << "WARNING: [" << aName << "]: strange B/Vic deletion mutant: " << aSequence << '\n';
-    return r;
+    auto subtype = std::find_if(mSubtypes.begin(), mSubtypes.end(), [aVirusType, aLineage](const auto& st) { return st.virus_type == aVirusType && st.lineage == aLineage; });
+    if (subtype == mSubtypes.end())
+        subtype = mSubtypes.insert(mSubtypes.end(), subtype_t{std::string{aVirusType}, std::string{aLineage}, {}, {}, {}, {}});
 
-      // earlier definitions:
-      // mark clade 1A (all strains if empty clade removed, otherwise clade 1B defined by L58P, clade 1 defined by N75K, N165K, S172P)
+    size_t group = no_group;
+    if (!aGroup.empty()) {
+        group = static_cast<size_t>(std::find(subtype->groups.begin(), subtype->groups.end(), aGroup) - subtype->groups.begin());
+        if (group == subtype->groups.size())
+            subtype->groups.emplace_back(aGroup);
+    }
+
+    for (const auto field : {aVirusType, aLineage, aClade, aGroup})
+        mHash = fnv1a_hash(field, fnv1a_hash("\t", mHash));
+    for (const auto& test : aTests)
+        mHash = fnv1a_hash(test, fnv1a_hash(" ", mHash));
+    mHash = fnv1a_hash("\n", mHash);
 
-} // clades_b_yamagata
+    clade_t clade{std::string{aClade}, {}, group};
+    for (const auto& source : aTests) {
+        const auto test = parse_test(source);
+        const auto test_no = static_cast<size_t>(std::find(subtype->tests.begin(), subtype->tests.end(), test) - subtype->tests.begin());
+        if (test_no == subtype->tests.size())
+            subtype->tests.push_back(test);
+        clade.tests.resize(std::max(clade.tests.size(), test_no / 64 + 1), 0);
+        clade.tests[test_no / 64] |= uint64_t{1} << (test_no % 64);
+    }
+    subtype->clades.push_back(std::move(clade));
+
+} // CladeDefinitions::add
 
 // ----------------------------------------------------------------------
 
-std::vector<std::string> seqdb::clades_h1pdm(std::string_view aSequence, Shift aShift, std::string_view /*aName*/)
+const CladeDefinitions::subtype_t* CladeDefinitions::find_subtype(std::string_view aVirusType, std::string_view aLineage) const
 {
-    // ----------------------------------------------------------------------
-    // 2018-09-19 clade definitions changed by Sarah before SSM
-    // ----------------------------------------------------------------------
-    // 6B: 163Q
-    // 6B1: 162N, 163Q
-    // 6B2: 152T, 163Q
-    auto r = std::vector<std::string>();
-    const auto pos152 = static_cast<size_t>(151 - aShift),
-            pos162 = static_cast<size_t>(161 - aShift),
-            pos163 = static_cast<size_t>(162 - aShift);
-    if (pos163 > 0 && aSequence.size() > pos163) {
-        if (aSequence[pos163] == 'Q') {
-            r.push_back("6B");
-            if (aSequence[pos162] == 'N')
-                r.push_back("6B1");
-            if (aSequence[pos152] == 'T')
-                r.push_back("6B2");
-        }
+    const auto subtype = std::find_if(mSubtypes.begin(), mSubtypes.end(), [aVirusType, aLineage](const auto& st) { return st.virus_type == aVirusType && (st.lineage.empty() || st.lineage == aLineage); });
+    return subtype == mSubtypes.end() ? nullptr : &*subtype;
+
+} // CladeDefinitions::find_subtype
+
+// ----------------------------------------------------------------------
+
+CladeDefinitions::test_t CladeDefinitions::parse_test(std::string_view aTest)
+{
+    const bool negate = !aTest.empty() && aTest.front() == '!';
+    const auto digits_start = negate ? size_t{1} : size_t{0};
+    const auto residues_start = std::min(aTest.find_first_not_of("0123456789", digits_start), aTest.size());
+    if (residues_start == digits_start || residues_start == aTest.size())
+        throw std::runtime_error("invalid test \"" + std::string{aTest} + "\", expected [!]<pos><residues>");
+    test_t test{std::stoul(std::string{aTest.substr(digits_start, residues_start - digits_start)}), 0};
+    if (test.pos == 0)
+        throw std::runtime_error("invalid test \"" + std::string{aTest} + "\", position counts from 1");
+    for (const char residue : aTest.substr(residues_start)) {
+        if ((residue < 'A' || residue > 'Z') && residue != '-')
+            throw std::runtime_error("invalid test \"" + std::string{aTest} + "\", residue must be A-Z or -");
+        test.mask |= residue_bit(residue);
     }
-    return r;
-
-    // ----------------------------------------------------------------------
-    // Before 2018-09-19
-    // ----------------------------------------------------------------------
-    //   // 84N+162N+216T - 6B.1, 152T+173I+501E - 6B.2
-    //   // ? 156 (see A/PUERTO RICO/15/2018 of CDC:20180511)
-    // auto r = std::vector<std::string>();
-    // auto const pos84i = 83 - aShift;
-    // if (pos84i > 0) {
-    //     const size_t pos84 = static_cast<size_t>(pos84i);
-    //     if (aSequence.size() > pos84 && aSequence[pos84] == 'N') {
-    //         const size_t pos162 = static_cast<size_t>(161 - aShift);
-    //         const size_t pos216 = static_cast<size_t>(215 - aShift);
-    //         if (aSequence.size() > pos216 && aSequence[pos162] == 'N' && aSequence[pos216] == 'T')
-    //             r.push_back("6B1");
-    //     }
-
-    //     const size_t pos152 = static_cast<size_t>(151 - aShift);
-    //     const size_t pos173 = static_cast<size_t>(172 - aShift);
-    //     const size_t pos501 = static_cast<size_t>(500 - aShift);
-    //     if (aSequence.size() > pos501 && aSequence[pos152] == 'T' && aSequence[pos173] == 'I' && aSequence[pos501] == 'E')
-    //         r.push_back("6B2");
-    // }
-    // return r;
-
-} // clades_h1pdm
+    if (negate)
+        test.mask = residue_any & ~test.mask;
+    return test;
+
+} // CladeDefinitions::parse_test
 
 // ----------------------------------------------------------------------
 
-// HK68 TY155
-// EN72 Transition QK189
-// VI75 Transition GE158+DN193
-// TX77 Transition KE156
-// BK79 Transition SY159 (within cluster)+YH155+KR189
-// SI87 Transition NK145 to BE89
-// SI87 Transition EK156 + SD133(for direction) to BE92
-// BE92 Transition NK145 to WU95
-// WU95 Transition KQ156+EK158 to SY97
-// SY97 Transition HT155+QH156 to FU02
-
-// Fu02-> Cal04 most likely KN145
-// CA04 - WI05: K145N
-// WI05 - PE09: S193F + K158N
-// PE09 - SW13: F159S
-// PE09 - HK14: F159Y
-
-// https://notebooks.antigenic-cartography.org/eu/results/eu/2019-0118-clades/clades.org
-// /scp:albertine:/syn/eu/ac/results/eu/2019-0118-clades/clades.org
-
-struct PosAA
+CladeDefinitions::test_mask_t CladeDefinitions::residue_bit(char aResidue)
 {
-    int pos;
-    char aa;
-};
+    if (aResidue >= 'A' && aResidue <= 'Z')
+        return 1U << (aResidue - 'A');
+    else if (aResidue == '-')
+        return residue_deletion;
+    else
+        return residue_other;
+
+} // CladeDefinitions::residue_bit
 
-struct CladeDesc
+// ----------------------------------------------------------------------
+
+std::optional<std::vector<std::string>> CladeDefinitions::clades(std::string_view aSequence, Shift aShift, std::string_view aVirusType, std::string_view aLineage) const
 {
-    const char* clade;
-    std::vector<PosAA> pos_aa;
-};
+    const auto* subtype = find_subtype(aVirusType, aLineage);
+    if (!subtype)
+        return std::nullopt;
+
+      // every test is made once, whatever number of definitions share it, bits are on the stack for up to 256 tests
+    const size_t words = (subtype->tests.size() + 63) / 64;
+    std::array<uint64_t, 4> passed_on_stack{};
+    test_bits_t passed_on_heap(words > passed_on_stack.size() ? words : 0, 0);
+    uint64_t* passed = words > passed_on_stack.size() ? passed_on_heap.data() : passed_on_stack.data();
+    for (size_t test_no = 0; test_no < subtype->tests.size(); ++test_no) {
+        const auto& test = subtype->tests[test_no];
+        const auto offset = static_cast<size_t>(static_cast<int>(test.pos) - 1 - aShift);
+        const auto residue = offset < aSequence.size() ? residue_bit(aSequence[offset]) : residue_beyond;
+        passed[test_no / 64] |= uint64_t{(test.mask & residue) != 0} << (test_no % 64);
+    }
+
+    std::vector<std::string> result;
+    std::vector<bool> group_assigned(subtype->groups.size(), false);
+    for (const auto& clade : subtype->clades) {
+        if (clade.group != no_group && group_assigned[clade.group])
+            continue;
+        bool matches = true;
+        for (size_t word = 0; word < words && matches; ++word)
+            matches = (clade.tests[word] & ~passed[word]) == 0;
+        if (matches) {
+            result.push_back(clade.name);
+            if (clade.group != no_group)
+                group_assigned[clade.group] = true;
+        }
+    }
+    return result;
+
+} // CladeDefinitions::clades
+
+// ----------------------------------------------------------------------
+
+uint64_t CladeDefinitions::hash(std::string_view aSequence, Shift aShift, std::string_view aVirusType, std::string_view aLineage) const
+{
+    const auto shift = static_cast<Shift::ShiftT>(aShift);
+    auto hash = fnv1a_hash(std::string_view(reinterpret_cast<const char*>(&shift), sizeof(shift)), mHash);
+    hash = fnv1a_hash(aLineage, fnv1a_hash("\t", fnv1a_hash(aVirusType, hash)));
+    if (const auto* subtype = find_subtype(aVirusType, aLineage); subtype) {
+        for (const auto pos : subtype->positions) {
+            const auto offset = static_cast<size_t>(static_cast<int>(pos) - 1 - aShift);
+            const char residue = offset < aSequence.size() ? aSequence[offset] : ' ';
+            hash = fnv1a_hash(std::string_view(&residue, 1), hash);
+        }
+    }
+    return hash == 0 ? 1 : hash;
+
+} // CladeDefinitions::hash
+
+// ----------------------------------------------------------------------
 
 #pragma GCC diagnostic push
 #ifdef __clang__
@@ -163,40 +248,32 @@ struct CladeDesc
 #pragma GCC diagnostic ignored "-Wglobal-constructors"
 #endif
 
-static const std::array sClades
-{
-    CladeDesc{"3C.3",  {{158, 'N'}, {159, 'F'}}},
-    CladeDesc{"3A",    {{138, 'S'}, {159, 'S'}, {225, 'D'}, {326, 'R'}}},
-    CladeDesc{"3B",    {{ 62, 'K'}, { 83, 'R'}, {261, 'Q'}}},
-    CladeDesc{"2A",    {{158, 'N'}, {159, 'Y'}}},
-    CladeDesc{"2A1",   {{158, 'N'}, {159, 'Y'}, {171, 'K'}, {406, 'V'}, {484, 'E'}}},
-    CladeDesc{"2A1A",  {{121, 'K'}, {135, 'K'}, {158, 'N'}, {159, 'Y'}, {171, 'K'}, {406, 'V'}, {479, 'E'}, {484, 'E'}}},
-    CladeDesc{"2A1B",  {{ 92, 'R'}, {121, 'K'}, {158, 'N'}, {159, 'Y'}, {171, 'K'}, {311, 'Q'}, {406, 'V'}, {484, 'E'}}},
-    CladeDesc{"2A2",   {{131, 'K'}, {142, 'K'}, {158, 'N'}, {159, 'Y'}, {261, 'Q'}}},
-    CladeDesc{"2A3",   {{121, 'K'}, {135, 'K'}, {144, 'K'}, {150, 'K'}, {158, 'N'}, {159, 'Y'}, {261, 'Q'}}},
-    CladeDesc{"2A4",   {{ 31, 'S'}, { 53, 'N'}, {142, 'G'}, {144, 'R'}, {158, 'N'}, {159, 'Y'}, {171, 'K'}, {192, 'T'}, {197, 'H'}}},
-    CladeDesc{"GLY",   {{160, 'S'}}},
-    CladeDesc{"GLY",   {{160, 'T'}}},
-    CladeDesc{"159S",  {{159, 'S'}}}, // explicit Derek's request on 2019-04-18
-    CladeDesc{"159F",  {{159, 'F'}}}, // explicit Derek's request on 2019-04-18
-    CladeDesc{"159Y",  {{159, 'Y'}}}, // explicit Derek's request on 2019-04-18
-};
+static std::string sCladeDefinitionsFilename = acmacs::acmacsd_root() + "/share/conf/clades.json";
+static std::unique_ptr<CladeDefinitions> sCladeDefinitions;
+static std::mutex sCladeDefinitionsAccess;
 
 #pragma GCC diagnostic pop
 
-std::vector<std::string> seqdb::clades_h3n2(std::string_view aSequence, Shift aShift, std::string_view /*aName*/)
+void seqdb::clade_definitions_setup(std::string_view aFilename)
 {
-    auto has_aa = [aShift,&aSequence](const auto& pos_aa) -> bool { return aa_at(pos_aa.pos, aSequence, aShift) == pos_aa.aa; };
-
-    std::vector<std::string> r;
-    for (const auto& clade_desc : sClades) {
-        if (std::all_of(clade_desc.pos_aa.begin(), clade_desc.pos_aa.end(), has_aa))
-            r.emplace_back(clade_desc.clade);
+    std::lock_guard<std::mutex> lock(sCladeDefinitionsAccess);
+    if (!aFilename.empty() && aFilename != sCladeDefinitionsFilename) {
+        sCladeDefinitionsFilename = aFilename;
+        sCladeDefinitions.reset();
     }
 
-    return r;
+} // seqdb::clade_definitions_setup
+
+// ----------------------------------------------------------------------
+
+const CladeDefinitions& seqdb::clade_definitions()
+{
+    std::lock_guard<std::mutex> lock(sCladeDefinitionsAccess);
+    if (!sCladeDefinitions)
+        sCladeDefinitions = std::make_unique<CladeDefinitions>(sCladeDefinitionsFilename);
+    return *sCladeDefinitions;
 
-} // clades_h3n2
+} // seqdb::clade_definitions
 
 // ----------------------------------------------------------------------
 /// Local Variables:
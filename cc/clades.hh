@@ -1,7 +1,11 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <optional>
+#include <limits>
+#include <cstdint>
 
 #include "seqdb/sequence-shift.hh"
 
@@ -9,10 +13,73 @@
 
 namespace seqdb
 {
-    std::vector<std::string> clades_b_yamagata(std::string_view aSequence, Shift aShift, std::string_view aName);
-    std::vector<std::string> clades_b_victoria(std::string_view aSequence, Shift aShift, std::string_view aName);
-    std::vector<std::string> clades_h1pdm(std::string_view aSequence, Shift aShift, std::string_view aName);
-    std::vector<std::string> clades_h3n2(std::string_view aSequence, Shift aShift, std::string_view aName);
+      // Clade definitions loaded from json (conf/clades.json, see there for the format). Every definition
+      // is a list of tests "<pos><residues>": one of the residues ('-' for deletion) is at the position
+      // (counts from 1), or "!<pos><residues>": none of them is there. Tests are compiled into
+      // (position, residue mask) pairs shared by all definitions of a virus type and lineage, so every
+      // test is made once per sequence, a definition matches if all its test bits are set.
+      // Definitions of the same virus type and lineage having the same non-empty group are alternatives:
+      // just the first matching one is assigned.
+    class CladeDefinitions
+    {
+     public:
+        CladeDefinitions(std::string_view aFilename); // throws std::runtime_error
+
+          // nullopt if there are no definitions for aVirusType and aLineage
+        std::optional<std::vector<std::string>> clades(std::string_view aSequence, Shift aShift, std::string_view aVirusType, std::string_view aLineage) const;
+
+          // hash of the definitions, virus type, lineage, shift (must be valid) and the residues at the positions
+          // tested for the virus type and lineage: clades of a sequence having the same hash are the same
+          // (see SeqdbSeq::clades_hash()), never 0
+        uint64_t hash(std::string_view aSequence, Shift aShift, std::string_view aVirusType, std::string_view aLineage) const;
+
+        const std::string& filename() const { return mFilename; }
+
+     private:
+        using test_mask_t = uint32_t;       // residues passing test: bit 0-25 - A-Z, 26 - '-', 27 - other symbols, 28 - position beyond sequence
+        using test_bits_t = std::vector<uint64_t>;
+
+        struct test_t
+        {
+            size_t pos;         // counts from 1
+            test_mask_t mask;
+            bool operator==(const test_t& aNother) const { return pos == aNother.pos && mask == aNother.mask; }
+        };
+
+        struct clade_t
+        {
+            std::string name;
+            test_bits_t tests;  // bit n - test n of subtype must pass
+            size_t group;       // index in subtype_t::groups or no_group
+        };
+
+        static constexpr const size_t no_group = std::numeric_limits<size_t>::max();
+
+        struct subtype_t
+        {
+            std::string virus_type;
+            std::string lineage; // empty - any lineage
+            std::vector<test_t> tests;
+            std::vector<clade_t> clades;
+            std::vector<std::string> groups;
+            std::vector<size_t> positions; // tested by any clade, sorted, used by hash()
+        };
+
+        std::string mFilename;
+        std::vector<subtype_t> mSubtypes;
+        uint64_t mHash;         // of the definitions in the file order, comments are ignored
+
+        static test_t parse_test(std::string_view aTest);
+        static test_mask_t residue_bit(char aResidue);
+        void add(std::string_view aVirusType, std::string_view aLineage, std::string_view aClade, std::string_view aGroup, const std::vector<std::string>& aTests);
+        const subtype_t* find_subtype(std::string_view aVirusType, std::string_view aLineage) const;
+
+    }; // class CladeDefinitions
+
+      // Definitions are read from aFilename (default: $ACMACSD_ROOT/share/conf/clades.json) on the first use,
+      // clade_definitions() throws std::runtime_error if the file does not exist or cannot be parsed.
+    void clade_definitions_setup(std::string_view aFilename);
+    const CladeDefinitions& clade_definitions();
 
       // Note aPos in a human notation, i.e. starts with 1
     inline char aa_at(int aPos, std::string_view aSequence, Shift aShift)
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "acmacs-base/string.hh"
+#include "seqdb/filter-plan.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+SeqdbStatistics::SeqdbStatistics(const Seqdb& aSeqdb)
+    : mEntries(aSeqdb.entries().size())
+{
+    mDates.reserve(mEntries);
+    for (const auto& entry : aSeqdb.entries()) {
+        ++mSubtypes[entry.mVirusType];
+        ++mLineages[entry.mLineage];
+        ++mContinents[entry.mContinent];
+        ++mCountries[entry.mCountry];
+        mDates.push_back(entry.mDates.empty() ? std::string{"0000-00-00"} : entry.mDates.back());
+        for (const auto& seq : entry.mSeq) {
+            ++mSeqs;
+            if (seq.aligned())
+                ++mAligned;
+            if (!seq.mHiNames.empty())
+                ++mWithHiNames;
+            ++mGenes[seq.mGene];
+            for (const auto& lab_ids : seq.mLabIds)
+                ++mLabs[lab_ids.first];
+            for (const auto& clade : seq.mClades)
+                ++mClades[clade];
+        }
+    }
+    std::sort(mDates.begin(), mDates.end());
+
+} // SeqdbStatistics::SeqdbStatistics
+
+// ----------------------------------------------------------------------
+
+double SeqdbStatistics::date_range_fraction(std::string_view aBegin, std::string_view aEnd) const
+{
+    if (mDates.empty())
+        return 0.0;
+    const auto first = aBegin.empty() ? mDates.begin() : std::lower_bound(mDates.begin(), mDates.end(), aBegin);
+    const auto last = aEnd.empty() ? mDates.end() : std::lower_bound(mDates.begin(), mDates.end(), aEnd);
+    return first < last ? static_cast<double>(last - first) / static_cast<double>(mDates.size()) : 0.0;
+
+} // SeqdbStatistics::date_range_fraction
+
+// ----------------------------------------------------------------------
+
+// Relative costs of predicates, string comparison is 1
+constexpr const double sCostCompare = 1.0;
+constexpr const double sCostDateRange = 2.0;
+constexpr const double sCostMapLookup = 5.0;
+constexpr const double sCostClade = 3.0;
+constexpr const double sCostNameCandidate = 4.0;
+constexpr const double sCostNameRegex = 200.0;
+  // regex is not analyzed, assume it passes half of the sequences
+constexpr const double sNameRegexPassRate = 0.5;
+
+FilterPlan::FilterPlan(const SeqdbFilter& aFilter, const Seqdb& aSeqdb, bool aCollectTimings)
+    : mNameMatcher(aFilter.mNameMatcher), mNameCandidates(aFilter.mNameCandidates), mSeqdb(&aSeqdb), mCollectTimings(aCollectTimings)
+{
+    if (!aFilter.mSubtype.empty())
+        mEntryPredicates.emplace_back(predicate::subtype, sCostCompare, aFilter.mSubtype);
+    if (!aFilter.mLineage.empty())
+        mEntryPredicates.emplace_back(predicate::lineage, sCostCompare, aFilter.mLineage);
+    if (!aFilter.mContinent.empty())
+        mEntryPredicates.emplace_back(predicate::continent, sCostCompare, aFilter.mContinent);
+    if (!aFilter.mCountry.empty())
+        mEntryPredicates.emplace_back(predicate::country, sCostCompare, aFilter.mCountry);
+    if (!aFilter.mBegin.empty() || !aFilter.mEnd.empty())
+        mEntryPredicates.emplace_back(predicate::date_range, sCostDateRange, aFilter.mBegin, aFilter.mEnd);
+
+    if (aFilter.mAligned)
+        mSeqPredicates.emplace_back(predicate::aligned, sCostCompare);
+    if (!aFilter.mGene.empty())
+        mSeqPredicates.emplace_back(predicate::gene, sCostCompare, aFilter.mGene);
+    if (aFilter.mHasHiName)
+        mSeqPredicates.emplace_back(predicate::hi_name, sCostCompare);
+    if (!aFilter.mLab.empty())
+        mSeqPredicates.emplace_back(predicate::lab, sCostMapLookup, aFilter.mLab);
+    if (!aFilter.mLabId.first.empty())
+        mSeqPredicates.emplace_back(predicate::labid, sCostMapLookup * 2, aFilter.mLabId.first, aFilter.mLabId.second);
+    if (!aFilter.mClade.empty())
+        mSeqPredicates.emplace_back(predicate::clade, sCostClade, aFilter.mClade);
+    if (mNameMatcher) {
+        if (mNameCandidates)
+            mSeqPredicates.emplace_back(predicate::name_candidate, sCostNameCandidate);
+        mSeqPredicates.emplace_back(predicate::name_regex, sCostNameRegex, aFilter.mNameRegex);
+    }
+
+      // statistics are collected by scanning the whole seqdb, that is not needed to order a single predicate
+      // (name index candidate check always precedes the regex)
+    const auto orderable = [](const std::vector<Predicate>& predicates) { return std::count_if(predicates.begin(), predicates.end(), [](const auto& pred) { return pred.kind != predicate::name_candidate; }) > 1; };
+    if (aFilter.mReportPlan || orderable(mEntryPredicates) || orderable(mSeqPredicates)) {
+        const auto& statistics = aSeqdb.statistics();
+        for (auto* predicates : {&mEntryPredicates, &mSeqPredicates}) {
+            for (auto& pred : *predicates)
+                pred.pass_rate = estimate_pass_rate(pred, statistics);
+        }
+    }
+
+    order(mEntryPredicates);
+    order(mSeqPredicates);
+
+} // FilterPlan::FilterPlan
+
+// ----------------------------------------------------------------------
+
+double FilterPlan::estimate_pass_rate(const Predicate& aPredicate, const SeqdbStatistics& aStatistics) const
+{
+    const auto seq_fraction = [&aStatistics](size_t count) { return aStatistics.mSeqs ? static_cast<double>(count) / static_cast<double>(aStatistics.mSeqs) : 0.0; };
+    switch (aPredicate.kind) {
+      case predicate::subtype:
+          return aStatistics.entry_fraction(aStatistics.mSubtypes, aPredicate.value);
+      case predicate::lineage:
+          return aStatistics.entry_fraction(aStatistics.mLineages, aPredicate.value);
+      case predicate::continent:
+          return aStatistics.entry_fraction(aStatistics.mContinents, aPredicate.value);
+      case predicate::country:
+          return aStatistics.entry_fraction(aStatistics.mCountries, aPredicate.value);
+      case predicate::date_range:
+          return aStatistics.date_range_fraction(aPredicate.value, aPredicate.value2);
+      case predicate::aligned:
+          return seq_fraction(aStatistics.mAligned);
+      case predicate::gene:
+          return aStatistics.seq_fraction(aStatistics.mGenes, aPredicate.value);
+      case predicate::hi_name:
+          return seq_fraction(aStatistics.mWithHiNames);
+      case predicate::lab:
+          return aStatistics.seq_fraction(aStatistics.mLabs, aPredicate.value);
+      case predicate::labid:
+          return aStatistics.seq_fraction(aStatistics.mLabs, aPredicate.value) > 0.0 ? seq_fraction(1) : 0.0;
+      case predicate::clade:
+          return aStatistics.seq_fraction(aStatistics.mClades, aPredicate.value);
+      case predicate::name_candidate:
+          return seq_fraction(mNameCandidates->size());
+      case predicate::name_regex:
+          return sNameRegexPassRate;
+    }
+    return 0.0;
+
+} // FilterPlan::estimate_pass_rate
+
+// ----------------------------------------------------------------------
+
+// Predicate with the smallest cost per rejected item goes first
+void FilterPlan::order(std::vector<Predicate>& aPredicates)
+{
+    const auto rank = [](const Predicate& pred) {
+        const auto rejects = 1.0 - pred.pass_rate;
+        return rejects > 0.0 ? pred.cost / rejects : std::numeric_limits<double>::max();
+    };
+    std::stable_sort(aPredicates.begin(), aPredicates.end(), [&rank](const auto& p1, const auto& p2) { return rank(p1) < rank(p2); });
+
+      // name index candidate check must precede regex: regex is not run for non-candidates
+    const auto candidate = std::find_if(aPredicates.begin(), aPredicates.end(), [](const auto& pred) { return pred.kind == predicate::name_candidate; });
+    const auto regex = std::find_if(aPredicates.begin(), aPredicates.end(), [](const auto& pred) { return pred.kind == predicate::name_regex; });
+    if (candidate != aPredicates.end() && regex < candidate)
+        std::rotate(regex, candidate, std::next(candidate));
+
+} // FilterPlan::order
+
+// ----------------------------------------------------------------------
+
+bool FilterPlan::evaluate(const Predicate& aPredicate, const SeqdbEntry& aEntry) const
+{
+    switch (aPredicate.kind) {
+      case predicate::subtype:
+          return aEntry.mVirusType == aPredicate.value;
+      case predicate::lineage:
+          return aEntry.mLineage == aPredicate.value;
+      case predicate::continent:
+          return aEntry.mContinent == aPredicate.value;
+      case predicate::country:
+          return aEntry.mCountry == aPredicate.value;
+      case predicate::date_range: {
+          const std::string_view date = aEntry.mDates.empty() ? std::string_view{"0000-00-00"} : std::string_view{aEntry.mDates.back()};
+          return (aPredicate.value.empty() || date >= aPredicate.value) && (aPredicate.value2.empty() || date < aPredicate.value2);
+      }
+      default:
+          break;
+    }
+    return true;
+
+} // FilterPlan::evaluate
+
+// ----------------------------------------------------------------------
+
+bool FilterPlan::evaluate(const Predicate& aPredicate, const SeqdbEntry& /*aEntry*/, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const
+{
+    switch (aPredicate.kind) {
+      case predicate::aligned:
+          return aSeq.aligned();
+      case predicate::gene:
+          return aSeq.mGene == aPredicate.value;
+      case predicate::hi_name:
+          return !aSeq.mHiNames.empty();
+      case predicate::lab:
+          return aSeq.mLabIds.find(aPredicate.value) != aSeq.mLabIds.end();
+      case predicate::labid:
+          if (const auto found = aSeq.mLabIds.find(aPredicate.value); found != aSeq.mLabIds.end())
+              return std::find(found->second.begin(), found->second.end(), aPredicate.value2) != found->second.end();
+          return false;
+      case predicate::clade:
+          return aSeq.has_clade(aPredicate.value);
+      case predicate::name_candidate:
+          return std::binary_search(mNameCandidates->begin(), mNameCandidates->end(), seq_ref_t{aEntryNo, aSeqNo});
+      case predicate::name_regex: {
+          const auto name = mSeqdb->seq_names().name(aEntryNo, aSeqNo);
+          return std::regex_search(name.begin(), name.end(), *mNameMatcher);
+      }
+      default:
+          break;
+    }
+    return true;
+
+} // FilterPlan::evaluate
+
+// ----------------------------------------------------------------------
+
+template <typename ... Args> bool FilterPlan::evaluate_timed(const Predicate& aPredicate, Args&& ... args) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool result = evaluate(aPredicate, std::forward<Args>(args) ...);
+    aPredicate.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++aPredicate.calls;
+    if (!result)
+        ++aPredicate.rejected;
+    return result;
+
+} // FilterPlan::evaluate_timed
+
+// ----------------------------------------------------------------------
+
+bool FilterPlan::suitable_entry(const SeqdbEntry& aEntry) const
+{
+    if (mCollectTimings)
+        return std::all_of(mEntryPredicates.begin(), mEntryPredicates.end(), [&](const auto& pred) { return evaluate_timed(pred, aEntry); });
+    else
+        return std::all_of(mEntryPredicates.begin(), mEntryPredicates.end(), [&](const auto& pred) { return evaluate(pred, aEntry); });
+
+} // FilterPlan::suitable_entry
+
+// ----------------------------------------------------------------------
+
+bool FilterPlan::suitable_seq(const SeqdbEntry& aEntry, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const
+{
+    if (mCollectTimings)
+        return std::all_of(mSeqPredicates.begin(), mSeqPredicates.end(), [&](const auto& pred) { return evaluate_timed(pred, aEntry, aSeq, aEntryNo, aSeqNo); });
+    else
+        return std::all_of(mSeqPredicates.begin(), mSeqPredicates.end(), [&](const auto& pred) { return evaluate(pred, aEntry, aSeq, aEntryNo, aSeqNo); });
+
+} // FilterPlan::suitable_seq
+
+// ----------------------------------------------------------------------
+
+std::string FilterPlan::report() const
+{
+    const auto name = [](predicate kind) -> const char* {
+        switch (kind) {
+          case predicate::subtype: return "subtype";
+          case predicate::lineage: return "lineage";
+          case predicate::continent: return "continent";
+          case predicate::country: return "country";
+          case predicate::date_range: return "date-range";
+          case predicate::aligned: return "aligned";
+          case predicate::gene: return "gene";
+          case predicate::hi_name: return "hi-name";
+          case predicate::lab: return "lab";
+          case predicate::labid: return "labid";
+          case predicate::clade: return "clade";
+          case predicate::name_candidate: return "name-index";
+          case predicate::name_regex: return "name-regex";
+        }
+        return "?";
+    };
+
+    std::string result{"Filter plan:\n"};
+    const auto report_stage = [&](const char* stage, const std::vector<Predicate>& predicates) {
+        for (const auto& pred : predicates) {
+            result += fmt::format("  {:5s} {:12s} {:30s} est-pass:{:6.3f} cost:{:5.1f}", stage, name(pred.kind), pred.value2.empty() ? pred.value : pred.value + ' ' + pred.value2, pred.pass_rate, pred.cost);
+            if (mCollectTimings)
+                result += fmt::format("  calls:{:8d} rejected:{:8d} time:{:.6f}s", pred.calls, pred.rejected, pred.seconds);
+            result += '\n';
+        }
+    };
+    report_stage("entry", mEntryPredicates);
+    report_stage("seq", mSeqPredicates);
+    return result;
+
+} // FilterPlan::report
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <regex>
+#include <functional>
+
+#include "seqdb/name-index.hh"
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+    class SeqdbEntry;
+    class SeqdbSeq;
+    class SeqdbFilter;
+
+      // Value frequencies of filterable attributes, used to estimate selectivity of filter predicates
+    class SeqdbStatistics
+    {
+     public:
+        SeqdbStatistics(const Seqdb& aSeqdb);
+
+        using counter_t = std::map<std::string, size_t, std::less<>>;
+
+          // fraction of entries/seqs having the value, 0.0 if value was not found
+        double entry_fraction(const counter_t& aCounter, std::string_view aValue) const { return fraction(aCounter, aValue, mEntries); }
+        double seq_fraction(const counter_t& aCounter, std::string_view aValue) const { return fraction(aCounter, aValue, mSeqs); }
+          // fraction of entries whose date is within [aBegin, aEnd)
+        double date_range_fraction(std::string_view aBegin, std::string_view aEnd) const;
+
+        size_t mEntries = 0;
+        size_t mSeqs = 0;
+        size_t mAligned = 0;
+        size_t mWithHiNames = 0;
+        counter_t mSubtypes, mLineages, mContinents, mCountries; // per entry
+        counter_t mGenes, mLabs, mClades;                        // per seq
+        std::vector<std::string> mDates;                         // per entry, sorted, "0000-00-00" for entries without date
+
+     private:
+        static double fraction(const counter_t& aCounter, std::string_view aValue, size_t aTotal)
+            {
+                if (const auto found = aCounter.find(aValue); found != aCounter.end() && aTotal > 0)
+                    return static_cast<double>(found->second) / static_cast<double>(aTotal);
+                return 0.0;
+            }
+
+    }; // class SeqdbStatistics
+
+// ----------------------------------------------------------------------
+
+      // SeqdbFilter compiled into the list of predicates ordered by estimated selectivity and cost:
+      // predicates that are cheap and reject most of the data go first. Entry level predicates are
+      // evaluated before and separately from the sequence level ones, i.e. a rejected entry is never
+      // looked into. Seqdb statistics are collected just if there are predicates to order or the plan is
+      // reported. Names of sequences for the name regex predicate are taken from aSeqdb at evaluation time,
+      // i.e. the plan stays valid after Seqdb::reset_indexes().
+    class FilterPlan
+    {
+     public:
+        FilterPlan(const SeqdbFilter& aFilter, const Seqdb& aSeqdb, bool aCollectTimings);
+
+        bool suitable_entry(const SeqdbEntry& aEntry) const;
+        bool suitable_seq(const SeqdbEntry& aEntry, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const;
+        bool empty() const { return mEntryPredicates.empty() && mSeqPredicates.empty(); }
+
+          // predicates in the evaluation order with estimations and, if collected, timings
+        std::string report() const;
+
+     private:
+        enum class predicate { subtype, lineage, continent, country, date_range, aligned, gene, hi_name, lab, labid, clade, name_candidate, name_regex };
+
+        struct Predicate
+        {
+            Predicate(predicate aKind, double aCost, std::string_view aValue = {}, std::string_view aValue2 = {})
+                : kind(aKind), cost(aCost), value(aValue), value2(aValue2) {}
+
+            predicate kind;
+            double pass_rate = 0.0; // estimated fraction of entries/seqs passing, 0.0 if not estimated
+            double cost;        // relative cost of evaluation
+            std::string value;
+            std::string value2;
+            mutable size_t calls = 0;
+            mutable size_t rejected = 0;
+            mutable double seconds = 0.0;
+        };
+
+        std::vector<Predicate> mEntryPredicates;
+        std::vector<Predicate> mSeqPredicates;
+        std::shared_ptr<const std::regex> mNameMatcher;
+        std::shared_ptr<const seq_refs_t> mNameCandidates;
+        const Seqdb* mSeqdb;
+        bool mCollectTimings;
+
+        double estimate_pass_rate(const Predicate& aPredicate, const SeqdbStatistics& aStatistics) const;
+        bool evaluate(const Predicate& aPredicate, const SeqdbEntry& aEntry) const;
+        bool evaluate(const Predicate& aPredicate, const SeqdbEntry& aEntry, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const;
+        template <typename ... Args> bool evaluate_timed(const Predicate& aPredicate, Args&& ... args) const;
+        static void order(std::vector<Predicate>& aPredicates);
+
+    }; // class FilterPlan
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
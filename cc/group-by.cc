@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "acmacs-base/string.hh"
+#include "seqdb/group-by.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+  // "YYYY-MM-DD", "YYYY-MM" -> (year << 4 | month), "YYYY" -> (year << 4), 0 if date is empty or in another form
+static inline attribute_id_t pack_date(std::string_view aDate)
+{
+    const auto number = [aDate](size_t offset, size_t size) -> int {
+        if (aDate.size() < (offset + size))
+            return -1;
+        int value = 0;
+        for (const char digit : aDate.substr(offset, size)) {
+            if (digit < '0' || digit > '9')
+                return -1;
+            value = value * 10 + (digit - '0');
+        }
+        return value;
+    };
+
+    const auto year = number(0, 4);
+    if (year <= 0 || year > 4095)
+        return 0;
+    if (aDate.size() == 4)
+        return static_cast<attribute_id_t>(year << 4);
+    if (const auto month = number(5, 2); aDate[4] == '-' && month >= 1 && month <= 12)
+        return static_cast<attribute_id_t>((year << 4) | month);
+    return 0;
+
+} // pack_date
+
+// ----------------------------------------------------------------------
+
+static const std::array<std::pair<group_key, std::string_view>, 13> sGroupKeyNames{{
+    {group_key::subtype, "subtype"},
+    {group_key::lineage, "lineage"},
+    {group_key::continent, "continent"},
+    {group_key::country, "country"},
+    {group_key::year, "year"},
+    {group_key::month, "month"},
+    {group_key::lab, "lab"},
+    {group_key::clade, "clade"},
+    {group_key::clade_set, "clade_set"},
+    {group_key::hi_matched, "hi_matched"},
+    {group_key::aligned, "aligned"},
+    {group_key::has_date, "has_date"},
+    {group_key::has_clades, "has_clades"},
+}};
+
+std::string_view seqdb::to_string(group_key aKey)
+{
+    for (const auto& [key, name] : sGroupKeyNames) {
+        if (key == aKey)
+            return name;
+    }
+    return "?";
+
+} // seqdb::to_string
+
+// ----------------------------------------------------------------------
+
+group_key seqdb::group_key_from_string(std::string_view aName)
+{
+    for (const auto& [key, name] : sGroupKeyNames) {
+        if (name == aName)
+            return key;
+    }
+    throw std::runtime_error("unknown group key: \"" + std::string{aName} + "\"");
+
+} // seqdb::group_key_from_string
+
+// ----------------------------------------------------------------------
+
+attribute_id_t AttributeIndex::Dictionary::intern(std::string_view aValue)
+{
+    if (const auto found = mIds.find(aValue); found != mIds.end())
+        return found->second;
+    if (mValues.size() > std::numeric_limits<attribute_id_t>::max())
+        throw std::runtime_error("AttributeIndex: too many distinct values of an attribute");
+    const auto id = static_cast<attribute_id_t>(mValues.size());
+    mValues.emplace_back(aValue);
+    mIds.emplace(mValues.back(), id);
+    return id;
+
+} // AttributeIndex::Dictionary::intern
+
+// ----------------------------------------------------------------------
+
+AttributeIndex::AttributeIndex(const Seqdb& aSeqdb)
+{
+    mEntries.reserve(aSeqdb.entries().size());
+    mSeqs.reserve(aSeqdb.number_of_seqs() + 1);
+    for (const auto& entry : aSeqdb.entries()) {
+        mEntries.push_back({mSubtypes.intern(entry.virus_type()), mLineages.intern(entry.lineage()), mContinents.intern(entry.continent()), mCountries.intern(entry.country()),
+                            date_ids(entry.date()), !entry.dates().empty(), static_cast<uint32_t>(mSeqs.size())});
+        for (const auto& seq : entry.seqs()) {
+            mSeqs.push_back({mCladeSets.intern(string::join(" ", seq.clades())), seq.matched(), seq.aligned(), static_cast<uint32_t>(mCladeIds.size()), static_cast<uint32_t>(mLabIds.size())});
+            for (const auto& clade : seq.clades())
+                mCladeIds.push_back(mClades.intern(clade));
+            for (const auto& lab_ids : seq.lab_ids_raw())
+                mLabIds.push_back(mLabs.intern(lab_ids.first));
+        }
+    }
+    mSeqs.push_back({0, false, false, static_cast<uint32_t>(mCladeIds.size()), static_cast<uint32_t>(mLabIds.size())}); // sentinel
+
+} // AttributeIndex::AttributeIndex
+
+// ----------------------------------------------------------------------
+
+  // Dates not packable (see pack_date) are interned as their first 4 (year) and 7 (month) chars,
+  // i.e. reported as they are, with ids (dictionary id << 4 | sOtherDate).
+AttributeIndex::date_ids_t AttributeIndex::date_ids(std::string_view aDate)
+{
+    if (aDate.empty())
+        return {0, 0};
+    const auto other = [](Dictionary& dictionary, std::string_view value) {
+        const auto id = dictionary.intern(value);
+        if (id > (std::numeric_limits<attribute_id_t>::max() >> 4))
+            throw std::runtime_error("AttributeIndex: too many distinct dates in unrecognized format");
+        return static_cast<attribute_id_t>((id << 4) | sOtherDate);
+    };
+    const auto year = pack_date(aDate.substr(0, 4)), month = pack_date(aDate);
+    return {year != 0 ? year : other(mOtherYears, aDate.substr(0, 4)), month != 0 ? month : other(mOtherMonths, aDate.substr(0, 7))};
+
+} // AttributeIndex::date_ids
+
+// ----------------------------------------------------------------------
+
+const AttributeIndex::Dictionary& AttributeIndex::dictionary(group_key aKey) const
+{
+    switch (aKey) {
+      case group_key::subtype:
+          return mSubtypes;
+      case group_key::lineage:
+          return mLineages;
+      case group_key::continent:
+          return mContinents;
+      case group_key::country:
+          return mCountries;
+      case group_key::lab:
+          return mLabs;
+      case group_key::clade:
+          return mClades;
+      case group_key::clade_set:
+          return mCladeSets;
+      case group_key::year:
+      case group_key::month:
+      case group_key::hi_matched:
+      case group_key::aligned:
+      case group_key::has_date:
+      case group_key::has_clades:
+          break;
+    }
+    throw std::runtime_error("AttributeIndex: no dictionary for group key " + std::to_string(static_cast<int>(aKey)));
+
+} // AttributeIndex::dictionary
+
+// ----------------------------------------------------------------------
+
+void AttributeIndex::ids(group_key aKey, size_t aEntryNo, size_t aSeqRefNo, std::vector<attribute_id_t>& aTarget) const
+{
+    const auto& entry = mEntries[aEntryNo];
+      // entry without sequences: sentinel as both seq and next seq gives empty values of sequence attributes
+    const auto& seq = mSeqs[aSeqRefNo != no_seq ? aSeqRefNo : mSeqs.size() - 1];
+    const auto& next_seq = mSeqs[aSeqRefNo != no_seq ? aSeqRefNo + 1 : mSeqs.size() - 1];
+    const auto multi = [&aTarget](const std::vector<attribute_id_t>& source, uint32_t first, uint32_t last) {
+        if (first == last)
+            aTarget.push_back(0);   // empty value
+        else
+            aTarget.insert(aTarget.end(), source.begin() + first, source.begin() + last);
+    };
+
+    switch (aKey) {
+      case group_key::subtype:
+          aTarget.push_back(entry.subtype);
+          break;
+      case group_key::lineage:
+          aTarget.push_back(entry.lineage);
+          break;
+      case group_key::continent:
+          aTarget.push_back(entry.continent);
+          break;
+      case group_key::country:
+          aTarget.push_back(entry.country);
+          break;
+      case group_key::year:
+          aTarget.push_back(entry.date.year);
+          break;
+      case group_key::month:
+          aTarget.push_back(entry.date.month);
+          break;
+      case group_key::has_date:
+          aTarget.push_back(entry.has_date ? 1 : 0);
+          break;
+      case group_key::lab:
+          multi(mLabIds, seq.first_lab, next_seq.first_lab);
+          break;
+      case group_key::clade:
+          multi(mCladeIds, seq.first_clade, next_seq.first_clade);
+          break;
+      case group_key::clade_set:
+          aTarget.push_back(seq.clade_set);
+          break;
+      case group_key::hi_matched:
+          aTarget.push_back(seq.hi_matched ? 1 : 0);
+          break;
+      case group_key::aligned:
+          aTarget.push_back(seq.aligned ? 1 : 0);
+          break;
+      case group_key::has_clades:
+          aTarget.push_back(seq.first_clade != next_seq.first_clade ? 1 : 0);
+          break;
+    }
+
+} // AttributeIndex::ids
+
+// ----------------------------------------------------------------------
+
+std::string AttributeIndex::value(group_key aKey, attribute_id_t aId) const
+{
+    switch (aKey) {
+      case group_key::year:
+      case group_key::month:
+          if (aId == 0)
+              return {};
+          if ((aId & 0xF) == sOtherDate)
+              return (aKey == group_key::year ? mOtherYears : mOtherMonths)[static_cast<attribute_id_t>(aId >> 4)];
+          if ((aId & 0xF) == 0)
+              return fmt::format("{:04d}", aId >> 4);
+          return fmt::format("{:04d}-{:02d}", aId >> 4, aId & 0xF);
+      case group_key::hi_matched:
+      case group_key::aligned:
+      case group_key::has_date:
+      case group_key::has_clades:
+          return aId ? "yes" : "no";
+      case group_key::subtype:
+      case group_key::lineage:
+      case group_key::continent:
+      case group_key::country:
+      case group_key::lab:
+      case group_key::clade:
+      case group_key::clade_set:
+          break;
+    }
+    return dictionary(aKey)[aId];
+
+} // AttributeIndex::value
+
+// ----------------------------------------------------------------------
+
+GroupByTable::GroupByTable(const group_keys_t& aKeys)
+    : mKeys(aKeys), mValues(aKeys.size())
+{
+    if (aKeys.empty() || aKeys.size() > sMaxKeys)
+        throw std::runtime_error("GroupByTable: invalid number of keys: " + std::to_string(aKeys.size()));
+
+} // GroupByTable::GroupByTable
+
+// ----------------------------------------------------------------------
+
+void GroupByTable::add(const std::vector<std::string_view>& aValues, size_t aEntries, size_t aSeqs)
+{
+    if (aValues.size() != mKeys.size())
+        throw std::runtime_error("GroupByTable::add: invalid number of values: " + std::to_string(aValues.size()) + ", expected: " + std::to_string(mKeys.size()));
+    Row row;
+    row.ids.fill(0);
+    for (size_t key_no = 0; key_no < mKeys.size(); ++key_no) {
+        auto& values = mValues[key_no];
+        if (const auto found = std::find(values.begin(), values.end(), aValues[key_no]); found != values.end()) {
+            row.ids[key_no] = static_cast<attribute_id_t>(found - values.begin());
+        }
+        else {
+            row.ids[key_no] = static_cast<attribute_id_t>(values.size());
+            values.emplace_back(aValues[key_no]);
+        }
+    }
+    row.entries = aEntries;
+    row.seqs = aSeqs;
+    mRows.push_back(row);
+
+} // GroupByTable::add
+
+// ----------------------------------------------------------------------
+
+bool GroupByTable::operator==(const GroupByTable& aNother) const
+{
+    if (mKeys != aNother.mKeys || mRows.size() != aNother.mRows.size())
+        return false;
+    for (size_t row_no = 0; row_no < mRows.size(); ++row_no) {
+        const auto& row = mRows[row_no];
+        const auto& another = aNother.mRows[row_no];
+        if (row.entries != another.entries || row.seqs != another.seqs)
+            return false;
+        for (size_t key_no = 0; key_no < mKeys.size(); ++key_no) {
+            if (value(row, key_no) != aNother.value(another, key_no))
+                return false;
+        }
+    }
+    return true;
+
+} // GroupByTable::operator==
+
+// ----------------------------------------------------------------------
+
+std::map<std::string, size_t> GroupByTable::seqs_by(size_t aKeyNo) const
+{
+    std::map<std::string, size_t> result;
+    for (const auto& row : mRows)
+        result[std::string{value(row, aKeyNo)}] += row.seqs;
+    return result;
+
+} // GroupByTable::seqs_by
+
+// ----------------------------------------------------------------------
+
+std::map<std::string, size_t> GroupByTable::entries_by(size_t aKeyNo) const
+{
+    std::map<std::string, size_t> result;
+    for (const auto& row : mRows)
+        result[std::string{value(row, aKeyNo)}] += row.entries;
+    return result;
+
+} // GroupByTable::entries_by
+
+// ----------------------------------------------------------------------
+
+std::vector<GroupByTable> seqdb::group_by(const Seqdb& aSeqdb, const std::vector<group_keys_t>& aGroupings, const SeqdbFilter& aFilter)
+{
+    for (const auto& keys : aGroupings) {
+        if (keys.empty() || keys.size() > GroupByTable::sMaxKeys)
+            throw std::runtime_error("group_by: invalid number of keys: " + std::to_string(keys.size()) + ", 1.." + std::to_string(GroupByTable::sMaxKeys) + " expected");
+    }
+
+    using packed_t = uint64_t;  // ids of a row packed, 16 bits per key
+    struct counts_t { size_t entries = 0, seqs = 0; };
+    using accumulator_t = std::unordered_map<packed_t, counts_t>;
+
+    const auto& index = aSeqdb.attribute_index();
+    const auto& entries = aSeqdb.entries();
+    SeqdbFilter filter{aFilter};
+    filter.prepare(aSeqdb, false);
+
+    std::vector<std::vector<accumulator_t>> per_thread(parallel_threads(), std::vector<accumulator_t>(aGroupings.size()));
+    const auto threads = parallel_for(entries.size(), [&](size_t first, size_t last, size_t thread_no) {
+        auto& accumulators = per_thread[thread_no];
+        std::vector<std::vector<attribute_id_t>> key_ids(GroupByTable::sMaxKeys);
+        std::vector<packed_t> entry_rows;  // rows the seqs of the current entry fall into, to count entries once per row
+        for (size_t entry_no = first; entry_no < last; ++entry_no) {
+            const auto& entry = entries[entry_no];
+            if (!filter.suitable_entry(entry))
+                continue;
+            for (size_t grouping_no = 0; grouping_no < aGroupings.size(); ++grouping_no) {
+                const auto& keys = aGroupings[grouping_no];
+                auto& accumulator = accumulators[grouping_no];
+                entry_rows.clear();
+                const auto add = [&](size_t seq_ref_no, size_t seqs) {
+                    for (size_t key_no = 0; key_no < keys.size(); ++key_no) {
+                        key_ids[key_no].clear();
+                        index.ids(keys[key_no], entry_no, seq_ref_no, key_ids[key_no]);
+                    }
+                      // cartesian product of key values, more than one value per key for lab and clade only
+                    std::array<size_t, GroupByTable::sMaxKeys> value_no{};
+                    while (true) {
+                        packed_t packed = 0;
+                        for (size_t key_no = 0; key_no < keys.size(); ++key_no)
+                            packed |= static_cast<packed_t>(key_ids[key_no][value_no[key_no]]) << (key_no * 16);
+                        accumulator[packed].seqs += seqs;
+                        entry_rows.push_back(packed);
+                        size_t key_no = 0;
+                        for (; key_no < keys.size(); ++key_no) {
+                            if (++value_no[key_no] < key_ids[key_no].size())
+                                break;
+                            value_no[key_no] = 0;
+                        }
+                        if (key_no == keys.size())
+                            break;
+                    }
+                };
+                if (entry.seqs().empty()) {
+                    add(AttributeIndex::no_seq, 0);
+                }
+                else {
+                    for (size_t seq_no = 0; seq_no < entry.seqs().size(); ++seq_no) {
+                        if (filter.suitable_seq(entry, entry.seqs()[seq_no], entry_no, seq_no))
+                            add(index.first_seq(entry_no) + seq_no, 1);
+                    }
+                }
+                std::sort(entry_rows.begin(), entry_rows.end());
+                for (auto row = entry_rows.begin(); row != entry_rows.end(); row = std::upper_bound(row, entry_rows.end(), *row))
+                    ++accumulator[*row].entries;
+            }
+        }
+    });
+
+    std::vector<GroupByTable> result(aGroupings.size());
+    for (size_t grouping_no = 0; grouping_no < aGroupings.size(); ++grouping_no) {
+        auto& accumulator = per_thread.front()[grouping_no];
+        for (size_t thread_no = 1; thread_no < threads; ++thread_no) {
+            for (const auto& [packed, counts] : per_thread[thread_no][grouping_no]) {
+                auto& target = accumulator[packed];
+                target.entries += counts.entries;
+                target.seqs += counts.seqs;
+            }
+        }
+
+        auto& table = result[grouping_no] = GroupByTable(aGroupings[grouping_no]);
+        std::vector<std::map<attribute_id_t, attribute_id_t>> table_ids(table.mKeys.size()); // index id -> table id
+        for (const auto& [packed, counts] : accumulator) {
+            GroupByTable::Row row;
+            row.ids.fill(0);
+            for (size_t key_no = 0; key_no < table.mKeys.size(); ++key_no) {
+                const auto id = static_cast<attribute_id_t>(packed >> (key_no * 16));
+                if (const auto found = table_ids[key_no].find(id); found != table_ids[key_no].end()) {
+                    row.ids[key_no] = found->second;
+                }
+                else {
+                    row.ids[key_no] = static_cast<attribute_id_t>(table.mValues[key_no].size());
+                    table_ids[key_no].emplace(id, row.ids[key_no]);
+                    table.mValues[key_no].push_back(index.value(table.mKeys[key_no], id));
+                }
+            }
+            row.entries = counts.entries;
+            row.seqs = counts.seqs;
+            table.mRows.push_back(row);
+        }
+        std::sort(table.mRows.begin(), table.mRows.end(), [&table](const auto& r1, const auto& r2) {
+            for (size_t key_no = 0; key_no < table.mKeys.size(); ++key_no) {
+                if (const auto v1 = table.value(r1, key_no), v2 = table.value(r2, key_no); v1 != v2)
+                    return v1 < v2;
+            }
+            return false;
+        });
+    }
+    return result;
+
+} // seqdb::group_by
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
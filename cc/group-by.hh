@@ -0,0 +1,147 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <map>
+#include <limits>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+    class SeqdbFilter;
+
+      // Attributes sequences can be grouped by. lab and clade are multi-valued: a sequence having
+      // several labs (clades) is counted in the group of each of them. Sequences without labs
+      // (clades) fall into the group with the empty value.
+    enum class group_key { subtype, lineage, continent, country, year, month, lab, clade, clade_set, hi_matched, aligned, has_date, has_clades };
+    using group_keys_t = std::vector<group_key>;
+
+    std::string_view to_string(group_key aKey);
+    group_key group_key_from_string(std::string_view aName); // throws std::runtime_error
+
+    using attribute_id_t = uint16_t;
+
+// ----------------------------------------------------------------------
+
+      // Attributes of seqdb entries and sequences interned into small integer ids, dates packed
+      // into (year << 4 | month), month is 0 for year only dates. Built once (see Seqdb::attribute_index())
+      // and used by group-by passes instead of strings.
+    class AttributeIndex
+    {
+     public:
+        AttributeIndex(const Seqdb& aSeqdb);
+
+          // appends ids of aKey for the sequence to aTarget, aSeqRefNo is the number of the sequence in seqdb (see first_seq())
+          // or no_seq for an entry without sequences, its sequence attributes have empty values (no lab, no clade, "no")
+        static constexpr const size_t no_seq = std::numeric_limits<size_t>::max();
+        void ids(group_key aKey, size_t aEntryNo, size_t aSeqRefNo, std::vector<attribute_id_t>& aTarget) const;
+          // value of the attribute with the id, e.g. "2018-03" for month, "yes"/"no" for booleans
+        std::string value(group_key aKey, attribute_id_t aId) const;
+          // number of the first sequence of the entry in seqdb
+        size_t first_seq(size_t aEntryNo) const { return mEntries[aEntryNo].first_seq; }
+
+     private:
+        class Dictionary
+        {
+         public:
+            Dictionary() { intern({}); }
+            attribute_id_t intern(std::string_view aValue);
+            const std::string& operator[](attribute_id_t aId) const { return mValues[aId]; }
+
+         private:
+            std::vector<std::string> mValues;
+            std::map<std::string, attribute_id_t, std::less<>> mIds;
+        };
+
+        static constexpr const attribute_id_t sOtherDate = 0xF; // month of a date in unrecognized format, see date_ids()
+
+        struct date_ids_t { attribute_id_t year, month; };
+
+        struct entry_attributes_t
+        {
+            attribute_id_t subtype, lineage, continent, country;
+            date_ids_t date;
+            bool has_date;
+            uint32_t first_seq;
+        };
+
+        struct seq_attributes_t
+        {
+            attribute_id_t clade_set;
+            bool hi_matched, aligned;
+            uint32_t first_clade, first_lab; // ranges in mCladeIds and mLabIds, the range ends where the range of the next seq begins
+        };
+
+        Dictionary mSubtypes, mLineages, mContinents, mCountries, mLabs, mClades, mCladeSets, mOtherYears, mOtherMonths;
+        std::vector<entry_attributes_t> mEntries;
+        std::vector<seq_attributes_t> mSeqs; // with a sentinel at the end
+        std::vector<attribute_id_t> mCladeIds, mLabIds;
+
+        const Dictionary& dictionary(group_key aKey) const;
+        date_ids_t date_ids(std::string_view aDate);
+
+    }; // class AttributeIndex
+
+// ----------------------------------------------------------------------
+
+      // Result of group-by: one row per combination of key values found in seqdb, rows are sorted by values.
+    class GroupByTable
+    {
+     public:
+        static constexpr const size_t sMaxKeys = 4;
+
+        GroupByTable() = default;
+        GroupByTable(const group_keys_t& aKeys);
+
+        struct Row
+        {
+            std::array<attribute_id_t, sMaxKeys> ids;
+            size_t entries = 0;  // number of entries having at least one sequence in the group (see group_by() for entries without sequences)
+            size_t seqs = 0;     // number of sequences in the group
+        };
+
+        const group_keys_t& keys() const { return mKeys; }
+        size_t size() const { return mRows.size(); }
+        bool empty() const { return mRows.empty(); }
+        const Row& operator[](size_t aRowNo) const { return mRows[aRowNo]; }
+        auto begin() const { return mRows.begin(); }
+        auto end() const { return mRows.end(); }
+
+        std::string_view value(const Row& aRow, size_t aKeyNo) const { return mValues[aKeyNo][aRow.ids[aKeyNo]]; }
+
+          // sums of row counts by value of a single key. Summing entries over rows is exact only if the
+          // other keys are entry level (subtype, lineage, continent, country, year, month, has_date).
+        std::map<std::string, size_t> seqs_by(size_t aKeyNo) const;
+        std::map<std::string, size_t> entries_by(size_t aKeyNo) const;
+
+          // appends row, used to restore table saved elsewhere, aValues are in the order of keys()
+        void add(const std::vector<std::string_view>& aValues, size_t aEntries, size_t aSeqs);
+          // same keys and rows with the same values and counts
+        bool operator==(const GroupByTable& aNother) const;
+        bool operator!=(const GroupByTable& aNother) const { return !operator==(aNother); }
+
+     private:
+        group_keys_t mKeys;
+        std::vector<std::vector<std::string>> mValues; // per key: values used in rows, row ids index this
+        std::vector<Row> mRows;
+
+        friend std::vector<GroupByTable> group_by(const Seqdb& aSeqdb, const std::vector<group_keys_t>& aGroupings, const SeqdbFilter& aFilter);
+
+    }; // class GroupByTable
+
+      // Aggregates sequences passing aFilter for every grouping (list of up to GroupByTable::sMaxKeys keys)
+      // in a single parallel pass over seqdb. Entries without sequences passing aFilter are counted
+      // (with 0 seqs) in the group having empty values of the sequence attributes.
+    std::vector<GroupByTable> group_by(const Seqdb& aSeqdb, const std::vector<group_keys_t>& aGroupings, const SeqdbFilter& aFilter);
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
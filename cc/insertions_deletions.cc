@@ -1,57 +1,50 @@
 #include <iomanip>
+#include <sstream>
 #include <array>
+#include <map>
+#include <numeric>
 
 #include "acmacs-base/debug.hh"
 #include "acmacs-base/counter.hh"
 #include "seqdb/insertions_deletions.hh"
 #include "seqdb/amino-acids.hh"
+#include "seqdb/align-cache.hh"
 
 using namespace seqdb;
 
 // ----------------------------------------------------------------------
 
-class AAsPerPosEntry : public std::string
-{
- public:
-    inline AAsPerPosEntry() {}
-    inline void add(char aAA) { if (aAA != 'X' && aAA != '-' && find(aAA) == npos) append(1, aAA); }
-    inline bool common() const { return size() == 1; }
-};
-
-class AAsPerPos : public std::vector<AAsPerPosEntry>
-{
- public:
-    inline AAsPerPos() {}
-    inline void adjust_size(size_t new_size) { if (size() < new_size) resize(new_size); }
-    inline void update(std::string_view aa) { adjust_size(aa.size()); for (size_t pos = 0; pos < aa.size(); ++pos) operator[](pos).add(aa[pos]); }
-    inline void collect(const InsertionsDeletionsDetector::Entries& entries) { std::for_each(entries.begin(), entries.end(), [this](const auto& entry) { this->update(entry.amino_acids); }); }
-    template <typename Func> inline void collect_if(const InsertionsDeletionsDetector::Entries& entries, Func aFunc) { std::for_each(entries.begin(), entries.end(), [this,&aFunc](const auto& entry) { if (aFunc(entry)) update(entry.amino_acids); }); }
-    inline std::vector<size_t> common_pos() const { std::vector<size_t> common; for (size_t pos = 0; pos < size(); ++pos) { if (operator[](pos).common()) { common.push_back(pos); } } return common; }
-};
-
-// class NoAdjustPos : public std::exception { public: using std::exception::exception; };
-class SwitchMaster : public std::exception { public: using std::exception::exception; };
-
-// ----------------------------------------------------------------------
-
-InsertionsDeletionsDetector::InsertionsDeletionsDetector(Seqdb& aSeqdb, std::string_view aVirusType)
-    : mVirusType(aVirusType)
+InsertionsDeletionsDetector::InsertionsDeletionsDetector(Seqdb& aSeqdb, std::string_view aVirusType, std::string_view aMaster)
+    : mVirusType(aVirusType), mMaster(aMaster)
 {
+    const auto hash = aMaster.empty() ? std::string{} : master_hash(aMaster);
+    if (!mMaster.empty())
+        mProfile = Profile(mMaster);
     auto iter = aSeqdb.begin();
     iter.filter_subtype(aVirusType);
     for (; iter != aSeqdb.end(); ++iter) {
-        try {
-            mEntries.emplace_back(*iter);
-        }
-        catch (SequenceNotAligned&) {
+        const auto entry_seq = *iter;
+        if (const auto amino_acids = entry_seq.seq().amino_acids_aligned_opt(); amino_acids.has_value()) {
+            if (!hash.empty() && entry_seq.seq().indels_master() == hash)
+                mProfile.add_if_in_frame(amino_acids->str()); // checked before and deletions inserted, added as a full run would add it
+            else
+                mEntries.emplace_back(entry_seq, *amino_acids);
         }
     }
-    choose_master();
+    if (mMaster.empty()) {
+        choose_master();
+        mProfile = Profile(mMaster);
+    }
+    for (const auto& entry : mEntries)
+        mProfile.add_if_in_frame(entry.amino_acids);
+    mProfile.make_scores();
 
 } // InsertionsDeletionsDetector::InsertionsDeletionsDetector
 
 // ----------------------------------------------------------------------
 
+  // Master just defines coordinates of the profile, it should not have deletions relative to most of the sequences:
+  // the first sequence of the normal length for the virus type or of the most frequent length among the longest ones
 void InsertionsDeletionsDetector::choose_master()
 {
     if (!mEntries.empty()) {
@@ -62,28 +55,19 @@ void InsertionsDeletionsDetector::choose_master()
             master_number_aa = NORMAL_SEQUENCE_AA_LENGTH_H3;
         else if (mVirusType == "B")
             master_number_aa = NORMAL_SEQUENCE_AA_LENGTH_B;
-        else if (mEntries.size() > 10)
-            std::cerr << "WARNING: unknown normal sequence size for " << mVirusType << '\n';
-
-        std::string master_name;
-        if (master_number_aa > 0) {
-            for (auto& entry : mEntries) {
-                if (entry.amino_acids.size() == master_number_aa) {
-                    mMaster = entry.amino_acids;
-                    master_name = entry.entry_seq.make_name();
-                    break;
-                }
+        if (master_number_aa == 0 || std::none_of(mEntries.begin(), mEntries.end(), [master_number_aa](const auto& entry) { return entry.amino_acids.size() == master_number_aa; })) {
+            if (master_number_aa > 0 || mEntries.size() > 10)
+                std::cerr << "WARNING: unknown normal sequence size for " << mVirusType << '\n';
+            const auto longest = std::max_element(mEntries.begin(), mEntries.end(), [](const auto& e1, const auto& e2) { return e1.amino_acids.size() < e2.amino_acids.size(); })->amino_acids.size();
+            std::map<size_t, size_t> number_of_length; // size -> number of entries
+            for (const auto& entry : mEntries) {
+                if (entry.amino_acids.size() * 10 >= longest * 9)
+                    ++number_of_length[entry.amino_acids.size()];
             }
+              // most frequent, the longest one if there are several
+            master_number_aa = std::max_element(number_of_length.begin(), number_of_length.end(), [](const auto& e1, const auto& e2) { return std::pair(e1.second, e1.first) < std::pair(e2.second, e2.first); })->first;
         }
-        if (mMaster.empty() || master_name.empty()) {
-            mMaster = mEntries.front().amino_acids;
-            master_name = mEntries.front().entry_seq.make_name();
-            master_switching_allowed_ = true;
-        }
-        else {
-            master_switching_allowed_ = false;
-        }
-        // std::cout << "INFO: " << mVirusType << ": master: " << master_name << "\n                 " << mMaster << std::endl;
+        mMaster = std::find_if(mEntries.begin(), mEntries.end(), [master_number_aa](const auto& entry) { return entry.amino_acids.size() == master_number_aa; })->amino_acids;
     }
     // else
     //     std::cerr << "ERROR: InsertionsDeletionsDetector::choose_master: no entries\n";
@@ -92,138 +76,206 @@ void InsertionsDeletionsDetector::choose_master()
 
 // ----------------------------------------------------------------------
 
-void InsertionsDeletionsDetector::detect()
+std::string InsertionsDeletionsDetector::detect(size_t aThreads)
 {
+    std::ostringstream report;
     if (!mEntries.empty() /* && mVirusType == "B" */) {
-        std::cout << "INFO: detecting insertions/deletions in " << mVirusType << '\n';
+        report << "INFO: detecting insertions/deletions in " << mVirusType << '\n';
 
         // acmacs::Counter counter(mEntries.begin(), mEntries.end(), [](const auto& entry) { return entry.amino_acids.size(); });
         // std::cerr << "DEBUG: seq-lengths: " << counter << '\n';
 
-        align_to_master();
-
-        AAsPerPos aas_per_pos;
-        aas_per_pos.collect(mEntries);
-        const auto common_pos = aas_per_pos.common_pos();
-          // std::cerr << mVirusType << ": last common: " << common_pos.back() << " total: " << common_pos.size() /* <<  ' '  << common_pos */ << std::endl;
+          // entries are independent, profile is not changed while aligning
+        std::vector<char> not_matching(mEntries.size(), 0);
+        parallel_for(mEntries.size(), [this, &not_matching](size_t first, size_t last, size_t /*thread_no*/) {
+            for (size_t entry_no = first; entry_no < last; ++entry_no) {
+                auto& entry = mEntries[entry_no];
+                if (auto pos_number = entry.align_to(mProfile, entry.amino_acids, entry.entry_seq); pos_number.has_value())
+                    entry.pos_number = std::move(*pos_number);
+                else
+                    not_matching[entry_no] = 1;
+            }
+        }, aThreads);
 
+          // just sequences matching profile and having deletions (if any) applied are marked checked,
+          // the others are tried again by the next incremental run
+        const auto hash = master_hash(mMaster);
         size_t num_with_deletions = 0;
-        for (auto& entry: mEntries) {
+        for (size_t entry_no = 0; entry_no < mEntries.size(); ++entry_no) {
+            auto& entry = mEntries[entry_no];
+            if (not_matching[entry_no])
+                continue;
             if (!entry.pos_number.empty()) {
-                try {
-                    entry.apply_pos_number();
-                    ++num_with_deletions;
-                    // if (entry.pos_number.size() > 1)
-                    //     std::cerr << entry.entry_seq.make_name() << ' ' << entry.pos_number << ' ' << entry.amino_acids << '\n';
-                }
-                catch (InvalidShift&) {
-                }
+                if (!entry.entry_seq.seq().nucleotides_shift().aligned()) // add_deletions needs both shifts, amino acids shift is checked in the constructor
+                    continue;
+                entry.apply_pos_number();
+                ++num_with_deletions;
             }
+            entry.entry_seq.seq().indels_master(hash);
         }
         if (num_with_deletions)
-            std::cout << "INFO: " << mVirusType << ": " << num_with_deletions << " sequences with deletions detected, total sequences: " << mEntries.size() << std::endl;
+            report << "INFO: " << mVirusType << ": " << num_with_deletions << " sequences with deletions detected, total sequences: " << mEntries.size() << '\n';
+        if (const auto num_not_matching = static_cast<size_t>(std::count(not_matching.begin(), not_matching.end(), 1)); num_not_matching)
+            report << "INFO: " << mVirusType << ": " << num_not_matching << " sequences do not match profile, deletions not detected\n";
+
     }
+    return report.str();
 
 } // InsertionsDeletionsDetector::detect
 
 // ----------------------------------------------------------------------
 
-void InsertionsDeletionsDetector::align_to_master()
+std::string InsertionsDeletionsDetector::master_hash(std::string_view aMaster)
 {
-    // const size_t min_common = static_cast<size_t>(std::floor(mMaster.size() * 0.8));
-    // std::cerr << mVirusType << ": min_common: " << min_common << std::endl;
-    bool restart = true;
-    while (restart) {
-        restart = false;
-        for (auto& entry : mEntries) {
-            try {
-                entry.pos_number = entry.align_to(mMaster, entry.amino_acids, entry.entry_seq);
-            }
-            catch (SwitchMaster&) {
-                if (master_switching_allowed_ && entry.amino_acids.size() > std::lround(mMaster.size() * 0.9)) { // do not switch master, if new sequence is too short
-                    try {
-                        // perhaps master has deletions
-                        entry.align_to(entry.amino_acids, mMaster, entry.entry_seq);
-                        // yes, change master to current and restart
-                        mMaster = entry.amino_acids;
-                        std::cout << "INFO: " << mVirusType << ": master changed to " << entry.entry_seq.make_name() << '\n' << mMaster << '\n';
-                        restart = true;
-                        revert();
-                        break;
-                    }
-                    catch (SwitchMaster&) {
-                        // std::cerr << mVirusType << ": cannot find deletions in " << entry.entry_seq.make_name() << std::endl;
-                    }
-                }
-                // else {
-                //     std::cout << "INFO: " << mVirusType << ": master NOT changed to " << entry.entry_seq.make_name() << ": too short: " << entry.amino_acids.size() << " amino-acids\n";
-                // }
-            }
-        }
-    }
+    std::ostringstream hash;
+    hash << std::hex << std::setw(16) << std::setfill('0') << fnv1a_hash(aMaster);
+    return hash.str();
 
-} // InsertionsDeletionsDetector::align_to_master
+} // InsertionsDeletionsDetector::master_hash
 
 // ----------------------------------------------------------------------
 
-static inline size_t number_of_common(const std::string_view a, size_t start_a, const std::string_view b, size_t start_b)
+void InsertionsDeletionsDetector::Profile::add(std::string_view aAminoAcids)
 {
-    size_t num = 0;
-    for (; start_a < a.size() && start_b < b.size(); ++start_a, ++start_b) {
-        if (InsertionsDeletionsDetector::Entry::common(a[start_a], b[start_b]))
-            ++num;
+    const size_t last = std::min(aAminoAcids.size(), mCounts.size());
+    for (size_t pos = 0; pos < last; ++pos) {
+        if (const auto no = symbol_no(aAminoAcids[pos]); no < number_of_symbols)
+            ++mCounts[pos][no];
     }
-    return num;
-}
 
-static inline size_t number_of_common(const std::string_view a, const std::string_view b)
+} // InsertionsDeletionsDetector::Profile::add
+
+// ----------------------------------------------------------------------
+
+void InsertionsDeletionsDetector::Profile::add_if_in_frame(std::string_view aAminoAcids)
 {
-    return number_of_common(a, 0, b, 0);
-}
+      // after a deletion relative to master, sequence matches master at random (5-10% of positions),
+      // otherwise flu sequences of the same subtype match at 80% or more
+    constexpr const size_t block_size = 32;
+    const size_t last = std::min(aAminoAcids.size(), mMaster.size());
+    if (last * 2 < mMaster.size())
+        return;                 // too short to tell
+    for (size_t block_start = 0; (block_start + block_size / 4) <= last; block_start += block_size) {
+        const size_t block_end = std::min(block_start + block_size, last);
+        size_t num_common = 0;
+        for (size_t pos = block_start; pos < block_end; ++pos)
+            num_common += Entry::common(mMaster[pos], aAminoAcids[pos]);
+        if (num_common * 2 < (block_end - block_start))
+            return;
+    }
+    add(aAminoAcids);
+
+} // InsertionsDeletionsDetector::Profile::add_if_in_frame
 
-static inline size_t number_of_common_before(const std::string_view a, const std::string_view b, size_t last)
+// ----------------------------------------------------------------------
+
+void InsertionsDeletionsDetector::Profile::make_scores()
 {
-    size_t num = 0;
-    last = std::min(std::min(last, a.size()), b.size());
-    for (size_t pos = 0; pos < last; ++pos) {
-        if (InsertionsDeletionsDetector::Entry::common(a[pos], b[pos]))
-            ++num;
+    mScores.resize(mCounts.size());
+    mMaxScores.resize(mCounts.size());
+    mMaxScore = 0;
+    for (size_t pos = 0; pos < mCounts.size(); ++pos) {
+        const auto& counts = mCounts[pos];
+        const auto total = std::accumulate(counts.begin(), counts.end(), uint64_t{0});
+        for (size_t no = 0; no < number_of_symbols; ++no)
+            mScores[pos][no] = total ? static_cast<uint8_t>(counts[no] * uint64_t{255} / total) : uint8_t{0};
+        mMaxScores[pos] = *std::max_element(mScores[pos].begin(), mScores[pos].end());
+        mMaxScore += mMaxScores[pos];
     }
-    return num;
-}
+
+} // InsertionsDeletionsDetector::Profile::make_scores
+
+// ----------------------------------------------------------------------
+
+size_t InsertionsDeletionsDetector::Profile::score(std::string_view aAminoAcids) const
+{
+    const size_t last = std::min(aAminoAcids.size(), mScores.size());
+    size_t result = 0;
+    for (size_t pos = 0; pos < last; ++pos)
+        result += score(pos, aAminoAcids[pos]);
+    return result;
+
+} // InsertionsDeletionsDetector::Profile::score
+
+// ----------------------------------------------------------------------
+
+using Profile = InsertionsDeletionsDetector::Profile;
+static constexpr const size_t max_num_deletions = 5;
+
+  // Sums of profile scores of the sequence being aligned: before a position (not shifted) and from a
+  // position to the end with the sequence shifted right by 1 to max_num_deletions relative to profile.
+  // Used by align_to instead of summing again for every candidate position. After inserting deletions,
+  // prefix sums are recalculated from the first changed position, suffix sums just for the positions
+  // still to be searched.
+class CommonCounts
+{
+ public:
+    CommonCounts(const Profile& aProfile) : mProfile(aProfile) {}
+
+    void update(std::string_view to_align, size_t first_changed, size_t start)
+        {
+            const size_t last = std::min(mProfile.size(), to_align.size());
+            mPrefix.resize(last + 1);
+            for (size_t pos = std::min(first_changed, last); pos < last; ++pos)
+                mPrefix[pos + 1] = mPrefix[pos] + mProfile.score(pos, to_align[pos]);
+
+            mSuffixStart = std::min(start, last);
+            mScores.resize(last - mSuffixStart);
+            for (size_t shift = 1; shift <= max_num_deletions; ++shift) {
+                auto& suffix = mSuffix[shift];
+                suffix.resize(last - mSuffixStart + 1);
+                suffix.back() = 0;
+                  // profile scores beyond its end are 0
+                for (size_t pos = mSuffixStart; pos < last; ++pos)
+                    mScores[pos - mSuffixStart] = mProfile.score(pos + shift, to_align[pos]);
+                for (size_t index = mScores.size(); index > 0; --index)
+                    suffix[index - 1] = suffix[index] + mScores[index - 1];
+            }
+        }
+
+    size_t total() const { return mPrefix.back(); }
+    size_t before(size_t pos) const { return mPrefix[pos]; }
+    size_t shifted_from(size_t pos, size_t shift) const { return mSuffix[shift][pos - mSuffixStart]; }
+
+ private:
+    const Profile& mProfile;
+    std::vector<size_t> mPrefix{0};                                  // mPrefix[pos]: score before pos
+    std::array<std::vector<size_t>, max_num_deletions + 1> mSuffix;  // mSuffix[shift][pos - mSuffixStart]: score from pos to the end, to_align shifted by shift
+    std::vector<unsigned> mScores;
+    size_t mSuffixStart = 0;
+
+}; // class CommonCounts
 
 // ----------------------------------------------------------------------
 
+  // positions where to_align has an amino acid not common in the profile
 class adjust_pos
 {
  public:
-    static inline adjust_pos begin(std::string_view to_align, std::string_view master, size_t pos = 0) { return {to_align, master, pos}; }
-    static inline adjust_pos end(std::string_view to_align, std::string_view master) { return {to_align, master}; }
+    static inline adjust_pos begin(std::string_view to_align, const Profile& profile, size_t pos = 0) { return {to_align, profile, pos}; }
+    static inline adjust_pos end(std::string_view to_align, const Profile& profile) { return {to_align, profile}; }
 
-    bool operator==(const adjust_pos& an) const { return /* mToAlign == an.mToAlign && mMaster == an.mMaster && */ mPos == an.mPos; }
+    bool operator==(const adjust_pos& an) const { return mPos == an.mPos; }
     bool operator!=(const adjust_pos& an) const { return ! operator==(an); }
 
     size_t operator*() const { return mPos; }
-      // const size_t *operator->() const { return &mPos; }
     adjust_pos& operator++() { ++mPos; find(); return *this; }
 
  private:
-    adjust_pos(std::string_view to_align, std::string_view master, size_t pos)
-        : mToAlign(to_align), mMaster(master), mLastPos(std::min(to_align.size(), master.size())), mPos(pos)
+    adjust_pos(std::string_view to_align, const Profile& profile, size_t pos)
+        : mToAlign(to_align), mProfile(profile), mLastPos(std::min(to_align.size(), profile.size())), mPos(pos)
         {
-            // acmacs::debug dbg(true);
-            // dbg << "adjust_pos1 pos:" << mPos << " last_pos:" << mLastPos << '\n';
             find();
-            // dbg << "adjust_pos2 pos:" << mPos << " last_pos:" << mLastPos << '\n';
         }
-    adjust_pos(std::string_view to_align, std::string_view master)
-        : mToAlign(to_align), mMaster(master), mLastPos(std::min(to_align.size(), master.size())), mPos(mLastPos) {}
-    std::string mToAlign, mMaster;
+    adjust_pos(std::string_view to_align, const Profile& profile)
+        : mToAlign(to_align), mProfile(profile), mLastPos(std::min(to_align.size(), profile.size())), mPos(mLastPos) {}
+    std::string_view mToAlign; // to_align is not modified while iterating
+    const Profile& mProfile;
     size_t mLastPos, mPos;
 
     void find()
     {
-        while (mPos < mLastPos && (InsertionsDeletionsDetector::Entry::common(mToAlign[mPos], mMaster[mPos]) || mToAlign[mPos] == '-' || mMaster[mPos] == '-'))
+        while (mPos < mLastPos && (mProfile.common(mPos, mToAlign[mPos]) || mToAlign[mPos] == '-' || mProfile.empty_at(mPos)))
             ++mPos;
     }
 
@@ -242,41 +294,39 @@ struct DeletionPos
 
 using DeletionPosSet = std::vector<DeletionPos>;
 
-static inline void update(DeletionPosSet& pos_set, std::string_view master, std::string_view to_align, size_t pos, size_t common_before)
+static inline void update(DeletionPosSet& pos_set, const CommonCounts& counts, const Profile& profile, std::string_view to_align, size_t pos)
 {
-    constexpr const size_t max_num_deletions = 5;
-    const size_t last_pos = std::min(master.size(), to_align.size());
-    // acmacs::debug dbg(true);
-    // dbg << "update1 " << pos << " common_before:" << common_before << '\n';
+    const size_t last_pos = std::min(profile.size(), to_align.size());
     if ((pos + max_num_deletions) < last_pos) {
         for (size_t num_insert = 1; num_insert <= max_num_deletions; ++num_insert) {
-            if (InsertionsDeletionsDetector::Entry::common(master[pos + num_insert], to_align[pos])) {
-                pos_set.emplace_back(pos, num_insert, common_before + number_of_common(master, pos + num_insert, to_align, pos));
-                // dbg << "update2 " << pos << " deletions:" << num_insert << '\n';
-            }
+            if (profile.common(pos + num_insert, to_align[pos]))
+                pos_set.emplace_back(pos, num_insert, counts.before(pos) + counts.shifted_from(pos, num_insert));
         }
     }
 }
 
-std::vector<std::pair<size_t, size_t>> InsertionsDeletionsDetector::Entry::align_to(const std::string_view master, std::string& to_align, const SeqdbEntrySeq& entry_seq)
+std::optional<std::vector<std::pair<size_t, size_t>>> InsertionsDeletionsDetector::Entry::align_to(const Profile& aProfile, std::string& to_align, const SeqdbEntrySeq& entry_seq)
 {
     // acmacs::debug dbg(false);
 
+      // placement conventions for deletions in the loop region of B, where several placements score the same
     constexpr const bool yamagata_163_hack = true;
     constexpr const bool victoria_tripledel2017_hack = true;
-    // dbg << '\n' << entry_seq.make_name() << '\n' << "align: " << to_align << '\n' << "maste: " << master << '\n';
+    // dbg << '\n' << entry_seq.make_name() << '\n' << "align: " << to_align << '\n';
     std::vector<std::pair<size_t, size_t>> pos_number;
     size_t start = 0;
-    size_t best_common = number_of_common(master, to_align);
+    size_t best_common = aProfile.score(to_align);
     const std::string to_align_orig = to_align;
+    CommonCounts counts(aProfile);
+    size_t first_changed = 0;
     while (start < to_align.size()) {
-        const size_t current_common = number_of_common(master, to_align);
-        // try {
+        counts.update(to_align, first_changed, start);
+        const size_t current_common = counts.total();
         DeletionPosSet pos_set;
-        adjust_pos pos = adjust_pos::begin(to_align, master, start), pos_end = adjust_pos::end(to_align, master);
+        adjust_pos pos = adjust_pos::begin(to_align, aProfile, start), pos_end = adjust_pos::end(to_align, aProfile);
         start = to_align.size();
         for (; pos != pos_end; ++pos) {
-            update(pos_set, master, to_align, *pos, number_of_common_before(master, to_align, *pos));
+            update(pos_set, counts, aProfile, to_align, *pos);
         }
         // dbg << "pos_set: " << pos_set << '\n';
         if (!pos_set.empty()) {
@@ -289,35 +339,29 @@ std::vector<std::pair<size_t, size_t>> InsertionsDeletionsDetector::Entry::align
                     // David Burke 2017-08-17: deletions ( and insertions) of amino acids usually occur in regions of the protein structure where it changes direction ( loops ).
                     // In the case of HA, this is after VPK and before NKTAT/YKNAT.
                     to_align.insert(163 - 1, 1, '-');
-                    del_pos.fix(163 - 1, 1, number_of_common(master, to_align)); // -1 because we count from zero here
+                    del_pos.fix(163 - 1, 1, aProfile.score(to_align)); // -1 because we count from zero here
                 }
                 else if (victoria_tripledel2017_hack && entry_seq.entry().virus_type() == "B" && del_pos.num_deletions == 3 && del_pos.pos == (164 - 1)) {
                     // The triple deletion is 162, 163 and 164 (pos 1 based). this is the convention that has been chosen (Sarah 2018-08-16 08:31)
                     to_align.insert(162 - 1, del_pos.num_deletions, '-');
-                    del_pos.fix(162 - 1, del_pos.num_deletions, number_of_common(master, to_align)); // -1 because we count from zero here
+                    del_pos.fix(162 - 1, del_pos.num_deletions, aProfile.score(to_align)); // -1 because we count from zero here
                 }
                 else {
                     to_align.insert(del_pos.pos, del_pos.num_deletions, '-');
                 }
                 // dbg << "del_pos: " << del_pos << '\n';
+                first_changed = del_pos.pos; // hacks above insert at del_pos.pos after fix()
                 start = del_pos.pos + del_pos.num_deletions + 1;
                 pos_number.emplace_back(del_pos.pos, del_pos.num_deletions);
                 if (best_common < del_pos.num_common)
                     best_common = del_pos.num_common;
             }
         }
-        // }
-        // catch (NoAdjustPos&) {
-        //       // std::cerr << "NoAdjustPos: NC " << number_of_common(to_align, master) << '\n';
-        //     throw SwitchMaster{};
-        // }
     }
-    // if (!pos_number.empty()) // && pos_number.front().second > 1)
-    //     dbg << pos_number << " best-common:" << best_common << '\n' << "align: " << to_align << '\n' << "maste: " << master << '\n';
-    if (best_common < static_cast<size_t>(master.size() * 0.7)) {
-        // dbg << "Too bad matching (common:" << best_common << " threshold:" << (master.size() * 0.7) << "), should we switch master?" << '\n';
+    if (best_common < static_cast<size_t>(aProfile.max_score() * 0.7)) {
+        // dbg << "Too bad matching (score:" << best_common << " threshold:" << (aProfile.max_score() * 0.7) << ")" << '\n';
         to_align = to_align_orig;
-        throw SwitchMaster{};
+        return std::nullopt;
     }
     // dbg << to_align << '\n';
     return pos_number;
@@ -343,21 +387,20 @@ void BLineageDetector::detect()
     for (; iter != mSeqdb.end(); ++iter) {
         auto entry_seq = *iter;
         const auto& seq = entry_seq.seq();
-        try {
+        const auto aa_162 = seq.amino_acid_at_opt(162), aa_163 = seq.amino_acid_at_opt(163), aa_164 = seq.amino_acid_at_opt(164), aa_165 = seq.amino_acid_at_opt(165), aa_166 = seq.amino_acid_at_opt(166);
+        if (aa_162 && aa_163 && aa_164 && aa_165 && aa_166) { // not aligned or too short sequences are ignored
             // if (std::initializer_list<size_t> pos_to_check = {160, 161, 164, 165, 166, 167, 68, 169, 170}; std::any_of(std::begin(pos_to_check), std::end(pos_to_check), [&seq](size_t pos) { return seq.amino_acid_at(pos) == '-'; })) {
             //       // throw std::runtime_error("Invalid deletion in B sequence for " + iter.make_name());
             //     std::cerr << "ERROR: Invalid deletion in B sequence for " << iter.make_name() << std::endl;
             // }
             const auto stored_lineage = entry_seq.entry().lineage();
-            const std::string_view detected_lineage = (seq.amino_acid_at(162) != '-' && (seq.amino_acid_at(163) == '-' || seq.amino_acid_at(164) == '-' || seq.amino_acid_at(165) == '-' || seq.amino_acid_at(166) == '-')) ? "YAMAGATA" : "VICTORIA"; // if deletion in both 162 and 163, it's Vic 2016-2017 outlier
+            const std::string_view detected_lineage = (*aa_162 != '-' && (*aa_163 == '-' || *aa_164 == '-' || *aa_165 == '-' || *aa_166 == '-')) ? "YAMAGATA" : "VICTORIA"; // if deletion in both 162 and 163, it's Vic 2016-2017 outlier
             // std::cerr << detected_lineage << ' ' << entry_seq.make_name() << '\n' << seq.amino_acids(true) << '\n';
             if (stored_lineage.empty())
                 entry_seq.entry().lineage(detected_lineage);
             else if (stored_lineage != detected_lineage)
                 std::cerr << "WARNING: lineage conflict: " << entry_seq.make_name() << "  stored: " << stored_lineage << " detected by sequence: " << detected_lineage << std::endl << "  " << seq.amino_acids(true) << std::endl;
         }
-        catch (SequenceNotAligned&) {
-        }
     }
 
 } // BLineageDetector::detect
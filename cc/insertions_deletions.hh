@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <optional>
+
 #include "seqdb/seqdb.hh"
 
 namespace seqdb
@@ -7,19 +10,62 @@ namespace seqdb
     class InsertionsDeletionsDetector
     {
      public:
-        InsertionsDeletionsDetector(Seqdb& aSeqdb, std::string_view aVirusType);
-
-        void detect();
+          // if aMaster is empty, master is chosen from the sequences and all sequences are checked,
+          // otherwise just the sequences not checked against aMaster yet (see SeqdbSeq::indels_master())
+        InsertionsDeletionsDetector(Seqdb& aSeqdb, std::string_view aVirusType, std::string_view aMaster = std::string_view{});
+
+          // aligns entries to the profile on aThreads threads (0 - the number of hardware threads) and
+          // adds deletions found to the sequences, marks sequences matching profile and having deletions applied checked,
+          // returns report, output does not depend on the number of threads
+        std::string detect(size_t aThreads = 0);
+
+        static std::string master_hash(std::string_view aMaster);
+
+          // Frequencies of amino acids at every position of master, collected from the sequences being in master
+          // coordinates: matching master in every block (see add_if_in_frame), i.e. having no insertions/deletions
+          // relative to master or having them inserted by the check against master before.
+          // Score of an amino acid at a position is its frequency scaled to 0..255, X, - and positions beyond
+          // master score 0. Amino acid is common at a position if more than half of the sequences have it there.
+        class Profile
+        {
+         public:
+            Profile() = default;
+            Profile(std::string_view aMaster) : mMaster(aMaster), mCounts(aMaster.size(), counts_t{}) { add(aMaster); }
+
+            void add(std::string_view aAminoAcids); // must be in master coordinates
+            void add_if_in_frame(std::string_view aAminoAcids); // if matches master at half of the positions of every block, i.e. no deletions
+            void make_scores();                        // after adding all sequences
+
+            size_t size() const { return mScores.size(); }
+            unsigned score(size_t aPos, char aAA) const { const auto no = symbol_no(aAA); return (aPos < mScores.size() && no < number_of_symbols) ? mScores[aPos][no] : 0U; }
+            bool common(size_t aPos, char aAA) const { return score(aPos, aAA) > 127; }
+            bool empty_at(size_t aPos) const { return mMaxScores[aPos] == 0; } // no sequence has amino acid there
+            size_t score(std::string_view aAminoAcids) const; // sum of scores of not shifted aAminoAcids
+            size_t max_score() const { return mMaxScore; }     // score of the consensus
+
+         private:
+            static constexpr const size_t number_of_symbols = 26;
+            using counts_t = std::array<uint32_t, number_of_symbols>;
+
+            std::string mMaster;
+            std::vector<counts_t> mCounts;
+            std::vector<std::array<uint8_t, number_of_symbols>> mScores;
+            std::vector<unsigned> mMaxScores;
+            size_t mMaxScore = 0;
+
+            static size_t symbol_no(char aAA) { return (aAA >= 'A' && aAA <= 'Z' && aAA != 'X') ? static_cast<size_t>(aAA - 'A') : number_of_symbols; }
+        };
 
         class Entry
         {
          public:
-            Entry(SeqdbEntrySeq&& aEntrySeq) : entry_seq(aEntrySeq), amino_acids(entry_seq.seq().amino_acids(true)) {}
+            Entry(const SeqdbEntrySeq& aEntrySeq, const AlignedView& aAminoAcids) : entry_seq(aEntrySeq), amino_acids(aAminoAcids.str()) {}
             void revert() { amino_acids = entry_seq.seq().amino_acids(true); }
               // void insert_if(size_t pos, char aa, size_t num_insertions) { if (amino_acids[pos] == aa) amino_acids.insert(pos, num_insertions, '-'); }
 
             static inline bool common(char a, char b) { return a == b && a != 'X' && a != '-'; }
-            static std::vector<std::pair<size_t, size_t>> align_to(const std::string_view master, std::string& to_align, const SeqdbEntrySeq& entry_seq);
+              // inserts deletions into to_align, returns their positions and sizes, nullopt (to_align is not changed) if to_align does not match profile
+            static std::optional<std::vector<std::pair<size_t, size_t>>> align_to(const Profile& aProfile, std::string& to_align, const SeqdbEntrySeq& entry_seq);
             void apply_pos_number();
 
             SeqdbEntrySeq entry_seq;
@@ -31,12 +77,9 @@ namespace seqdb
         std::string mVirusType;
         Entries mEntries;
         std::string mMaster;
-        bool master_switching_allowed_ = true;
+        Profile mProfile;
 
      private:
-        void align_to_master();
-
-        void revert() { std::for_each(mEntries.begin(), mEntries.end(), [](auto& entry) { entry.revert(); }); }
         void choose_master();
 
     }; // class InsertionsDeletionsDetector
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <cctype>
+
+#include "seqdb/name-index.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+static inline std::string upper(std::string_view source)
+{
+    std::string result(source);
+    std::transform(result.begin(), result.end(), result.begin(), [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+    return result;
+}
+
+static inline bool contains_ignore_case(std::string_view aText, std::string_view aUpperSubstring)
+{
+    return upper(aText).find(aUpperSubstring) != std::string::npos;
+}
+
+// ----------------------------------------------------------------------
+
+NameTrigramIndex::NameTrigramIndex(const Seqdb& aSeqdb)
+    : mSeqdb(aSeqdb)
+{
+    for (size_t entry_no = 0; entry_no < aSeqdb.entries().size(); ++entry_no) {
+        const auto& entry = aSeqdb.entries()[entry_no];
+        for (size_t seq_no = 0; seq_no < entry.seqs().size(); ++seq_no) {
+            const auto& seq = entry.seqs()[seq_no];
+            const auto ref_no = static_cast<uint32_t>(mRefs.size());
+            mRefs.emplace_back(entry_no, seq_no);
+            add(aSeqdb.seq_names().name(entry_no, seq_no), ref_no);
+            add(entry.name(), ref_no);
+            for (const auto& hi_name : seq.hi_names())
+                add(hi_name, ref_no);
+        }
+    }
+
+} // NameTrigramIndex::NameTrigramIndex
+
+// ----------------------------------------------------------------------
+
+void NameTrigramIndex::add(std::string_view aName, uint32_t aRefNo)
+{
+    const auto name = upper(aName);
+    for (size_t pos = 0; (pos + 2) < name.size(); ++pos) {
+        auto& postings = mPostings[trigram(name[pos], name[pos + 1], name[pos + 2])];
+        if (postings.empty() || postings.back() != aRefNo) // refs are added in order, the same trigram may appear in a name several times
+            postings.push_back(aRefNo);
+    }
+
+} // NameTrigramIndex::add
+
+// ----------------------------------------------------------------------
+
+std::optional<NameTrigramIndex::postings_t> NameTrigramIndex::candidates(const std::vector<std::string>& aLiterals) const
+{
+    std::vector<trigram_t> trigrams;
+    for (const auto& literal : aLiterals) {
+        for (size_t pos = 0; (pos + 2) < literal.size(); ++pos)
+            trigrams.push_back(trigram(literal[pos], literal[pos + 1], literal[pos + 2]));
+    }
+    if (trigrams.empty())
+        return std::nullopt;
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::vector<const postings_t*> lists;
+    for (const auto tri : trigrams) {
+        if (const auto found = mPostings.find(tri); found != mPostings.end())
+            lists.push_back(&found->second);
+        else
+            return postings_t{}; // trigram is not in the index, nothing can match
+    }
+      // intersect starting with the shortest list
+    std::sort(lists.begin(), lists.end(), [](const auto* l1, const auto* l2) { return l1->size() < l2->size(); });
+    postings_t result = *lists.front();
+    postings_t intersection;
+    for (auto list = std::next(lists.begin()); list != lists.end() && !result.empty(); ++list) {
+        intersection.clear();
+        std::set_intersection(result.begin(), result.end(), (*list)->begin(), (*list)->end(), std::back_inserter(intersection));
+        result.swap(intersection);
+    }
+    return result;
+
+} // NameTrigramIndex::candidates
+
+// ----------------------------------------------------------------------
+
+std::optional<seq_refs_t> NameTrigramIndex::candidates_for_regex(std::string_view aRegex) const
+{
+    if (const auto found = candidates(required_literals(aRegex)); found.has_value()) {
+        seq_refs_t result(found->size());
+        std::transform(found->begin(), found->end(), result.begin(), [this](uint32_t ref_no) { return mRefs[ref_no]; });
+        return result;
+    }
+    return std::nullopt;
+
+} // NameTrigramIndex::candidates_for_regex
+
+// ----------------------------------------------------------------------
+
+seq_refs_t NameTrigramIndex::find_substring(std::string_view aSubstring) const
+{
+    const auto substring = upper(aSubstring);
+    const auto matches = [this, &substring](const seq_ref_t& ref) {
+        const auto& entry = mSeqdb.entries()[ref.first];
+        const auto& hi_names = entry.seqs()[ref.second].hi_names();
+        return contains_ignore_case(entry.name(), substring) || std::any_of(hi_names.begin(), hi_names.end(), [&substring](const auto& hi_name) { return contains_ignore_case(hi_name, substring); });
+    };
+
+    seq_refs_t result;
+    if (const auto found = candidates({substring}); found.has_value()) {
+        for (const auto ref_no : *found) {
+            if (matches(mRefs[ref_no]))
+                result.push_back(mRefs[ref_no]);
+        }
+    }
+    else { // substring is too short for the index
+        std::copy_if(mRefs.begin(), mRefs.end(), std::back_inserter(result), matches);
+    }
+    return result;
+
+} // NameTrigramIndex::find_substring
+
+// ----------------------------------------------------------------------
+
+// Conservative extraction: groups, bracket expressions, escapes other
+// than escaped punctuation (\d, \x41, \u0041, \cJ, \1) and optional
+// atoms break literals, top level alternation means there is nothing
+// required at all.
+std::vector<std::string> NameTrigramIndex::required_literals(std::string_view aRegex)
+{
+    std::vector<std::string> literals;
+    std::string current;
+    const auto flush = [&literals, &current]() {
+        if (current.size() >= 3)
+            literals.push_back(current);
+        current.clear();
+    };
+
+      // returns position of the ] closing bracket expression starting at pos
+    const auto skip_brackets = [aRegex](size_t pos) -> size_t {
+        ++pos;
+        if (pos < aRegex.size() && aRegex[pos] == '^')
+            ++pos;
+        if (pos < aRegex.size() && aRegex[pos] == ']') // ] right after [ or [^ is a literal
+            ++pos;
+        for (; pos < aRegex.size() && aRegex[pos] != ']'; ++pos) {
+            if (aRegex[pos] == '\\')
+                ++pos;
+        }
+        return pos;
+    };
+
+      // returns position of the last char of the escape starting at pos: class (\d), code (\x41, \u0041, \cJ)
+      // or back reference (\1), none of them is a literal char
+    const auto skip_escape = [aRegex](size_t pos) -> size_t {
+        ++pos;
+        if (pos >= aRegex.size())
+            return pos;
+        switch (aRegex[pos]) {
+          case 'x':
+              return std::min(pos + 2, aRegex.size() - 1);
+          case 'u':
+              return std::min(pos + 4, aRegex.size() - 1);
+          case 'c':
+              return std::min(pos + 1, aRegex.size() - 1);
+          default:
+              while ((pos + 1) < aRegex.size() && std::isdigit(static_cast<unsigned char>(aRegex[pos])) && std::isdigit(static_cast<unsigned char>(aRegex[pos + 1])))
+                  ++pos;
+              return pos;
+        }
+    };
+
+      // returns position of the closing char of the group or bracket expression starting at pos
+    const auto skip_to_closing = [aRegex, &skip_brackets](size_t pos) -> size_t {
+        if (aRegex[pos] == '[')
+            return skip_brackets(pos);
+        size_t depth = 0;
+        for (; pos < aRegex.size(); ++pos) {
+            switch (aRegex[pos]) {
+              case '\\':
+                  ++pos;
+                  break;
+              case '[':
+                  pos = skip_brackets(pos);
+                  break;
+              case '(':
+                  ++depth;
+                  break;
+              case ')':
+                  if (--depth == 0)
+                      return pos;
+                  break;
+              default:
+                  break;
+            }
+        }
+        return aRegex.size();
+    };
+
+    for (size_t pos = 0; pos < aRegex.size(); ++pos) {
+        std::optional<char> literal;
+        switch (aRegex[pos]) {
+          case '|':
+              return {};
+          case '\\':
+              if ((pos + 1) < aRegex.size() && !std::isalnum(static_cast<unsigned char>(aRegex[pos + 1]))) {
+                  literal = aRegex[pos + 1]; // escaped punctuation, e.g. \. or \(
+                  ++pos;
+              }
+              else
+                  pos = skip_escape(pos);
+              break;
+          case '(':
+          case '[':
+              pos = skip_to_closing(pos);
+              break;
+          case '.':
+          case '^':
+          case '$':
+          case ')':
+          case ']':
+              break;
+          default:
+              literal = aRegex[pos];
+              break;
+        }
+
+        const char quantifier = (pos + 1) < aRegex.size() ? aRegex[pos + 1] : '\0';
+        switch (quantifier) {
+          case '*':
+          case '?':
+          case '{':
+              flush(); // atom is optional
+              ++pos;
+              if (quantifier == '{') {
+                  while (pos < aRegex.size() && aRegex[pos] != '}')
+                      ++pos;
+              }
+              if ((pos + 1) < aRegex.size() && aRegex[pos + 1] == '?') // lazy
+                  ++pos;
+              break;
+          case '+':
+              if (literal.has_value()) {
+                  current.append(1, static_cast<char>(std::toupper(static_cast<unsigned char>(*literal))));
+                  flush();
+                  current.append(1, static_cast<char>(std::toupper(static_cast<unsigned char>(*literal)))); // repeated char also starts the next literal
+              }
+              else
+                  flush();
+              ++pos;
+              if ((pos + 1) < aRegex.size() && aRegex[pos + 1] == '?') // lazy
+                  ++pos;
+              break;
+          default:
+              if (literal.has_value())
+                  current.append(1, static_cast<char>(std::toupper(static_cast<unsigned char>(*literal))));
+              else
+                  flush();
+              break;
+        }
+    }
+    flush();
+    return literals;
+
+} // NameTrigramIndex::required_literals
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
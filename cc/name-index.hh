@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+
+      // (entry_no, seq_no) of a sequence in Seqdb::entries(), lists of refs are always sorted
+    using seq_ref_t = std::pair<size_t, size_t>;
+    using seq_refs_t = std::vector<seq_ref_t>;
+
+      // Trigram index over names (display name, entry name and hi names) of all sequences.
+      // Names are upper-cased, i.e. lookups ignore case (like filter_name_regex)
+    class NameTrigramIndex
+    {
+     public:
+        NameTrigramIndex(const Seqdb& aSeqdb);
+
+          // Sequences whose names may match aRegex (superset of the actual matches, regex still has to be run on them).
+          // Returns std::nullopt if no literal of at least 3 chars can be extracted from aRegex, i.e. index is useless.
+        std::optional<seq_refs_t> candidates_for_regex(std::string_view aRegex) const;
+
+          // Sequences having aSubstring (case ignored) in the entry name or in any of hi names
+        seq_refs_t find_substring(std::string_view aSubstring) const;
+
+          // literals (upper-cased) that must be present in any string matched by aRegex (ECMAScript syntax)
+        static std::vector<std::string> required_literals(std::string_view aRegex);
+
+     private:
+        using trigram_t = uint32_t;
+        using postings_t = std::vector<uint32_t>; // sorted indices in mRefs
+
+        const Seqdb& mSeqdb;
+        seq_refs_t mRefs;
+        std::unordered_map<trigram_t, postings_t> mPostings;
+
+        void add(std::string_view aName, uint32_t aRefNo);
+        std::optional<postings_t> candidates(const std::vector<std::string>& aLiterals) const;
+        static inline trigram_t trigram(char c1, char c2, char c3) { return (static_cast<trigram_t>(static_cast<unsigned char>(c1)) << 16) | (static_cast<trigram_t>(static_cast<unsigned char>(c2)) << 8) | static_cast<unsigned char>(c3); }
+
+    }; // class NameTrigramIndex
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "seqdb/position-index.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+void SeqBitmap::add(uint32_t aNo, size_t aTotal)
+{
+    if (mDense.empty()) {
+        mSparse.push_back(aNo);
+        if (mSparse.size() >= (aTotal / 32 + 1)) { // dense takes less space than sparse
+            mDense.resize(aTotal / 64 + 1, 0);
+            for (const auto no : mSparse)
+                mDense[no / 64] |= uint64_t{1} << (no % 64);
+            mSparse.clear();
+            mSparse.shrink_to_fit();
+        }
+    }
+    else
+        mDense[aNo / 64] |= uint64_t{1} << (aNo % 64);
+    ++mCount;
+
+} // SeqBitmap::add
+
+// ----------------------------------------------------------------------
+
+bool SeqBitmap::contains(uint32_t aNo) const
+{
+    if (mDense.empty())
+        return std::binary_search(mSparse.begin(), mSparse.end(), aNo);
+    else
+        return (aNo / 64) < mDense.size() && (mDense[aNo / 64] & (uint64_t{1} << (aNo % 64))) != 0;
+
+} // SeqBitmap::contains
+
+// ----------------------------------------------------------------------
+
+pos_residue_t seqdb::parse_pos_residue(std::string_view aSource)
+{
+    const std::string source{aSource};
+    char* end = nullptr;
+    const auto pos = std::strtoul(source.c_str(), &end, 10);
+    if (pos == 0 || end == nullptr || static_cast<size_t>(end - source.c_str()) != (source.size() - 1))
+        throw std::runtime_error("cannot parse position and residue from \"" + source + "\", expected e.g. 142N");
+    return {pos, static_cast<char>(std::toupper(source.back()))};
+
+} // seqdb::parse_pos_residue
+
+// ----------------------------------------------------------------------
+
+PositionIndex::PositionIndex(const Seqdb& aSeqdb)
+{
+    const auto total = aSeqdb.number_of_seqs();
+    mRefs.reserve(total);
+    for (size_t entry_no = 0; entry_no < aSeqdb.entries().size(); ++entry_no) {
+        const auto& entry = aSeqdb.entries()[entry_no];
+        for (size_t seq_no = 0; seq_no < entry.seqs().size(); ++seq_no) {
+            const auto& seq = entry.seqs()[seq_no];
+            const auto ref_no = static_cast<uint32_t>(mRefs.size());
+            mRefs.emplace_back(entry_no, seq_no);
+            if (const auto amino_acids = seq.amino_acids_aligned_opt(); amino_acids.has_value())
+                add(mAminoAcids, *amino_acids, ref_no, total);
+            if (const auto nucleotides = seq.nucleotides_aligned_opt(); nucleotides.has_value())
+                add(mNucleotides, *nucleotides, ref_no, total);
+        }
+    }
+
+} // PositionIndex::PositionIndex
+
+// ----------------------------------------------------------------------
+
+void PositionIndex::add(std::vector<per_pos_t>& aTarget, const AlignedView& aSequence, uint32_t aRefNo, size_t aTotal)
+{
+    if (aTarget.size() < aSequence.size())
+        aTarget.resize(aSequence.size());
+    for (size_t pos = 0; pos < aSequence.size(); ++pos) {
+        auto& per_pos = aTarget[pos];
+        const char residue = aSequence[pos];
+        if (auto found = std::find_if(per_pos.begin(), per_pos.end(), [residue](const auto& entry) { return entry.first == residue; }); found != per_pos.end())
+            found->second.add(aRefNo, aTotal);
+        else
+            per_pos.emplace_back(residue, SeqBitmap{}).second.add(aRefNo, aTotal);
+    }
+
+} // PositionIndex::add
+
+// ----------------------------------------------------------------------
+
+const SeqBitmap* PositionIndex::bitmap(pos_residue_t aTerm, sequence_type aType) const
+{
+    const auto& source = aType == sequence_type::amino_acids ? mAminoAcids : mNucleotides;
+    if (aTerm.pos == 0 || aTerm.pos > source.size())
+        return nullptr;
+    const auto& per_pos = source[aTerm.pos - 1];
+    if (const auto found = std::find_if(per_pos.begin(), per_pos.end(), [&aTerm](const auto& entry) { return entry.first == aTerm.residue; }); found != per_pos.end())
+        return &found->second;
+    return nullptr;
+
+} // PositionIndex::bitmap
+
+// ----------------------------------------------------------------------
+
+size_t PositionIndex::count(pos_residue_t aTerm, sequence_type aType) const
+{
+    if (const auto* found = bitmap(aTerm, aType); found)
+        return found->size();
+    return 0;
+
+} // PositionIndex::count
+
+// ----------------------------------------------------------------------
+
+seq_refs_t PositionIndex::find(const std::vector<pos_residue_t>& aTerms, sequence_type aType) const
+{
+    if (aTerms.empty())
+        return {};
+    std::vector<const SeqBitmap*> bitmaps;
+    for (const auto& term : aTerms) {
+        if (const auto* found = bitmap(term, aType); found)
+            bitmaps.push_back(found);
+        else
+            return {};
+    }
+      // iterate over the smallest set, check membership in the others
+    std::sort(bitmaps.begin(), bitmaps.end(), [](const auto* b1, const auto* b2) { return b1->size() < b2->size(); });
+    seq_refs_t result;
+    bitmaps.front()->for_each([this, &bitmaps, &result](uint32_t no) {
+        if (std::all_of(std::next(bitmaps.begin()), bitmaps.end(), [no](const auto* bm) { return bm->contains(no); }))
+            result.push_back(mRefs[no]);
+    });
+    return result;
+
+} // PositionIndex::find
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "seqdb/name-index.hh"
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+    class AlignedView;
+
+      // Set of sequence numbers (indices in PositionIndex refs), sparse (sorted list) while small, dense (bitmap) otherwise
+    class SeqBitmap
+    {
+     public:
+        void add(uint32_t aNo, size_t aTotal); // numbers must be added in increasing order
+        bool contains(uint32_t aNo) const;
+        size_t size() const { return mCount; }
+        bool empty() const { return mCount == 0; }
+
+        template <typename F> void for_each(F func) const
+            {
+                if (mDense.empty()) {
+                    for (const auto no : mSparse)
+                        func(no);
+                }
+                else {
+                    for (size_t word_no = 0; word_no < mDense.size(); ++word_no) {
+                        for (auto word = mDense[word_no]; word != 0; word &= word - 1)
+                            func(static_cast<uint32_t>(word_no * 64 + static_cast<size_t>(__builtin_ctzll(word))));
+                    }
+                }
+            }
+
+     private:
+        size_t mCount = 0;
+        std::vector<uint32_t> mSparse;
+        std::vector<uint64_t> mDense;
+
+    }; // class SeqBitmap
+
+// ----------------------------------------------------------------------
+
+    struct pos_residue_t
+    {
+        size_t pos;             // aligned, starts from 1
+        char residue;
+    };
+
+      // "142N" -> {142, 'N'}, throws std::runtime_error
+    pos_residue_t parse_pos_residue(std::string_view aSource);
+
+    enum class sequence_type { amino_acids, nucleotides };
+
+      // (aligned position, residue) -> sequences having residue at position, for amino acids and nucleotides
+    class PositionIndex
+    {
+     public:
+        PositionIndex(const Seqdb& aSeqdb);
+
+          // sequences having all the residues at the positions (AND), sorted
+        seq_refs_t find(const std::vector<pos_residue_t>& aTerms, sequence_type aType = sequence_type::amino_acids) const;
+          // number of sequences having residue at position
+        size_t count(pos_residue_t aTerm, sequence_type aType = sequence_type::amino_acids) const;
+
+     private:
+        using per_pos_t = std::vector<std::pair<char, SeqBitmap>>; // just a few residues are found at each position
+
+        seq_refs_t mRefs;
+        std::vector<per_pos_t> mAminoAcids; // index is position - 1
+        std::vector<per_pos_t> mNucleotides;
+
+        static void add(std::vector<per_pos_t>& aTarget, const AlignedView& aSequence, uint32_t aRefNo, size_t aTotal);
+        const SeqBitmap* bitmap(pos_residue_t aTerm, sequence_type aType) const;
+
+    }; // class PositionIndex
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,6 +1,8 @@
 #include "acmacs-base/pybind11.hh"
 #include "acmacs-chart-2/chart.hh"
 #include "seqdb/seqdb.hh"
+#include "seqdb/align-cache.hh"
+#include "seqdb/clades.hh"
 
 using namespace seqdb;
 
@@ -34,6 +36,8 @@ struct PySeqdbEntrySeqIterator
     PySeqdbEntrySeqIterator& filter_hi_name(bool aHasHiName) { mCurrent.filter_hi_name(aHasHiName); return *this; }
     PySeqdbEntrySeqIterator& filter_name_regex(std::string aNameRegex) { mCurrent.filter_name_regex(aNameRegex); return *this; }
     PySeqdbEntrySeqIterator& filter_clade(std::string aClade) { mCurrent.filter_clade(aClade); return *this; }
+    PySeqdbEntrySeqIterator& filter(const SeqdbFilter& aFilter) { mCurrent.filter(aFilter); return *this; }
+    PySeqdbEntrySeqIterator& report_plan(bool aReportPlan) { mCurrent.report_plan(aReportPlan); return *this; }
 
     py::object mRef; // keep a reference
     SeqdbIterator mCurrent;
@@ -99,7 +103,7 @@ PYBIND11_MODULE(seqdb_backend, m)
     py::class_<SeqdbSeq>(m, "SeqdbSeq")
             .def("has_lab", &SeqdbSeq::has_lab, py::arg("lab"))
             .def("cdcids", &SeqdbSeq::cdcids)
-            .def("update_clades", &SeqdbSeq::update_clades, py::arg("virus_type"), py::arg("lineage"), py::arg("name") = "*name not available*")
+            .def("update_clades", [](SeqdbSeq& aSeq, std::string_view aVirusType, std::string_view aLineage) { return aSeq.update_clades(aVirusType, aLineage); }, py::arg("virus_type"), py::arg("lineage"))
             .def_property_readonly("passages", static_cast<const std::vector<std::string>& (SeqdbSeq::*)() const>(&SeqdbSeq::passages))
             .def_property_readonly("reassortant", static_cast<const std::vector<std::string>& (SeqdbSeq::*)() const>(&SeqdbSeq::reassortant))
             .def_property_readonly("hi_names", static_cast<const std::vector<std::string>& (SeqdbSeq::*)() const>(&SeqdbSeq::hi_names))
@@ -156,6 +160,25 @@ PYBIND11_MODULE(seqdb_backend, m)
             .def("filter_date_range", &PySeqdbEntrySeqIterator::filter_date_range)
             .def("filter_hi_name", &PySeqdbEntrySeqIterator::filter_hi_name)
             .def("filter_name_regex", &PySeqdbEntrySeqIterator::filter_name_regex)
+            .def("filter", &PySeqdbEntrySeqIterator::filter, py::arg("filter"))
+            .def("report_plan", &PySeqdbEntrySeqIterator::report_plan, py::arg("report") = true, py::doc("report filter plan and predicate timings to stderr when iteration is over"))
+            ;
+
+    py::class_<SeqdbFilter>(m, "SeqdbFilter")
+            .def(py::init<>())
+            .def("filter_lab", &SeqdbFilter::filter_lab, py::return_value_policy::reference_internal)
+            .def("filter_labid", &SeqdbFilter::filter_labid, py::arg("lab"), py::arg("id"), py::return_value_policy::reference_internal)
+            .def("filter_subtype", &SeqdbFilter::filter_subtype, py::return_value_policy::reference_internal)
+            .def("filter_lineage", &SeqdbFilter::filter_lineage, py::return_value_policy::reference_internal)
+            .def("filter_continent", &SeqdbFilter::filter_continent, py::return_value_policy::reference_internal)
+            .def("filter_country", &SeqdbFilter::filter_country, py::return_value_policy::reference_internal)
+            .def("filter_aligned", &SeqdbFilter::filter_aligned, py::return_value_policy::reference_internal)
+            .def("filter_gene", &SeqdbFilter::filter_gene, py::return_value_policy::reference_internal)
+            .def("filter_clade", &SeqdbFilter::filter_clade, py::return_value_policy::reference_internal)
+            .def("filter_date_range", &SeqdbFilter::filter_date_range, py::return_value_policy::reference_internal)
+            .def("filter_hi_name", &SeqdbFilter::filter_hi_name, py::return_value_policy::reference_internal)
+            .def("filter_name_regex", &SeqdbFilter::filter_name_regex, py::return_value_policy::reference_internal)
+            .def("report_plan", py::overload_cast<bool>(&SeqdbFilter::report_plan), py::arg("report") = true, py::return_value_policy::reference_internal)
             ;
 
     py::class_<PySeqdbEntryIterator>(m, "PySeqdbEntryIterator")
@@ -177,18 +200,36 @@ PYBIND11_MODULE(seqdb_backend, m)
             .def("number_of_entries", &Seqdb::number_of_entries)
             .def("number_of_seqs", &Seqdb::number_of_seqs)
             .def("find_by_name", static_cast<SeqdbEntry* (Seqdb::*)(std::string_view)>(&Seqdb::find_by_name), py::arg("name"), py::return_value_policy::reference, py::doc("returns entry found by name or None"))
+            .def("find_by_name_prefix", [](const seqdb::Seqdb& aSeqdb, std::string aPrefix) {
+                                            const auto [first, last] = aSeqdb.find_by_name_prefix(aPrefix);
+                                            std::vector<const SeqdbEntry*> result;
+                                            for (auto entry = first; entry != last; ++entry)
+                                                result.push_back(&*entry);
+                                            return result; }, py::arg("prefix"), py::return_value_policy::reference, py::doc("returns list of entries whose names start with prefix"))
             .def("find_by_seq_id", [](seqdb::Seqdb& aSeqdb, std::string seq_id, bool ignore) { return aSeqdb.find_by_seq_id(seq_id, ignore ? seqdb::Seqdb::ignore_not_found::yes : seqdb::Seqdb::ignore_not_found::no); }, py::arg("seq_id"), py::arg("ignore_not_found") = false, py::return_value_policy::reference, py::doc("returns entry_seq found by seq_id"))
               // .def("new_entry", &Seqdb::new_entry, py::arg("name"), py::return_value_policy::reference, py::doc("creates and inserts into the database new entry with the passed name, returns that name, throws if database already has entry with that name."))
             .def("add_sequence", &Seqdb::add_sequence, py::arg("name"), py::arg("virus_type"), py::arg("lineage"), py::arg("lab"), py::arg("date"), py::arg("lab_id"), py::arg("passage"), py::arg("reassortant"), py::arg("sequence"), py::arg("gene"), py::doc("adds sequence to the database, inserts new entry if necessary."))
             .def("report_not_aligned_after_adding", &Seqdb::report_not_aligned_after_adding, py::doc("writes to stderr list of not aligned sequences recently added via add_sequence."))
+            .def("align_by_reference", [](Seqdb& aSeqdb, bool aVerbose) { return aSeqdb.align_by_reference(aVerbose ? seqdb::report::yes : seqdb::report::no); }, py::arg("verbose") = true,
+                 py::doc("aligns sequences not aligned by signatures against reference proteins taken from aligned sequences, returns messages. Must be called before cleanup."))
             .def("cleanup", &Seqdb::cleanup, py::arg("remove_short_sequences") = true)
-            .def("detect_insertions_deletions", &Seqdb::detect_insertions_deletions)
+            .def("detect_insertions_deletions", &Seqdb::detect_insertions_deletions, py::arg("force") = false, py::arg("threads") = 0,
+                 py::doc("detects insertions/deletions in sequences not checked against the master of their virus type yet, force: choose masters again and check all sequences, threads: 0 - the number of hardware threads, result does not depend on it"))
             .def("detect_b_lineage", &Seqdb::detect_b_lineage)
-            .def("update_clades", &Seqdb::update_clades)
+            .def("update_clades", [](Seqdb& aSeqdb, bool aVerbose, bool aForce) { return aSeqdb.update_clades(aVerbose ? seqdb::report::yes : seqdb::report::no, aForce); }, py::arg("verbose") = false, py::arg("force") = false,
+                 py::doc("recomputes clades of the sequences changed since the last update (all if force), returns the number of sequences recomputed"))
+            .def("realign", [](Seqdb& aSeqdb, bool force, const SeqdbFilter& filter) { return aSeqdb.realign(force, filter); }, py::arg("force") = true, py::arg("filter") = SeqdbFilter{},
+                 py::doc("aligns sequences passing filter again using several threads, returns messages. detect_insertions_deletions() and update_clades() must be called afterwards."))
             .def("report", &Seqdb::report)
             .def("report_identical", &Seqdb::report_identical)
             .def("report_not_aligned", &Seqdb::report_not_aligned, py::arg("prefix_size"), py::doc("returns report with AA prefixes of not aligned sequences."))
             .def("iter_seq", [](py::object seqdb) { return PySeqdbEntrySeqIterator(seqdb.cast<Seqdb&>(), seqdb); })
+            .def("shared_scan", [](const seqdb::Seqdb& aSeqdb, const std::vector<std::pair<SeqdbFilter, py::function>>& aQueries) {
+                                    std::vector<std::pair<SeqdbFilter, Seqdb::seq_visitor_t>> queries;
+                                    for (const auto& [filter, visitor] : aQueries)
+                                        queries.emplace_back(filter, [visitor = visitor](const SeqdbEntrySeq& entry_seq) { visitor(entry_seq); });
+                                    aSeqdb.shared_scan(std::move(queries)); },
+                 py::arg("queries"), py::doc("queries: list of (SeqdbFilter, callable), makes a single pass over seqdb calling callable(entry_seq) for each sequence passing the corresponding filter"))
             .def("iter_entry", [](py::object seqdb) { return PySeqdbEntryIterator(seqdb.cast<Seqdb&>(), seqdb); })
             .def("all_hi_names", &Seqdb::all_hi_names, py::doc("returns list of all hi_names (\"h\") found in seqdb."))
             .def("all_passages", &Seqdb::all_passages, py::doc("returns list of all passages found in seqdb."))
@@ -196,15 +237,40 @@ PYBIND11_MODULE(seqdb_backend, m)
             .def("match_hidb", [](seqdb::Seqdb& aSeqdb, bool verbose, bool greedy) { aSeqdb.match_hidb(verbose ? seqdb::report::yes : seqdb::report::no, greedy); }, py::arg("verbose") = false, py::arg("greedy") = true, py::doc("match all names against hidb, returns list of not found locations"))
             .def("build_hi_name_index", &Seqdb::build_hi_name_index)
             .def("find_hi_name", &Seqdb::find_hi_name, py::arg("name"), py::return_value_policy::reference, py::doc("returns entry_seq found by hi name or None"))
+            .def("find_by_name_substring", &Seqdb::find_by_name_substring, py::arg("substring"), py::doc("returns list of entry_seq having substring (case ignored) in the name or in any of hi names"))
+            .def("find_by_residues_at", [](const seqdb::Seqdb& aSeqdb, const std::vector<std::string>& aResiduesAt, bool aNucleotides) {
+                                            std::vector<seqdb::pos_residue_t> residues_at(aResiduesAt.size());
+                                            std::transform(aResiduesAt.begin(), aResiduesAt.end(), residues_at.begin(), [](const auto& src) { return seqdb::parse_pos_residue(src); });
+                                            return aSeqdb.find_by_residues_at(residues_at, aNucleotides ? seqdb::sequence_type::nucleotides : seqdb::sequence_type::amino_acids); },
+                 py::arg("residues_at"), py::arg("nucleotides") = false, py::doc("returns list of entry_seq having all residues at aligned positions, e.g. [\"142N\", \"283Q\"]"))
+            .def("reset_indexes", &Seqdb::reset_indexes, py::doc("must be called after modifying entries/sequences directly, e.g. via add_hi_name"))
             .def("aa_at_positions_for_antigens", [](const seqdb::Seqdb& aSeqdb, const acmacs::chart::Antigens& aAntigens, const std::vector<size_t>& aPositions, bool aVerbose) {
                                                      std::map<std::string, std::vector<size_t>> r; aSeqdb.aa_at_positions_for_antigens(aAntigens, aPositions, r, aVerbose ? seqdb::report::yes : seqdb::report::no); return r; }, py::arg("antigens"), py::arg("positions"), py::arg("verbose"))
             .def("match_antigens", [](const seqdb::Seqdb& aSeqdb, const acmacs::chart::Antigens& aAntigens, std::string aChartVirusType, bool aVerbose) {
                                        std::vector<seqdb::SeqdbEntrySeq> r; aSeqdb.match(aAntigens, r, aChartVirusType, aVerbose ? seqdb::report::yes : seqdb::report::no); return r; }, py::arg("antigens"), py::arg("virus_type") = std::string{}, py::arg("verbose") = true)
             ;
 
+    py::class_<seqdb::SequenceClass>(m, "SequenceClass")
+            .def_readonly("nucleotides", &seqdb::SequenceClass::nucleotides)
+            .def_readonly("valid", &seqdb::SequenceClass::valid)
+            .def_readonly("size", &seqdb::SequenceClass::size)
+            .def_readonly("ambiguous", &seqdb::SequenceClass::ambiguous)
+            .def_readonly("gaps", &seqdb::SequenceClass::gaps)
+            .def_readonly("stops", &seqdb::SequenceClass::stops)
+            .def_readonly("lower_case", &seqdb::SequenceClass::lower_case)
+            .def_readonly("invalid", &seqdb::SequenceClass::invalid)
+            ;
+
+    m.def("classify_sequence", &seqdb::classify_sequence, py::arg("sequence"), py::doc("nucleotides or amino acids, validity and counts of ambiguous symbols, gaps and stops in one pass"));
+    m.def("normalize_sequence", [](std::string sequence) { seqdb::normalize_sequence(sequence); return sequence; }, py::arg("sequence"), py::doc("upper-cases and replaces / with -"));
+
     m.def("setup_dbs", [](std::string db_dir, bool aVerbose) { seqdb::setup_dbs(db_dir, aVerbose ? seqdb::report::yes : seqdb::report::no); }, py::arg("db_dir"), py::arg("verbose") = false);
     m.def("seqdb_setup", [](std::string filename, bool aVerbose) { seqdb::setup(filename, aVerbose ? seqdb::report::yes : seqdb::report::no); }, py::arg("filename"), py::arg("verbose") = false);
+    m.def("clade_definitions_setup", [](std::string filename) { seqdb::clade_definitions_setup(filename); }, py::arg("filename"), py::doc("clade definitions are read from filename instead of $ACMACSD_ROOT/share/conf/clades.json"));
     m.def("get_seqdb", [](bool aTimer) { return seqdb::get(seqdb::ignore_errors::no, do_report_time(aTimer)); }, py::arg("timer") = false, py::return_value_policy::reference);
+    m.def("align_cache_open", [](std::string filename) { seqdb::align_cache().open(filename); }, py::arg("filename"), py::doc("reads alignment cache (if file exists) and enables caching of alignment results, see align-cache.hh"));
+    m.def("align_cache_save", []() { seqdb::align_cache().save(); }, py::doc("writes alignment cache to the file passed to align_cache_open if it was updated"));
+    m.def("align_cache_report", []() { return seqdb::align_cache().report(); });
 
 
 }
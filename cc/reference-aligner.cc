@@ -0,0 +1,213 @@
+#include <map>
+#include <tuple>
+#include <array>
+#include <numeric>
+#include <algorithm>
+
+#include "acmacs-base/string-split.hh"
+#include "seqdb/reference-aligner.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+static constexpr const int SCORE_MATCH = 5;
+static constexpr const int SCORE_MISMATCH = -4;
+static constexpr const int SCORE_GAP_OPEN = 11;   // includes extension of the first gap position
+static constexpr const int SCORE_GAP_EXTEND = 1;
+static constexpr const std::ptrdiff_t BAND = 24;   // cells farther than BAND from the seed diagonal are not computed
+static constexpr const size_t MINIMUM_SEED_HITS = 20;
+static constexpr const size_t MINIMUM_ALIGNED_PAIRS = 100;
+  // identical positions per position of the query overlapping the reference, HA of other subtypes (e.g. H5 against H1) is
+  // about 60% identical and must not be aligned (and relabelled) by the reference of a supported subtype
+static constexpr const double MINIMUM_IDENTITY = 0.85;
+
+static inline size_t kmer_code(std::string_view aSource, size_t aPos)
+{
+    size_t code = 0;
+    for (size_t offset = 0; offset < 3; ++offset) {
+        const auto symbol = aSource[aPos + offset];
+        if (symbol < 'A' || symbol > 'Z' || symbol == 'X')
+            return std::string_view::npos;
+        code = code * 26 + static_cast<size_t>(symbol - 'A');
+    }
+    return code;
+}
+
+static inline int score(char aQuery, char aReference)
+{
+    if (aQuery == 'X' || aReference == 'X')
+        return 0;
+    return aQuery == aReference ? SCORE_MATCH : SCORE_MISMATCH;
+}
+
+// ----------------------------------------------------------------------
+
+ReferenceAligner::ReferenceAligner(const Seqdb& aSeqdb)
+{
+    std::map<std::tuple<std::string_view, std::string_view, std::string_view>, std::pair<const SeqdbSeq*, size_t>> longest; // (subtype, lineage, gene) -> (seq, size of its part without stop codons)
+    for (const auto entry_seq : aSeqdb) {
+        const auto& seq = entry_seq.seq();
+        if (const auto shift = seq.amino_acids_shift().value_opt(); shift.has_value() && !seq.gene_view().empty() && !entry_seq.entry().virus_type().empty()) {
+            const auto window = longest_stop_free_window(seq.amino_acids_view(), *shift);
+            auto& found = longest[{entry_seq.entry().virus_type(), entry_seq.entry().lineage(), seq.gene_view()}];
+            if (found.second < (window.end - window.begin))
+                found = {&seq, window.end - window.begin};
+        }
+    }
+    for (const auto& [key, seq_size] : longest) {
+        const auto& [subtype, lineage, gene] = key;
+        add_reference(AlignData(subtype, lineage, gene, Shift()), seq_size.first->amino_acids_aligned().str());
+    }
+
+} // ReferenceAligner::ReferenceAligner
+
+// ----------------------------------------------------------------------
+
+void ReferenceAligner::add_reference(const AlignData& aData, std::string&& aAminoAcids)
+{
+    auto& ref = mReferences.emplace_back(reference_t{aData, std::move(aAminoAcids), std::vector<uint32_t>(number_of_kmers + 1, 0), {}});
+      // counting sort of k-mer positions
+    for (size_t pos = 0; (pos + kmer_size) <= ref.amino_acids.size(); ++pos) {
+        if (const auto code = kmer_code(ref.amino_acids, pos); code != std::string_view::npos)
+            ++ref.kmer_first[code + 1];
+    }
+    std::partial_sum(ref.kmer_first.begin(), ref.kmer_first.end(), ref.kmer_first.begin());
+    ref.kmer_positions.resize(ref.kmer_first.back());
+    auto next = ref.kmer_first;
+    for (size_t pos = 0; (pos + kmer_size) <= ref.amino_acids.size(); ++pos) {
+        if (const auto code = kmer_code(ref.amino_acids, pos); code != std::string_view::npos)
+            ref.kmer_positions[next[code]++] = static_cast<uint32_t>(pos);
+    }
+
+} // ReferenceAligner::add_reference
+
+// ----------------------------------------------------------------------
+
+AlignAminoAcidsData ReferenceAligner::align(std::string_view aNucleotides, std::string_view aAminoAcids) const
+{
+    std::array<std::string, 3> translated;
+    size_t frames = 1;
+    if (!aNucleotides.empty()) {
+        if (translate_nucleotides_to_amino_acids(aNucleotides, translated) < MINIMUM_SEQUENCE_AA_LENGTH)
+            return AlignAminoAcidsData::alignment_failed();
+        frames = translated.size();
+    }
+    else
+        translated[0] = aAminoAcids;
+
+    AlignAminoAcidsData result = AlignAminoAcidsData::alignment_failed();
+    int best_score = 0;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        size_t prefix_len = 0;
+        for (const auto& part : acmacs::string::split(translated[frame], "*")) {
+            if (part.size() >= MINIMUM_SEQUENCE_AA_LENGTH) {
+                for (const auto& ref : mReferences) {
+                    if (const auto found = match(part, ref); found.score > best_score && found.pairs >= MINIMUM_ALIGNED_PAIRS && static_cast<double>(found.identical) >= static_cast<double>(overlap(part, ref, found.shift)) * MINIMUM_IDENTITY) {
+                        best_score = found.score;
+                        result = AlignAminoAcidsData(ref.data, aNucleotides.empty() ? std::string{} : translated[frame], static_cast<int>(frame));
+                        result.shift = found.shift - static_cast<std::ptrdiff_t>(prefix_len);
+                    }
+                }
+            }
+            prefix_len += 1 + part.size();
+        }
+    }
+    return result;
+
+} // ReferenceAligner::align
+
+// ----------------------------------------------------------------------
+
+size_t ReferenceAligner::overlap(std::string_view aPart, const reference_t& aReference, std::ptrdiff_t aShift)
+{
+      // local alignment may cover just a conserved region (e.g. HA2), identity is therefore counted over the whole overlap
+    const auto first = std::max(std::ptrdiff_t{0}, -aShift);
+    const auto last = std::min(static_cast<std::ptrdiff_t>(aPart.size()), static_cast<std::ptrdiff_t>(aReference.amino_acids.size()) - aShift);
+    return last > first ? static_cast<size_t>(last - first) : 0;
+
+} // ReferenceAligner::overlap
+
+// ----------------------------------------------------------------------
+
+ReferenceAligner::match_t ReferenceAligner::match(std::string_view aPart, const reference_t& aReference) const
+{
+    const auto& ref = aReference.amino_acids;
+    if (aPart.size() < kmer_size || ref.size() < kmer_size)
+        return {};
+
+      // seed: diagonal (reference pos - query pos) having most k-mer hits
+    std::vector<uint32_t> hits(aPart.size() + ref.size(), 0); // index: diagonal + query size
+    for (size_t qpos = 0; (qpos + kmer_size) <= aPart.size(); ++qpos) {
+        if (const auto code = kmer_code(aPart, qpos); code != std::string_view::npos) {
+            for (auto rpos = aReference.kmer_positions.begin() + aReference.kmer_first[code], last = aReference.kmer_positions.begin() + aReference.kmer_first[code + 1]; rpos != last; ++rpos)
+                ++hits[*rpos + aPart.size() - qpos];
+        }
+    }
+    const auto best_diagonal = std::max_element(hits.begin(), hits.end());
+    if (*best_diagonal < MINIMUM_SEED_HITS)
+        return {};
+    const auto diagonal = static_cast<std::ptrdiff_t>(best_diagonal - hits.begin()) - static_cast<std::ptrdiff_t>(aPart.size());
+
+      // banded local alignment, cell (qpos, rpos) is stored at band index rpos - qpos - diagonal + BAND,
+      // every state carries the beginning of its alignment and the counts of aligned and identical pairs
+    struct cell_t
+    {
+        int score = 0;
+        uint32_t qstart = 0, rstart = 0, pairs = 0, identical = 0;
+    };
+    constexpr const size_t band_width = 2 * BAND + 1;
+    std::vector<cell_t> h_prev(band_width), h_cur(band_width), f_prev(band_width), f_cur(band_width); // f: gap in the reference, along the column
+    const auto better = [](const cell_t& c1, const cell_t& c2) -> const cell_t& { return c2.score > c1.score ? c2 : c1; };
+    const auto gap = [](const cell_t& open_from, const cell_t& extend_from) {
+        cell_t opened = open_from, extended = extend_from;
+        opened.score -= SCORE_GAP_OPEN;
+        extended.score -= SCORE_GAP_EXTEND;
+        return extended.score > opened.score ? extended : opened;
+    };
+    cell_t best;
+    for (std::ptrdiff_t qpos = 0; qpos < static_cast<std::ptrdiff_t>(aPart.size()); ++qpos) {
+        cell_t e_cur; // gap in the query, along the row
+        e_cur.score = -SCORE_GAP_OPEN;
+        for (std::ptrdiff_t band_pos = 0; band_pos < static_cast<std::ptrdiff_t>(band_width); ++band_pos) {
+            const auto rpos = qpos + diagonal + band_pos - BAND;
+            auto& h = h_cur[static_cast<size_t>(band_pos)];
+            auto& f = f_cur[static_cast<size_t>(band_pos)];
+            if (rpos < 0 || rpos >= static_cast<std::ptrdiff_t>(ref.size())) {
+                h = f = cell_t{};
+                f.score = -SCORE_GAP_OPEN;
+                continue;
+            }
+              // (qpos-1, rpos-1) is at band_pos in the previous row, (qpos-1, rpos) at band_pos+1, (qpos, rpos-1) at band_pos-1 in this row
+            cell_t diag = h_prev[static_cast<size_t>(band_pos)];
+            if (diag.score == 0)
+                diag = cell_t{0, static_cast<uint32_t>(qpos), static_cast<uint32_t>(rpos), 0, 0};
+            const auto symbol_score = score(aPart[static_cast<size_t>(qpos)], ref[static_cast<size_t>(rpos)]);
+            diag.score += symbol_score;
+            ++diag.pairs;
+            if (symbol_score == SCORE_MATCH)
+                ++diag.identical;
+            f = band_pos < static_cast<std::ptrdiff_t>(band_width - 1) ? gap(h_prev[static_cast<size_t>(band_pos + 1)], f_prev[static_cast<size_t>(band_pos + 1)]) : cell_t{-SCORE_GAP_OPEN};
+            if (band_pos > 0)
+                e_cur = gap(h_cur[static_cast<size_t>(band_pos - 1)], e_cur);
+            h = better(better(diag, f), e_cur);
+            if (h.score <= 0)
+                h = cell_t{};
+            else if (h.score > best.score)
+                best = h;
+        }
+        std::swap(h_prev, h_cur);
+        std::swap(f_prev, f_cur);
+    }
+
+    if (best.score == 0)
+        return {};
+    return {best.score, best.pairs, best.identical, static_cast<std::ptrdiff_t>(best.rstart) - static_cast<std::ptrdiff_t>(best.qstart)};
+
+} // ReferenceAligner::match
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
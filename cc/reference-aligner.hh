@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "seqdb/amino-acids.hh"
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+
+      // Fallback for sequences not having any ALIGN_RAW_DATA signature: local alignment
+      // (Smith-Waterman with affine gaps) of the translation against reference proteins,
+      // restricted to a band around the diagonal having most matching 3-mers. Reference for
+      // every subtype, lineage and gene is its aligned sequence in seqdb having the longest
+      // part without stop codons. Shift is derived from the beginning of the best local
+      // alignment, subtype, lineage and gene are of the reference. The query must be identical to the
+      // reference at 85% of the positions overlapping it, sequences of other subtypes are left not aligned.
+    class ReferenceAligner
+    {
+     public:
+        ReferenceAligner(const Seqdb& aSeqdb);
+
+          // translates nucleotides (if not empty) with all three offsets, otherwise uses amino acids,
+          // shift of the result is AlignmentFailed if no reference matches well enough
+        AlignAminoAcidsData align(std::string_view aNucleotides, std::string_view aAminoAcids) const;
+
+        size_t number_of_references() const { return mReferences.size(); }
+
+     private:
+        static constexpr const size_t kmer_size = 3;
+        static constexpr const size_t number_of_kmers = 26 * 26 * 26;
+
+        struct reference_t
+        {
+            AlignData data;
+            std::string amino_acids;          // aligned
+            std::vector<uint32_t> kmer_first; // positions of k-mer n are kmer_positions[kmer_first[n] : kmer_first[n + 1]]
+            std::vector<uint32_t> kmer_positions;
+        };
+
+        struct match_t
+        {
+            int score = 0;
+            size_t pairs = 0;   // aligned (not gap) positions
+            size_t identical = 0;
+            std::ptrdiff_t shift = 0;
+        };
+
+        std::vector<reference_t> mReferences;
+
+        void add_reference(const AlignData& aData, std::string&& aAminoAcids);
+        match_t match(std::string_view aPart, const reference_t& aReference) const;
+        static size_t overlap(std::string_view aPart, const reference_t& aReference, std::ptrdiff_t aShift);
+
+    }; // class ReferenceAligner
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
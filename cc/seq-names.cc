@@ -0,0 +1,41 @@
+#include "seqdb/seq-names.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+SeqNames::SeqNames(const Seqdb& aSeqdb)
+{
+    const auto num_seqs = aSeqdb.number_of_seqs();
+    mFirstSeq.reserve(aSeqdb.number_of_entries());
+    mSeqs.reserve(num_seqs);
+    mBuffer.reserve(num_seqs * 80);
+    for (const auto& entry : aSeqdb.entries()) {
+        mFirstSeq.push_back(static_cast<uint32_t>(mSeqs.size()));
+        for (const auto& seq : entry.seqs()) {
+            const SeqdbEntrySeq entry_seq(entry, seq);
+            const auto seq_id = entry_seq.seq_id(SeqdbEntrySeq::encoded_t::no);
+            const auto seq_id_encoded = name_encode(seq_id);
+            const auto stored_seq_id = store(seq_id);
+            mSeqs.push_back({store(entry_seq.make_name()), stored_seq_id, seq_id_encoded == seq_id ? stored_seq_id : store(seq_id_encoded)});
+        }
+    }
+    mBuffer.shrink_to_fit();
+
+} // SeqNames::SeqNames
+
+// ----------------------------------------------------------------------
+
+SeqNames::stored_t SeqNames::store(std::string_view aSource)
+{
+    const stored_t result{static_cast<uint32_t>(mBuffer.size()), static_cast<uint32_t>(aSource.size())};
+    mBuffer.append(aSource);
+    return result;
+
+} // SeqNames::store
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+
+      // Display names (SeqdbEntrySeq::make_name()), seq_ids and encoded seq_ids of all sequences,
+      // formatted once and stored in a single buffer. Encoded seq_id shares the storage with seq_id
+      // when encoding does not change it. Built on demand by Seqdb::seq_names(), dropped by
+      // Seqdb::reset_indexes() as any modification of seqdb may change names.
+    class SeqNames
+    {
+     public:
+        SeqNames(const Seqdb& aSeqdb);
+
+        std::string_view name(size_t aEntryNo, size_t aSeqNo) const { return get(aEntryNo, aSeqNo, column::name); }
+        std::string_view seq_id(size_t aEntryNo, size_t aSeqNo) const { return get(aEntryNo, aSeqNo, column::seq_id); }
+        std::string_view seq_id_encoded(size_t aEntryNo, size_t aSeqNo) const { return get(aEntryNo, aSeqNo, column::seq_id_encoded); }
+
+     private:
+        enum class column : size_t { name, seq_id, seq_id_encoded };
+
+        struct stored_t
+        {
+            uint32_t offset, size;
+        };
+
+        std::string mBuffer;
+        std::vector<uint32_t> mFirstSeq; // per entry, index of its first sequence in mSeqs
+        std::vector<std::array<stored_t, 3>> mSeqs;
+
+        std::string_view get(size_t aEntryNo, size_t aSeqNo, column aColumn) const
+            {
+                const auto& stored = mSeqs[mFirstSeq[aEntryNo] + aSeqNo][static_cast<size_t>(aColumn)];
+                return std::string_view{mBuffer}.substr(stored.offset, stored.size);
+            }
+
+        stored_t store(std::string_view aSource);
+
+    }; // class SeqNames
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -22,6 +22,7 @@ using amino_acids_data_t = std::vector<position_entry_t>;
 struct Options;
 
 static std::pair<std::string_view, std::string_view> extract_date_range(std::string_view date_range);
+static void add(position_entry_t& at, char aa, unsigned count);
 static amino_acids_data_t collect(const seqdb::Seqdb& seqdb, std::string_view date_range, const Options& opt);
 static void report(const amino_acids_data_t& amino_acids_data, const Options& opt);
 static void report(const amino_acids_data_t& amino_acids_data_1, const amino_acids_data_t& amino_acids_data_2, const Options& opt);
@@ -39,6 +40,7 @@ struct Options : public argv
     option<str>   date_range_1{*this, "date-range", desc{"YYYY-MM-DD:YYYY-MM-DD, parts optional, semicolon required"}};
     option<str>   date_range_2{*this, "date-range-2", desc{"YYYY-MM-DD:YYYY-MM-DD, parts optional, semicolon required"}};
     option<bool>  report_all_pos{*this, "report-all-pos", desc{"report all positions"}};
+    option<bool>  verbose{*this, 'v', "verbose", desc{"report filter plan and timings"}};
 };
 
 int main(int argc, char* const argv[])
@@ -64,41 +66,63 @@ int main(int argc, char* const argv[])
 
 amino_acids_data_t collect(const seqdb::Seqdb& seqdb, std::string_view date_range, const Options& opt)
 {
-    size_t num_sequences = 0;
     const auto [start, end] = extract_date_range(date_range);
-    auto iter = seqdb.begin();
-    iter.filter_subtype(acmacs::normalize_virus_type(*opt.flu))
+    seqdb::SeqdbFilter filter;
+    filter.filter_subtype(acmacs::normalize_virus_type(*opt.flu))
             .filter_lineage(acmacs::normalize_lineage(*opt.lineage))
             .filter_clade(string::upper(*opt.clade))
             .filter_date_range(start, end)
+            .report_plan(*opt.verbose)
             ;
 
-    amino_acids_data_t amino_acids_data(MAX_NUM_POSITIONS);
-    size_t max_pos = 0;
-    for (; iter != seqdb.end(); ++iter) {
-        const auto seq = (*iter).seq().amino_acids(true);
-        for (size_t pos = 0; pos < seq.size(); ++pos) {
-            auto& at = amino_acids_data[pos];
-            if (const auto found = std::find_if(std::begin(at), std::end(at), [aa = seq[pos]](const auto& entry) { return entry.first == aa; }); found != std::end(at))
-                ++found->second;
-            else
-                at.emplace_back(seq[pos], 1);
-        }
-        max_pos = std::max(max_pos, seq.size());
-        ++num_sequences;
-    }
-    std::cerr << date_range << " sequences: " << num_sequences << " max-pos: " << max_pos << '\n';
-    amino_acids_data.resize(max_pos);
+    struct collected_t
+    {
+        amino_acids_data_t amino_acids_data = amino_acids_data_t(MAX_NUM_POSITIONS);
+        size_t num_sequences = 0;
+        size_t max_pos = 0;
+    };
+
+    auto collected = seqdb.parallel_reduce(
+        filter, collected_t{},
+        [](collected_t& target, const seqdb::SeqdbEntrySeq& entry_seq) {
+            const auto seq = entry_seq.seq().amino_acids_aligned();
+            for (size_t pos = 0; pos < seq.size(); ++pos)
+                add(target.amino_acids_data[pos], seq[pos], 1);
+            target.max_pos = std::max(target.max_pos, seq.size());
+            ++target.num_sequences;
+        },
+        [](collected_t& target, collected_t&& source) {
+            for (size_t pos = 0; pos < source.max_pos; ++pos) {
+                for (const auto& [aa, count] : source.amino_acids_data[pos])
+                    add(target.amino_acids_data[pos], aa, count);
+            }
+            target.max_pos = std::max(target.max_pos, source.max_pos);
+            target.num_sequences += source.num_sequences;
+        });
+    std::cerr << date_range << " sequences: " << collected.num_sequences << " max-pos: " << collected.max_pos << '\n';
+    auto& amino_acids_data = collected.amino_acids_data;
+    amino_acids_data.resize(collected.max_pos);
 
     std::for_each(std::begin(amino_acids_data), std::end(amino_acids_data),
                   [](auto& entry) { std::sort(std::begin(entry), std::end(entry), [](const auto& e1, const auto& e2) { return e1.second > e2.second; }); });
 
-    return amino_acids_data;
+    return std::move(amino_acids_data);
 
 } // collect
 
 // ----------------------------------------------------------------------
 
+void add(position_entry_t& at, char aa, unsigned count)
+{
+    if (const auto found = std::find_if(std::begin(at), std::end(at), [aa](const auto& entry) { return entry.first == aa; }); found != std::end(at))
+        found->second += count;
+    else
+        at.emplace_back(aa, count);
+
+} // add
+
+// ----------------------------------------------------------------------
+
 static std::pair<std::string_view, std::string_view> extract_date_range(std::string_view date_range)
 {
     if (!date_range.empty()) {
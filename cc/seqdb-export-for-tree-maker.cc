@@ -64,17 +64,19 @@ int main(int argc, char* const argv[])
         const std::string base_seq_aa = base_seq.seq().amino_acids(true, 0, aa_common_length);
         acmacs::file::ofstream output_nucs(args["--output-nucs"]);
         acmacs::file::ofstream output_aa(args["--output-aa"] ? args["--output-aa"].str() : "/dev/null"s);
+        const auto& seqdb = seqdb::get();
         for (const auto& seq : to_export) {
             std::string nucs = seq.seq().nucleotides(true, 0, aa_common_length * 3);
             std::string aa = seq.seq().amino_acids(true, 0, aa_common_length);
-            destroy_failed_sequence_end(seq.seq_id(seqdb::SeqdbEntrySeq::encoded_t::yes), aa, nucs, base_seq_aa, base_seq_nucs);
-            output_nucs.stream() << '>' << seq.seq_id(seqdb::SeqdbEntrySeq::encoded_t::yes) << '\n' << nucs << '\n';
-            output_aa.stream() << '>' << seq.seq_id(seqdb::SeqdbEntrySeq::encoded_t::yes) << '\n' << aa << '\n';
+            const auto seq_id = seqdb.seq_id_of(seq, seqdb::SeqdbEntrySeq::encoded_t::yes);
+            destroy_failed_sequence_end(std::string{seq_id}, aa, nucs, base_seq_aa, base_seq_nucs);
+            output_nucs.stream() << '>' << seq_id << '\n' << nucs << '\n';
+            output_aa.stream() << '>' << seq_id << '\n' << aa << '\n';
         }
         if (args["--output-names"]) {
             acmacs::file::ofstream output(args["--output-names"]);
             for (const auto& seq : to_export)
-                output.stream() << seq.seq_id(seqdb::SeqdbEntrySeq::encoded_t::yes) << '\n';
+                output.stream() << seqdb.seq_id_of(seq, seqdb::SeqdbEntrySeq::encoded_t::yes) << '\n';
         }
         return 0;
     }
@@ -132,8 +134,9 @@ std::vector<seqdb::SeqdbEntrySeq> collect(std::string virus_type, std::string li
     std::copy_if(begin, seqdb::get().end(), std::back_inserter(sequences), [&base_seq](const auto& es) { return es != base_seq; });
     std::cerr << "INFO: " << sequences.size() << " total sequences found\n";
 
-    std::sort(sequences.begin(), sequences.end(), [](const auto& es1, const auto& es2) { return es1.seq_id(seqdb::SeqdbEntrySeq::encoded_t::no) < es2.seq_id(seqdb::SeqdbEntrySeq::encoded_t::no); });
-    const auto uniq_end = std::unique(sequences.begin(), sequences.end(), [](const auto& es1, const auto& es2) { return es1.seq_id(seqdb::SeqdbEntrySeq::encoded_t::no) == es2.seq_id(seqdb::SeqdbEntrySeq::encoded_t::no); });
+    const auto seq_id = [&seqdb = seqdb::get()](const auto& es) { return seqdb.seq_id_of(es, seqdb::SeqdbEntrySeq::encoded_t::no); };
+    std::sort(sequences.begin(), sequences.end(), [&seq_id](const auto& es1, const auto& es2) { return seq_id(es1) < seq_id(es2); });
+    const auto uniq_end = std::unique(sequences.begin(), sequences.end(), [&seq_id](const auto& es1, const auto& es2) { return seq_id(es1) == seq_id(es2); });
     if (uniq_end != sequences.end()) {
         std::cerr << "INFO: seq_id duplicates removed: " << (sequences.end() - uniq_end) << '\n';
         sequences.erase(uniq_end, sequences.end());
@@ -156,7 +159,7 @@ std::pair<size_t, std::vector<seqdb::SeqdbEntrySeq>> pick(const std::vector<seqd
     std::vector<seqdb::SeqdbEntrySeq> result;
     // acmacs::Counter<size_t> counter;
     for (auto seqp = sequences.begin(); seqp != sequences.end() && result.size() < number_to_pick; ++seqp) {
-        const std::string nucs = seqp->seq().nucleotides(true, 0, aa_common_length * 3);
+        const auto nucs = seqp->seq().nucleotides_aligned(0, aa_common_length * 3);
         const auto hamming_distance_with_base = acmacs::seqdb::hamming_distance(base_seq_nucs, nucs);
         if (hamming_distance_with_base < hamming_distance_threshold) {
             result.push_back(*seqp);
@@ -178,7 +181,7 @@ std::pair<size_t, std::vector<seqdb::SeqdbEntrySeq>> pick(const std::vector<seqd
 
 static size_t common_length(entry_seq_iter_t first, entry_seq_iter_t last)
 {
-    return acmacs::Counter(first, last, [](const auto& es) { return es.seq().amino_acids(true).size(); }).max().first;
+    return acmacs::Counter(first, last, [](const auto& es) { return es.seq().amino_acids_aligned().size(); }).max().first;
 
 } // common_length
 
@@ -27,7 +27,20 @@ template <typename RW> inline json_writer::writer<RW>& operator<<(json_writer::w
 
 // ----------------------------------------------------------------------
 
-static constexpr const char* SEQDB_JSON_DUMP_VERSION = "sequence-database-v2";
+static constexpr const char* SEQDB_JSON_DUMP_VERSION = "sequence-database-v3"; // v3: "  summary", "  indel-masters", seq "I" and "H"
+
+// ----------------------------------------------------------------------
+
+  // 16 hex digits, empty for 0 (not set)
+static inline std::string hash_to_hex(uint64_t aHash)
+{
+    if (aHash == 0)
+        return {};
+    std::string result(16, '0');
+    for (auto digit = result.rbegin(); aHash != 0; ++digit, aHash >>= 4)
+        *digit = "0123456789abcdef"[aHash & 0xF];
+    return result;
+}
 
 // ----------------------------------------------------------------------
 
@@ -54,15 +67,17 @@ template <typename RW> jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, con
 {
     return writer << jsw::start_object
                   << jsw::if_not_empty(SeqdbJsonKey::Passages, seq.passages())
-                  << jsw::if_not_empty(SeqdbJsonKey::Nucleotides, seq.nucleotides(false))
-                  << jsw::if_not_empty(SeqdbJsonKey::AminoAcids, seq.amino_acids(false))
+                  << jsw::if_not_empty(SeqdbJsonKey::Nucleotides, seq.nucleotides_view())
+                  << jsw::if_not_empty(SeqdbJsonKey::AminoAcids, seq.amino_acids_view())
                   << if_aligned(SeqdbJsonKey::NucleotideShift, seq.nucleotides_shift())
                   << if_aligned(SeqdbJsonKey::AminoAcidShift, seq.amino_acids_shift())
                   << jsw::if_not_empty(SeqdbJsonKey::LabIds, seq.lab_ids_raw())
-                  << jsw::if_not_empty(SeqdbJsonKey::Gene, seq.gene())
+                  << jsw::if_not_empty(SeqdbJsonKey::Gene, seq.gene_view())
                   << jsw::if_not_empty(SeqdbJsonKey::HiNames, seq.hi_names())
                   << jsw::if_not_empty(SeqdbJsonKey::Reassortant, seq.reassortant())
                   << jsw::if_not_empty(SeqdbJsonKey::Clades, seq.clades())
+                  << jsw::if_not_empty(SeqdbJsonKey::IndelsMaster, seq.indels_master())
+                  << jsw::if_not_empty(SeqdbJsonKey::CladesHash, hash_to_hex(seq.clades_hash()))
                   << jsw::end_object;
 }
 
@@ -88,6 +103,8 @@ template <typename RW> jsw::writer<RW>& operator <<(jsw::writer<RW>& writer, con
     return writer << jsw::start_object
                   << jsw::key("  version") << SEQDB_JSON_DUMP_VERSION
                   << jsw::key("  date") << date::current_date_time()
+                  << jsw::key("  summary") << seqdb::SeqdbSummary(seqdb).to_string() // must precede "data", see seqdb::read_summary()
+                  << jsw::key("  indel-masters") << seqdb.indel_masters_to_string()
                   << jsw::key("data") << seqdb.entries()
                   << jsw::end_object;
 }
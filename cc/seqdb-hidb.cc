@@ -194,6 +194,7 @@ std::vector<std::string> Seqdb::match_hidb(seqdb::report aReport, bool aGreedy)
     std::ostream& report_stream = std::cerr;
 
     std::vector<const SeqdbEntry*> not_matched;
+    reset_indexes(); // hi names are going to be updated
     for (auto& entry: mEntries) {
         if (aReport == seqdb::report::yes)
             report_stream << '\n' << entry << '\n';
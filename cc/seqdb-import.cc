@@ -10,7 +10,9 @@ namespace jsi = json_importer;
 
 namespace seqdb
 {
-    static constexpr const char* SEQDB_JSON_DUMP_VERSION = "sequence-database-v2";
+    static constexpr const char* SEQDB_JSON_DUMP_VERSION = "sequence-database-v3";
+      // v2 files have no summary, indel masters and I, H fields of sequences, they are filled on the next save
+    static constexpr const char* SEQDB_JSON_DUMP_VERSION_V2 = "sequence-database-v2";
 
       // ----------------------------------------------------------------------
 
@@ -28,7 +30,7 @@ namespace seqdb
         inline void version(const char* str, size_t length)
             {
                 const std::string version{str, length};
-                if (version != SEQDB_JSON_DUMP_VERSION)
+                if (version != SEQDB_JSON_DUMP_VERSION && version != SEQDB_JSON_DUMP_VERSION_V2)
                     throw std::runtime_error("Unsupported seqdb version: \"" + version + "\"");
             }
 
@@ -36,6 +38,16 @@ namespace seqdb
             {
             }
 
+        inline void summary(const char* str, size_t length)
+            {
+                mSeqdb.summary_from_header(std::string_view(str, length));
+            }
+
+        inline void indel_masters(const char* str, size_t length)
+            {
+                mSeqdb.indel_masters_from_string(std::string_view(str, length));
+            }
+
         inline std::vector<SeqdbEntry>& seqdb() { return mSeqdb.entries(); }
 
      private:
@@ -45,7 +57,7 @@ namespace seqdb
 
       // ----------------------------------------------------------------------
 
-    using LabIds = std::map<std::string, std::vector<std::string>>;
+    using LabIds = SeqdbSeq::LabIds;
 
     class LabIdStorer : public jsi::StorerBase
     {
@@ -116,6 +128,7 @@ namespace seqdb
             {"d", jsi::field(&GisaidData::list)},
         };
 
+        using SSS = void (SeqdbSeq::*)(const char*, size_t);
         jsi::data<SeqdbSeq> seq_data = {
             {"a", jsi::field(&SeqdbSeq::amino_acids)},
             {"c", jsi::field(&SeqdbSeq::clades)},
@@ -129,6 +142,8 @@ namespace seqdb
             {"s", jsi::field(&SeqdbSeq::amino_acids_shift_raw)},
             {"t", jsi::field(&SeqdbSeq::nucleotides_shift_raw)},
             {"G", jsi::field(&SeqdbSeq::gisaid, gisaid_data)},
+            {"I", jsi::field(static_cast<SSS>(&SeqdbSeq::indels_master))},
+            {"H", jsi::field(&SeqdbSeq::clades_hash)},
         };
 
         using ESS = void (SeqdbEntry::*)(const char*, size_t);
@@ -146,6 +161,8 @@ namespace seqdb
             {"_", jsi::field(&SeqdbDataFile::indentation)},
             {"  version", jsi::field(&SeqdbDataFile::version)},
             {"  date", jsi::field(&SeqdbDataFile::date)},
+            {"  summary", jsi::field(&SeqdbDataFile::summary)},
+            {"  indel-masters", jsi::field(&SeqdbDataFile::indel_masters)},
             {"data", jsi::field(&SeqdbDataFile::seqdb, entry_data)},
         };
 
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <algorithm>
 using namespace std::string_literals;
 
 #include "acmacs-base/argv.hh"
@@ -36,6 +37,19 @@ inline std::ostream& operator<<(std::ostream& s, const Info& c)
     return s;
 }
 
+inline Info& operator+=(Info& target, const Info& source)
+{
+    target.entries += source.entries;
+    target.sequences += source.sequences;
+    target.with_hi_names += source.with_hi_names;
+    for (auto [target_map, source_map] : {std::pair{&target.all_by_month, &source.all_by_month}, std::pair{&target.with_hi_names_by_month, &source.with_hi_names_by_month},
+                                          std::pair{&target.clades, &source.clades}, std::pair{&target.clade_set, &source.clade_set}}) {
+        for (const auto& [key, count] : *source_map)
+            (*target_map)[key] += count;
+    }
+    return target;
+}
+
 // ----------------------------------------------------------------------
 
 using namespace acmacs::argv;
@@ -45,76 +59,238 @@ struct Options : public argv
     Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
 
     option<str>   lab{*this, "lab", dflt{"all"}, desc{"filter by lab that submitted the sequence"}};
+    option<bool>  recompute{*this, "recompute", desc{"do not use summary stored in the file header, compute from data and compare with the stored summary"}};
     argument<str> seqdb_file{*this, arg_name{"~/AD/data/seqdb.json.xz"}, mandatory};
 };
 
+using seqdb::group_key;
+
+static const std::vector<seqdb::group_keys_t> sInfoGroupings{
+    {group_key::subtype, group_key::lineage},
+    {group_key::subtype, group_key::lineage, group_key::month, group_key::hi_matched},
+    {group_key::subtype, group_key::lineage, group_key::clade},
+    {group_key::subtype, group_key::lineage, group_key::clade_set},
+};
+
+static void report(const std::vector<const seqdb::GroupByTable*>& info_tables);
+static void report_entries_of_lab(const seqdb::Seqdb& seqdb, std::string_view lab);
+static bool has_entries_without_virus_type_or_lineage(const seqdb::GroupByTable& by_subtype);
+static void report_entries_without_virus_type_or_lineage(const seqdb::Seqdb& seqdb);
+
+// ----------------------------------------------------------------------
+
 int main(int argc, char* const argv[])
 {
     try {
         Options opt(argc, argv);
+        const bool all_labs = opt.lab->empty() || *opt.lab == "all";
+
+        if (all_labs && !opt.recompute) {
+              // entries without virus type or lineage are reported by name, names are not in the summary
+            if (const auto summary = seqdb::read_summary(*opt.seqdb_file); summary.has_value() && !has_entries_without_virus_type_or_lineage(summary->table(sInfoGroupings.front()))) {
+                std::vector<const seqdb::GroupByTable*> info_tables;
+                for (const auto& keys : sInfoGroupings)
+                    info_tables.push_back(&summary->table(keys));
+                report(info_tables);
+                return 0;
+            }
+            std::cerr << "INFO: " << *opt.seqdb_file << " has no summary or it cannot be used, reading data\n";
+        }
 
         seqdb::setup(opt.seqdb_file, seqdb::report::yes);
         const auto& seqdb = seqdb::get(seqdb::ignore_errors::no, report_time::yes);
 
-        auto update = [](Info& target, const auto& entry) {
-            ++target.entries;
-            target.sequences += entry.number_of_seqs();
-            for (const auto& seq : entry.seqs()) {
-                if (!seq.hi_names().empty()) {
-                    ++target.with_hi_names;
-                    if (const auto date = entry.date(); !date.empty()) {
-                        ++target.with_hi_names_by_month[std::string{date.substr(0, 7)}];
-                        ++target.with_hi_names_by_month[std::string{date.substr(0, 4)} + "all"];
-                    }
+        if (!all_labs) {
+            report_entries_of_lab(seqdb, *opt.lab);
+            return 0;
+        }
+
+        const auto tables = seqdb.group_by(sInfoGroupings);
+        report_entries_without_virus_type_or_lineage(seqdb);
+        std::vector<const seqdb::GroupByTable*> info_tables;
+        for (const auto& table : tables)
+            info_tables.push_back(&table);
+        report(info_tables);
+
+        if (opt.recompute) {
+            if (const auto stored = seqdb::read_summary(*opt.seqdb_file); !stored.has_value())
+                std::cerr << "INFO: " << *opt.seqdb_file << " has no summary\n";
+            else if (*stored == seqdb::SeqdbSummary(seqdb))
+                std::cerr << "INFO: summary stored in " << *opt.seqdb_file << " matches data\n";
+            else
+                std::cerr << "WARNING: summary stored in " << *opt.seqdb_file << " differs from data\n";
+        }
+        return 0;
+    }
+    catch (std::exception& err) {
+        std::cerr << "ERROR: " << err.what() << '\n';
+        return 1;
+    }
+}
+
+// ----------------------------------------------------------------------
+
+void report(const std::vector<const seqdb::GroupByTable*>& info_tables)
+{
+    const auto& by_subtype = *info_tables[0];
+    const auto& by_month = *info_tables[1];
+    const auto& by_clade = *info_tables[2];
+    const auto& by_clade_set = *info_tables[3];
+
+    Info total;
+    std::map<std::string, Info> by_virus_type;
+      // Info objects a row of a table contributes to: total, virus type and, for B, virus type with lineage
+    auto targets = [&total, &by_virus_type](const seqdb::GroupByTable& table, const seqdb::GroupByTable::Row& row) {
+        const auto vt = table.value(row, 0), lineage = table.value(row, 1);
+        std::vector<Info*> result{&total, &by_virus_type[std::string{vt}]};
+        if (vt == "B" && !lineage.empty())
+            result.push_back(&by_virus_type[std::string{vt} + std::string{lineage}]);
+        return result;
+    };
+
+    for (const auto& row : by_subtype) {
+        for (auto* target : targets(by_subtype, row)) {
+            target->entries += row.entries;
+            target->sequences += row.seqs;
+        }
+    }
+    for (const auto& row : by_month) {
+        if (row.seqs == 0)
+            continue;           // entries without sequences
+        const auto month = by_month.value(row, 2);
+        const bool hi_matched = by_month.value(row, 3) == "yes";
+        for (auto* target : targets(by_month, row)) {
+            if (hi_matched)
+                target->with_hi_names += row.seqs;
+            if (!month.empty()) {
+                target->all_by_month[std::string{month}] += row.seqs;
+                target->all_by_month[std::string{month.substr(0, 4)} + "all"] += row.seqs;
+                if (hi_matched) {
+                    target->with_hi_names_by_month[std::string{month}] += row.seqs;
+                    target->with_hi_names_by_month[std::string{month.substr(0, 4)} + "all"] += row.seqs;
                 }
+            }
+        }
+    }
+    for (const auto& row : by_clade) {
+        if (const auto clade = by_clade.value(row, 2); !clade.empty()) {
+            for (auto* target : targets(by_clade, row))
+                target->clades[std::string{clade}] += row.seqs;
+        }
+    }
+    for (const auto& row : by_clade_set) {
+        if (const auto clade_set = by_clade_set.value(row, 2); !clade_set.empty()) {
+            for (auto* target : targets(by_clade_set, row))
+                target->clade_set[std::string{clade_set}] += row.seqs;
+        }
+    }
+
+    std::cout << "Total:\n" << total << '\n';
+    for (auto [virus_type, for_vt] : by_virus_type) {
+        std::cout << virus_type << ":\n" << for_vt << '\n';
+    }
+
+} // report
+
+// ----------------------------------------------------------------------
+
+bool has_entries_without_virus_type_or_lineage(const seqdb::GroupByTable& by_subtype)
+{
+    return std::any_of(by_subtype.begin(), by_subtype.end(), [&by_subtype](const auto& row) {
+        const auto vt = by_subtype.value(row, 0);
+        return vt.empty() || (vt == "B" && by_subtype.value(row, 1).empty());
+    });
+
+} // has_entries_without_virus_type_or_lineage
+
+// ----------------------------------------------------------------------
+
+void report_entries_without_virus_type_or_lineage(const seqdb::Seqdb& seqdb)
+{
+    for (const auto& entry : seqdb.entries()) {
+        if (const auto vt = entry.virus_type(); vt.empty())
+            std::cerr << "No virus_type for " << entry.name() << '\n';
+        else if (vt == "B" && entry.lineage().empty())
+            std::cerr << "No lineage for " << entry.name() << '\n';
+    }
+
+} // report_entries_without_virus_type_or_lineage
+
+// ----------------------------------------------------------------------
+
+  // all sequences of the entries having any sequence from aLab are counted, group_by filters sequences
+void report_entries_of_lab(const seqdb::Seqdb& seqdb, std::string_view lab)
+{
+    auto update = [](Info& target, const auto& entry) {
+        ++target.entries;
+        target.sequences += entry.number_of_seqs();
+        for (const auto& seq : entry.seqs()) {
+            if (!seq.hi_names().empty()) {
+                ++target.with_hi_names;
                 if (const auto date = entry.date(); !date.empty()) {
-                    ++target.all_by_month[std::string{date.substr(0, 7)}];
-                    ++target.all_by_month[std::string{date.substr(0, 4)} + "all"];
-                }
-                if (const auto& clades = seq.clades(); !clades.empty()) {
-                    for (const auto& clade : clades)
-                        ++target.clades[clade];
-                    ++target.clade_set[string::join(" ", clades)];
+                    ++target.with_hi_names_by_month[std::string{date.substr(0, 7)}];
+                    ++target.with_hi_names_by_month[std::string{date.substr(0, 4)} + "all"];
                 }
             }
-        };
-
-        auto filter_lab = [lab = *opt.lab](const auto& entry) -> bool {
-            if (lab.empty() || lab == "all")
-                return true;
-            return entry.has_lab(lab);
-        };
+            if (const auto date = entry.date(); !date.empty()) {
+                ++target.all_by_month[std::string{date.substr(0, 7)}];
+                ++target.all_by_month[std::string{date.substr(0, 4)} + "all"];
+            }
+            if (const auto& clades = seq.clades(); !clades.empty()) {
+                for (const auto& clade : clades)
+                    ++target.clades[clade];
+                ++target.clade_set[string::join(" ", clades)];
+            }
+        }
+    };
 
-        std::map<std::string, Info> by_virus_type;
+    struct collected_t
+    {
         Info total;
-        for (const auto& entry : seqdb.entries()) {
-            if (filter_lab(entry)) {
-                update(total, entry);
+        std::map<std::string, Info> by_virus_type;
+        std::vector<std::pair<size_t, std::string>> warnings; // entry no, message
+    };
+
+    const auto& entries = seqdb.entries();
+    std::vector<collected_t> per_thread(seqdb::parallel_threads());
+    const auto threads = seqdb::parallel_for(entries.size(), [&entries, &per_thread, &update, lab](size_t first, size_t last, size_t thread_no) {
+        auto& collected = per_thread[thread_no];
+        for (size_t entry_no = first; entry_no < last; ++entry_no) {
+            const auto& entry = entries[entry_no];
+            if (entry.has_lab(lab)) {
+                update(collected.total, entry);
                 const auto vt = entry.virus_type();
-                update(by_virus_type[std::string{vt}], entry);
+                update(collected.by_virus_type[std::string{vt}], entry);
                 if (vt.empty())
-                    std::cerr << "No virus_type for " << entry.name() << '\n';
+                    collected.warnings.emplace_back(entry_no, "No virus_type for "s + std::string{entry.name()});
                 else if (vt == "B") {
                     const auto lineage = entry.lineage();
                     if (lineage.empty())
-                        std::cerr << "No lineage for " << entry.name() << '\n';
+                        collected.warnings.emplace_back(entry_no, "No lineage for "s + std::string{entry.name()});
                     else
-                        update(by_virus_type[std::string{vt} + std::string{lineage}], entry);
+                        update(collected.by_virus_type[std::string{vt} + std::string{lineage}], entry);
                 }
             }
         }
+    });
 
-        std::cout << "Total:\n" << total << '\n';
-        for (auto [virus_type, for_vt] : by_virus_type) {
-            std::cout << virus_type << ":\n" << for_vt << '\n';
-        }
-        return 0;
+    auto& [total, by_virus_type, warnings] = per_thread.front();
+    for (size_t thread_no = 1; thread_no < threads; ++thread_no) {
+        total += per_thread[thread_no].total;
+        for (const auto& [virus_type, for_vt] : per_thread[thread_no].by_virus_type)
+            by_virus_type[virus_type] += for_vt;
+        warnings.insert(warnings.end(), per_thread[thread_no].warnings.begin(), per_thread[thread_no].warnings.end());
     }
-    catch (std::exception& err) {
-        std::cerr << "ERROR: " << err.what() << '\n';
-        return 1;
+    std::sort(warnings.begin(), warnings.end());
+    for (const auto& warning : warnings)
+        std::cerr << warning.second << '\n';
+
+    std::cout << "Total:\n" << total << '\n';
+    for (auto [virus_type, for_vt] : by_virus_type) {
+        std::cout << virus_type << ":\n" << for_vt << '\n';
     }
-}
+
+} // report_entries_of_lab
 
 // ----------------------------------------------------------------------
 /// Local Variables:
@@ -1,6 +1,4 @@
 #include <iostream>
-#include <cstdlib>
-#include <cctype>
 
 #include "acmacs-base/argc-argv.hh"
 #include "acmacs-base/stream.hh"
@@ -10,18 +8,7 @@ using namespace std::string_literals;
 
 // ----------------------------------------------------------------------
 
-constexpr const char* sUsage = "<142N> <283Q> ... [options]\n";
-
-struct PosAA
-{
-    PosAA(size_t a_pos, char a_aa) : pos(a_pos), aa(a_aa) {}
-    size_t pos;
-    char aa;
-};
-inline std::ostream& operator << (std::ostream& out, const PosAA& paa)
-{
-    return out << paa.pos << paa.aa;
-}
+constexpr const char* sUsage = "<142N> <283Q> ... [options]\n  lists strains having all the amino acids (or nucleotides with --nuc) at the aligned positions\n";
 
 int main(int argc, char* const argv[])
 {
@@ -29,6 +16,7 @@ int main(int argc, char* const argv[])
         argc_argv args(argc, argv,
                        {
                            {"--db-dir", ""},
+                           {"--nuc", false, "positions and residues are for nucleotides"},
                            {"-v", false},
                            {"--verbose", false},
                            {"-h", false},
@@ -42,22 +30,12 @@ int main(int argc, char* const argv[])
         seqdb::setup_dbs(args["--db-dir"].str(), verbose ? seqdb::report::yes : seqdb::report::no);
         const auto& seqdb = seqdb::get();
 
-        std::vector<PosAA> aa_at;
-        for (size_t arg_no = 0; arg_no < args.number_of_arguments(); ++arg_no) {
-            const std::string arg(args[arg_no]);
-            aa_at.emplace_back(std::strtoul(arg.c_str(), nullptr, 10), std::toupper(arg[arg.size() - 1]));
-        }
-        // std::cout << aa_at << '\n';
+        std::vector<seqdb::pos_residue_t> residues_at;
+        for (size_t arg_no = 0; arg_no < args.number_of_arguments(); ++arg_no)
+            residues_at.push_back(seqdb::parse_pos_residue(args[arg_no]));
 
-        for (const auto entry_seq : seqdb) {
-            try {
-                const auto aa = entry_seq.seq().amino_acids(true);
-                if (all_of(aa_at.begin(), aa_at.end(), [&aa](const auto& paa) -> bool { return aa[paa.pos - 1] == paa.aa; }))
-                    std::cout << entry_seq.make_name() << '\n';
-            }
-            catch (seqdb::SequenceNotAligned&) {
-            }
-        }
+        for (const auto& entry_seq : seqdb.find_by_residues_at(residues_at, args["--nuc"] ? seqdb::sequence_type::nucleotides : seqdb::sequence_type::amino_acids))
+            std::cout << entry_seq.make_name() << '\n';
 
         return 0;
     }
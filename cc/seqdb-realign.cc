@@ -0,0 +1,60 @@
+#include <iostream>
+
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/normalize.hh"
+#include "seqdb.hh"
+
+// ----------------------------------------------------------------------
+
+using namespace acmacs::argv;
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<str>  db_dir{*this, "db-dir"};
+    option<str>  db{*this, "db", desc{"seqdb to realign, default: seqdb.json.xz in db-dir"}};
+    option<str>  flu{*this, "flu", desc{"realign just sequences of the virus type: H1, H3, B"}};
+    option<str>  lineage{*this, "lineage", desc{"realign just sequences of the lineage"}};
+    option<str>  lab{*this, "lab", desc{"realign just sequences from the lab"}};
+    option<bool> not_aligned{*this, "not-aligned", desc{"realign just not aligned sequences, by default all sequences are aligned again"}};
+    option<str>  output{*this, 'o', "output", desc{"save to this file instead of updating seqdb"}};
+    option<bool> verbose{*this, 'v', "verbose"};
+};
+
+int main(int argc, char* const argv[])
+{
+    try {
+        Options opt(argc, argv);
+        const auto report = *opt.verbose ? seqdb::report::yes : seqdb::report::no;
+        seqdb::setup_dbs(opt.db_dir, report);
+        if (opt.db.has_value())
+            seqdb::setup(opt.db, report);
+        auto& seqdb = seqdb::get_for_updating(report_time::yes);
+
+        seqdb::SeqdbFilter filter;
+        filter.filter_subtype(acmacs::normalize_virus_type(*opt.flu))
+                .filter_lineage(acmacs::normalize_lineage(*opt.lineage))
+                .filter_lab(*opt.lab);
+          // messages are collected by the threads and printed after all of them finished
+        if (const auto messages = seqdb.realign(!opt.not_aligned, filter, seqdb::report::yes); !messages.empty())
+            std::cerr << messages << '\n';
+        if (const auto messages = seqdb.align_by_reference(seqdb::report::yes); !messages.empty())
+            std::cerr << messages << '\n';
+
+          // forced realignment drops deletions found before, clades depend on them
+        seqdb.detect_insertions_deletions();
+        seqdb.detect_b_lineage();
+        seqdb.update_clades(report);
+        seqdb.save(*opt.output, 2);
+        return 0;
+    }
+    catch (std::exception& err) {
+        std::cerr << "ERROR: " << err.what() << '\n';
+        return 1;
+    }
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
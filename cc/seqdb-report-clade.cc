@@ -19,12 +19,12 @@ struct Options : public argv
     argument<str> clade{*this, arg_name{"clade"}, mandatory};
 };
 
-struct Entry
+struct Entry   // views into seqdb
 {
-    std::string name;
-    std::string date;
-    std::string lab;
-    std::string seq_id;
+    std::string_view name;
+    std::string_view date;
+    std::string_view lab;
+    std::string_view seq_id;
 };
 
 int main(int argc, char* const argv[])
@@ -37,7 +37,7 @@ int main(int argc, char* const argv[])
             for (const auto entry_seq : seqdb::get()) {
                 if ((opt.lab->empty() || entry_seq.seq().has_lab(*opt.lab)) && (flu.empty() || entry_seq.entry().virus_type() == flu))
                     std::cout << std::setw(60) << std::left << entry_seq.make_name() << '\t' << entry_seq.seq().clades() << '\t' << entry_seq.entry().virus_type() << '\t'
-                              << entry_seq.entry().lineage() << '\t' << entry_seq.entry().dates() << '\t' << entry_seq.seq().lab() << '\n';
+                              << entry_seq.entry().lineage() << '\t' << entry_seq.entry().dates() << '\t' << entry_seq.seq().lab_view() << '\n';
             }
         }
         else {
@@ -46,7 +46,7 @@ int main(int argc, char* const argv[])
 
             for (const auto entry_seq : seqdb) {
                 if (entry_seq.seq().has_clade(*opt.clade) && (opt.lab->empty() || entry_seq.seq().has_lab(*opt.lab)) && (flu.empty() || entry_seq.entry().virus_type() == flu))
-                    seqs.push_back({entry_seq.make_name(), std::string{entry_seq.entry().date()}, std::string{entry_seq.seq().lab()}, entry_seq.seq_id(seqdb::SeqdbEntrySeq::encoded_t::yes)});
+                    seqs.push_back({seqdb.name_of(entry_seq), entry_seq.entry().date(), entry_seq.seq().lab_view(), seqdb.seq_id_of(entry_seq, seqdb::SeqdbEntrySeq::encoded_t::yes)});
             }
             if (opt.sort_by_date)
                 std::sort(std::begin(seqs), std::end(seqs), [](const auto& e1, const auto& e2) { return e1.date < e2.date; });
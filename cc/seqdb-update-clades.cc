@@ -2,6 +2,7 @@
 
 #include "acmacs-base/argc-argv.hh"
 #include "seqdb.hh"
+#include "clades.hh"
 
 using namespace std::string_literals;
 
@@ -14,6 +15,9 @@ int main(int argc, char* const argv[])
     try {
         argc_argv args(argc, argv, {
                 {"--db-dir", ""},
+                {"--db", "", "seqdb to update (default: seqdb.json.xz in --db-dir)"},
+                {"--clades", "", "clade definitions (default: $ACMACSD_ROOT/share/conf/clades.json)"},
+                {"--force", false, "recompute clades of all sequences, by default just of the sequences changed since the last update"},
                 {"-v", false},
                 {"--verbose", false},
                 {"-h", false},
@@ -24,9 +28,15 @@ int main(int argc, char* const argv[])
         }
         const bool verbose = args["-v"] || args["--verbose"];
         seqdb::setup_dbs(args["--db-dir"].str(), verbose ? seqdb::report::yes : seqdb::report::no);
+        if (const auto db = args["--db"].str(); !db.empty())
+            seqdb::setup(db, verbose ? seqdb::report::yes : seqdb::report::no);
+        seqdb::clade_definitions_setup(args["--clades"].str());
         auto& seqdb = seqdb::get_for_updating();
-        seqdb.update_clades(verbose ? seqdb::report::yes : seqdb::report::no);
-        seqdb.save(std::string{}, 2);
+          // seqdb is one compressed json, it is written again just if any sequence was recomputed
+        if (seqdb.update_clades(verbose ? seqdb::report::yes : seqdb::report::no, args["--force"]))
+            seqdb.save(std::string{}, 2);
+        else
+            std::cerr << "INFO: clades are up to date, seqdb not saved\n";
         return 0;
     }
     catch (std::exception& err) {
@@ -1,6 +1,7 @@
 #include <typeinfo>
 #include <tuple>
 #include <set>
+#include <charconv>
 
 #include "acmacs-base/acmacsd.hh"
 #include "acmacs-base/read-file.hh"
@@ -13,6 +14,8 @@
 #include "acmacs-virus/virus-name.hh"
 #include "acmacs-chart-2/chart-modify.hh"
 #include "seqdb/seqdb.hh"
+#include "seqdb/align-cache.hh"
+#include "seqdb/reference-aligner.hh"
 #include "clades.hh"
 #include "seqdb-export.hh"
 #include "seqdb-import.hh"
@@ -111,6 +114,8 @@ bool SeqdbSeq::match_update_nucleotides(const SeqdbSeq& aNewSeq)
         mNucleotidesShift = aNewSeq.mNucleotidesShift;
         mAminoAcids = aNewSeq.mAminoAcids;
         mAminoAcidsShift = aNewSeq.mAminoAcidsShift;
+        mAminoAcidsWindow = aNewSeq.mAminoAcidsWindow;
+        mIndelsMaster = aNewSeq.mIndelsMaster;
     }
     return matches;
 
@@ -133,6 +138,8 @@ bool SeqdbSeq::match_update_amino_acids(const SeqdbSeq& aNewSeq)
         mNucleotidesShift = aNewSeq.mNucleotidesShift;
         mAminoAcids = aNewSeq.mAminoAcids;
         mAminoAcidsShift = aNewSeq.mAminoAcidsShift;
+        mAminoAcidsWindow = aNewSeq.mAminoAcidsWindow;
+        mIndelsMaster = aNewSeq.mIndelsMaster;
     }
     return matches;
 
@@ -183,7 +190,10 @@ void SeqdbSeq::add_reassortant(std::string_view aReassortant)
 void SeqdbSeq::add_lab_id(std::string_view aLab, std::string_view aLabId)
 {
     if (!aLab.empty()) {
-        auto& lab_ids = mLabIds[std::string{aLab}];
+        auto found = mLabIds.find(aLab);
+        if (found == mLabIds.end())
+            found = mLabIds.emplace(aLab, std::vector<std::string>{}).first;
+        auto& lab_ids = found->second;
         if (!aLabId.empty() && std::find(lab_ids.begin(), lab_ids.end(), aLabId) == lab_ids.end()) {
             lab_ids.emplace_back(aLabId);
         }
@@ -193,6 +203,26 @@ void SeqdbSeq::add_lab_id(std::string_view aLab, std::string_view aLabId)
 
 // ----------------------------------------------------------------------
 
+void SeqdbSeq::merge_attributes(const SeqdbSeq& aSource)
+{
+    for (const auto& passage : aSource.mPassages)
+        add_passage(passage);
+    for (const auto& reassortant : aSource.mReassortant)
+        add_reassortant(reassortant);
+    for (const auto& [lab, lab_ids] : aSource.mLabIds) {
+        add_lab_id(lab, std::string_view{});
+        for (const auto& lab_id : lab_ids)
+            add_lab_id(lab, lab_id);
+    }
+    for (const auto& hi_name : aSource.mHiNames) {
+        if (!hi_name_present(hi_name))
+            add_hi_name(hi_name);
+    }
+
+} // SeqdbSeq::merge_attributes
+
+// ----------------------------------------------------------------------
+
 AlignAminoAcidsData SeqdbSeq::align(bool aForce, Messages& aMessages, std::string_view name)
 {
     AlignAminoAcidsData align_data;
@@ -208,8 +238,11 @@ AlignAminoAcidsData SeqdbSeq::align(bool aForce, Messages& aMessages, std::strin
       case no_align:
           break;
       case align_nucleotides:
+          if (aForce)           // deletions inserted by add_deletions() must not be translated to X
+              mNucleotides.erase(std::remove(mNucleotides.begin(), mNucleotides.end(), '-'), mNucleotides.end());
           mAminoAcidsShift.reset();
-          align_data = translate_and_align(mNucleotides, aMessages, name);
+          mIndelsMaster.clear(); // deletions found before are removed, detect_insertions_deletions() finds them again
+          align_data = align_cache().translate_and_align(mNucleotides, aMessages, name);
           if (!align_data.amino_acids.empty())
               mAminoAcids = align_data.amino_acids;
           if (!align_data.shift.alignment_failed()) {
@@ -224,8 +257,11 @@ AlignAminoAcidsData SeqdbSeq::align(bool aForce, Messages& aMessages, std::strin
           // }
           break;
       case aling_amino_acids:
+          if (aForce)
+              mAminoAcids.erase(std::remove(mAminoAcids.begin(), mAminoAcids.end(), '-'), mAminoAcids.end());
           mAminoAcidsShift.reset();
-          align_data = align_amino_acids(mAminoAcids, aMessages);
+          mIndelsMaster.clear();
+          align_data = align_cache().align_amino_acids(mAminoAcids, aMessages);
           if (align_data.shift.aligned()) {
               mAminoAcidsShift = align_data.shift;
               update_gene(align_data.gene, aMessages, true);
@@ -235,6 +271,7 @@ AlignAminoAcidsData SeqdbSeq::align(bool aForce, Messages& aMessages, std::strin
           }
           break;
     }
+    update_aligned_window();
 
     return align_data;
 
@@ -242,106 +279,159 @@ AlignAminoAcidsData SeqdbSeq::align(bool aForce, Messages& aMessages, std::strin
 
 // ----------------------------------------------------------------------
 
-const clades_t& SeqdbSeq::update_clades(std::string_view aVirusType, std::string_view aLineage, std::string_view aName)
+AlignAminoAcidsData SeqdbSeq::align_by_reference(const ReferenceAligner& aAligner, Messages& aMessages)
 {
-    if (aligned()) {
-        if (aVirusType == "B") {
-            if (aLineage == "YAMAGATA") {
-                mClades = clades_b_yamagata(mAminoAcids, mAminoAcidsShift, aName);
-            }
-            else if (aLineage == "VICTORIA") {
-                mClades = clades_b_victoria(mAminoAcids, mAminoAcidsShift, aName);
-            }
-        }
-        else if (aVirusType == "A(H1N1)") {
-            mClades = clades_h1pdm(mAminoAcids, mAminoAcidsShift, aName);
-        }
-        else if (aVirusType == "A(H3N2)") {
-            mClades = clades_h3n2(mAminoAcids, mAminoAcidsShift, aName);
+    const auto align_data = aAligner.align(mNucleotides, mAminoAcids);
+    if (align_data.shift.aligned()) {
+        if (!mNucleotides.empty()) {
+            mAminoAcids = align_data.amino_acids;
+            mNucleotidesShift = - align_data.offset + align_data.shift * 3;
         }
-        // else {
-        //     std::cerr << "Cannot update clades for virus type " << aVirusType << '\n';
-        // }
+        mAminoAcidsShift = align_data.shift;
+        mIndelsMaster.clear();
+        update_gene(align_data.gene, aMessages, true);
+        update_aligned_window();
     }
+    return align_data;
+
+} // SeqdbSeq::align_by_reference
+
+// ----------------------------------------------------------------------
+
+clades_update SeqdbSeq::update_clades(const CladeDefinitions& aDefinitions, std::string_view aVirusType, std::string_view aLineage, bool aForce)
+{
+    if (!aligned())
+        return clades_update::up_to_date;
+    const auto hash = aDefinitions.hash(mAminoAcids, mAminoAcidsShift, aVirusType, aLineage);
+    if (hash == mCladesHash && !aForce)
+        return clades_update::up_to_date;
+    mCladesHash = hash;
+    if (auto clades = aDefinitions.clades(mAminoAcids, mAminoAcidsShift, aVirusType, aLineage); clades.has_value() && *clades != mClades) {
+        mClades = std::move(*clades);
+        return clades_update::changed;
+    }
+    return clades_update::same;
+
+} // SeqdbSeq::update_clades
+
+// ----------------------------------------------------------------------
+
+const clades_t& SeqdbSeq::update_clades(std::string_view aVirusType, std::string_view aLineage)
+{
+    update_clades(clade_definitions(), aVirusType, aLineage, true);
     return mClades;
 
 } // SeqdbSeq::update_clades
 
 // ----------------------------------------------------------------------
 
-std::string SeqdbSeq::amino_acids(bool aAligned, size_t aLeftPartSize, size_t aResize) const
+void SeqdbSeq::clades_hash(const char* str, size_t length)
 {
-    std::string r = mAminoAcids;
-    if (aAligned) {
-        if (!aligned())
-            throw SequenceNotAligned("SeqdbSeq::amino_acids()");
-        r = shift(r, mAminoAcidsShift + static_cast<int>(aLeftPartSize), 'X');
-
-          // find the longest part not having *, replace parts before longest with X, truncate traling parts
-        size_t longest_part_start = 0;
-        size_t longest_part_len = 0;
-        for (size_t start = 0; start != std::string::npos; ) {
-            const size_t found = r.find_first_of('*', start);
-            const size_t len = (found == std::string::npos ? r.size() : found) - start;
-            if (longest_part_len < len) {
-                longest_part_len = len;
-                longest_part_start = start;
-            }
-            start = found == std::string::npos ? found : found + 1;
-        }
-        r.replace(0, longest_part_start, longest_part_start, 'X');
-        r.resize(longest_part_start + longest_part_len, 'X');
+    if (const auto [end, ec] = std::from_chars(str, str + length, mCladesHash, 16); ec != std::errc{} || end != (str + length))
+        mCladesHash = 0;        // clades are recomputed
 
-        if (aResize > 0)
-            r.resize(aResize, 'X');
-    }
-    return r;
+} // SeqdbSeq::clades_hash
+
+// ----------------------------------------------------------------------
+
+std::string SeqdbSeq::amino_acids(bool aAligned, size_t aLeftPartSize, size_t aResize) const
+{
+    if (aAligned)
+        return amino_acids_aligned(aLeftPartSize, aResize).str();
+    return mAminoAcids;
 
 } // SeqdbSeq::amino_acids
 
 // ----------------------------------------------------------------------
 
+AlignedView SeqdbSeq::amino_acids_aligned(size_t aLeftPartSize, size_t aResize) const
+{
+    if (auto result = amino_acids_aligned_opt(aLeftPartSize, aResize); result.has_value())
+        return *result;
+    throw SequenceNotAligned("SeqdbSeq::amino_acids()");
+
+} // SeqdbSeq::amino_acids_aligned
+
+// ----------------------------------------------------------------------
+
+  // parts before the longest part not having * are replaced with X, trailing parts are truncated
+std::optional<AlignedView> SeqdbSeq::amino_acids_aligned_opt(size_t aLeftPartSize, size_t aResize) const noexcept
+{
+    const auto stored_shift = mAminoAcidsShift.value_opt();
+    if (!stored_shift.has_value())
+        return std::nullopt;
+    const int aligned_shift = *stored_shift + static_cast<int>(aLeftPartSize);
+    const auto window = aLeftPartSize == 0 ? mAminoAcidsWindow : longest_stop_free_window(mAminoAcids, aligned_shift);
+    return AlignedView{mAminoAcids, aligned_shift, window, aResize > 0 ? aResize : window.end, 'X'};
+
+} // SeqdbSeq::amino_acids_aligned_opt
+
+// ----------------------------------------------------------------------
+
 // aPos counts from 1!
 char SeqdbSeq::amino_acid_at(size_t aPos, bool ignore_errors) const
 {
-    try {
-    if (!aligned())
+    if (const auto aa = amino_acid_at_opt(aPos); aa.has_value())
+        return *aa;
+    else if (ignore_errors)
+        return '?';
+    else if (!aligned())
         throw SequenceNotAligned("SeqdbSeq::amino_acid_at()");
-    const int offset = static_cast<int>(aPos) - 1 - mAminoAcidsShift;
-    if (offset < 0 || offset >= static_cast<int>(mAminoAcids.size()))
+    else
         throw std::runtime_error("SeqdbSeq::amino_acid_at(): Invalid pos");
-    return mAminoAcids[static_cast<size_t>(offset)];
-    }
-    catch (std::exception& err) {
-        if (ignore_errors) {
-            std::cerr << "WARNING: " << err.what() << '\n';
-            return '?';
-        }
-        else {
-            throw;
-        }
-    }
 
 } // SeqdbSeq::amino_acid_at
 
 // ----------------------------------------------------------------------
 
+// aPos counts from 1!
+std::optional<char> SeqdbSeq::amino_acid_at_opt(size_t aPos) const noexcept
+{
+    const auto stored_shift = mAminoAcidsShift.value_opt();
+    if (!stored_shift.has_value())
+        return std::nullopt;
+    const auto offset = static_cast<std::ptrdiff_t>(aPos) - 1 - *stored_shift;
+    if (offset < 0 || offset >= static_cast<std::ptrdiff_t>(mAminoAcids.size()))
+        return std::nullopt;
+    return mAminoAcids[static_cast<size_t>(offset)];
+
+} // SeqdbSeq::amino_acid_at_opt
+
+// ----------------------------------------------------------------------
+
 std::string SeqdbSeq::nucleotides(bool aAligned, size_t aLeftPartSize, size_t aResize) const
 {
-    std::string r = mNucleotides;
-    if (aAligned) {
-        if (!aligned())
-            throw SequenceNotAligned("nucleotides()");
-        r = shift(r, mNucleotidesShift + static_cast<int>(aLeftPartSize), '-');
-        if (aResize > 0)
-            r.resize(aResize, '-');
-    }
-    return r;
+    if (aAligned)
+        return nucleotides_aligned(aLeftPartSize, aResize).str();
+    return mNucleotides;
 
 } // SeqdbSeq::nucleotides
 
 // ----------------------------------------------------------------------
 
+AlignedView SeqdbSeq::nucleotides_aligned(size_t aLeftPartSize, size_t aResize) const
+{
+    if (auto result = nucleotides_aligned_opt(aLeftPartSize, aResize); result.has_value())
+        return *result;
+    throw SequenceNotAligned("nucleotides()");
+
+} // SeqdbSeq::nucleotides_aligned
+
+// ----------------------------------------------------------------------
+
+std::optional<AlignedView> SeqdbSeq::nucleotides_aligned_opt(size_t aLeftPartSize, size_t aResize) const noexcept
+{
+    const auto stored_shift = mNucleotidesShift.value_opt();
+    if (!aligned() || !stored_shift.has_value())
+        return std::nullopt;
+    const int aligned_shift = *stored_shift + static_cast<int>(aLeftPartSize);
+    const aligned_window_t window{0, static_cast<size_t>(std::max(0, static_cast<int>(mNucleotides.size()) + aligned_shift))};
+    return AlignedView{mNucleotides, aligned_shift, window, aResize > 0 ? aResize : window.end, '-'};
+
+} // SeqdbSeq::nucleotides_aligned_opt
+
+// ----------------------------------------------------------------------
+
 std::vector<std::string> SeqdbSeq::make_all_reassortant_passage_variants() const
 {
     std::vector<std::string> result;
@@ -366,6 +456,7 @@ void SeqdbSeq::add_deletions(size_t amino_acid_pos, size_t num_amino_acid_deleti
     mAminoAcids.insert(aa_offset, num_amino_acid_deletions, '-');
     const size_t nuc_offset = static_cast<size_t>(static_cast<int>(amino_acid_pos * 3) - nucleotides_shift());
     mNucleotides.insert(nuc_offset, num_amino_acid_deletions * 3, '-');
+    update_aligned_window();
 
 } // SeqdbSeq::add_deletions
 
@@ -427,6 +518,27 @@ void SeqdbEntry::update_subtype_name(std::string_view aSubtype, Messages& aMessa
 
 // ----------------------------------------------------------------------
 
+void SeqdbEntry::merge(SeqdbEntry&& aSource, Messages& aMessages)
+{
+    update_subtype_name(aSource.mVirusType, aMessages);
+    update_lineage(aSource.mLineage, aMessages);
+    for (const auto& date : aSource.mDates)
+        add_date(date);
+    if (mCountry.empty()) {
+        mCountry = std::move(aSource.mCountry);
+        mContinent = std::move(aSource.mContinent);
+    }
+    for (auto& source_seq : aSource.mSeq) {
+        if (auto found = std::find_if(mSeq.begin(), mSeq.end(), [&source_seq](SeqdbSeq& seq) { return seq.match_update(source_seq); }); found != mSeq.end())
+            found->merge_attributes(source_seq);
+        else
+            mSeq.push_back(std::move(source_seq));
+    }
+
+} // SeqdbEntry::merge
+
+// ----------------------------------------------------------------------
+
 const SeqdbSeq* SeqdbEntry::find_by_hi_name(std::string_view aHiName) const
 {
     auto found = std::find_if(begin_seq(), end_seq(), [aHiName](const auto& seq) -> bool { return seq.hi_name_present(aHiName); });
@@ -499,6 +611,7 @@ std::string Seqdb::add_sequence(std::string_view aName, std::string_view aVirusT
                                 std::string_view aReassortant, std::string_view aSequence, std::string_view aGene)
 {
     Messages messages;
+    reset_indexes();
     virus_name::Name name_fields(aName);
     name_fields.fix_extra();
     try {
@@ -586,6 +699,7 @@ void Seqdb::report_not_aligned_after_adding() const
 std::string Seqdb::cleanup(bool remove_short_sequences)
 {
     Messages messages;
+    reset_indexes();
     if (remove_short_sequences) {
         size_t num_short_sequences = 0;
         std::for_each(mEntries.begin(), mEntries.end(), [&num_short_sequences](auto& entry) { if (entry.remove_short_sequences()) ++num_short_sequences; });
@@ -616,34 +730,7 @@ std::string Seqdb::cleanup(bool remove_short_sequences)
 
 std::string Seqdb::report() const
 {
-    std::ostringstream os;
-    os << "Entries: " << mEntries.size() << '\n';
-
-    std::map<std::string_view, size_t> virus_types;
-    for_each(mEntries.begin(), mEntries.end(), [&virus_types](auto& e) { ++virus_types[e.virus_type()]; });
-    os << "Virus types: " << virus_types << '\n';
-
-    std::map<std::string_view, size_t> lineages;
-    for_each(mEntries.begin(), mEntries.end(), [&lineages](auto& e) { ++lineages[e.lineage()]; });
-    os << "Lineages: " << lineages << '\n';
-
-    std::map<std::string_view, size_t> aligned;
-    for_each(mEntries.begin(), mEntries.end(), [&aligned](auto& e) { if (any_of(e.mSeq.begin(), e.mSeq.end(), std::mem_fn(&SeqdbSeq::aligned))) ++aligned[e.virus_type()]; });
-    os << "Aligned: " << aligned << '\n';
-
-    std::map<std::string_view, size_t> matched;
-    for_each(mEntries.begin(), mEntries.end(), [&matched](auto& e) { if (any_of(e.mSeq.begin(), e.mSeq.end(), std::mem_fn(&SeqdbSeq::matched))) ++matched[e.virus_type()]; });
-    os << "Matched: " << matched << '\n';
-
-    std::map<std::string_view, size_t> have_dates;
-    for_each(mEntries.begin(), mEntries.end(), [&have_dates](auto& e) { if (!e.mDates.empty()) ++have_dates[e.virus_type()]; });
-    os << "Have dates: " << have_dates << '\n';
-
-    std::map<std::string_view, size_t> have_clades;
-    for_each(mEntries.begin(), mEntries.end(), [&have_clades](auto& e) { if (any_of(e.mSeq.begin(), e.mSeq.end(), [](auto& seq) { return !seq.mClades.empty(); })) ++have_clades[e.virus_type()]; });
-    os << "Have clades: " << have_clades << '\n';
-
-    return os.str();
+    return summary().report();
 
 } // Seqdb::report
 
@@ -653,12 +740,12 @@ std::string Seqdb::report_identical() const
 {
     std::ostringstream os;
 
-    auto report = [&os](std::string_view prefix, const auto& groups) {
+    auto report = [this, &os](std::string_view prefix, const auto& groups) {
         if (!groups.empty()) {
             os << prefix << '\n';
             for (auto const& group: groups) {
                 for (auto const& entry: group) {
-                    os << entry.make_name() << ' ';
+                    os << name_of(entry) << ' ';
                 }
                 os << '\n';
             }
@@ -666,7 +753,7 @@ std::string Seqdb::report_identical() const
     };
 
     try {
-        report("Identical nucleotides:", find_identical_sequences([](const SeqdbEntrySeq& e) -> std::string { try { return e.seq().nucleotides(true); } catch (SequenceNotAligned&) { return std::string(); } }));
+        report("Identical nucleotides:", find_identical_sequences([](const SeqdbEntrySeq& e) { return e.seq().nucleotides_aligned_opt().value_or(AlignedView{}); }));
         os << '\n';
     }
     catch (std::exception& err) {
@@ -674,7 +761,7 @@ std::string Seqdb::report_identical() const
     }
 
     try {
-        report("Identical amino-acids:", find_identical_sequences([](const SeqdbEntrySeq& e) -> std::string { try { return e.seq().amino_acids(true); } catch (SequenceNotAligned&) { return std::string(); } }));
+        report("Identical amino-acids:", find_identical_sequences([](const SeqdbEntrySeq& e) { return e.seq().amino_acids_aligned_opt().value_or(AlignedView{}); }));
         os << '\n';
     }
     catch (std::exception& err) {
@@ -692,7 +779,7 @@ std::string Seqdb::report_not_aligned(size_t prefix_size) const
     std::vector<SeqdbEntrySeq> not_aligned;
     std::copy_if(begin(), end(), std::back_inserter(not_aligned), [](const auto& e) -> bool { return !e.seq().aligned(); });
     std::vector<std::string> prefixes;
-    std::transform(not_aligned.begin(), not_aligned.end(), std::back_inserter(prefixes), [&prefix_size](const auto& e) -> std::string { return std::string(e.seq().amino_acids(false), 0, prefix_size); });
+    std::transform(not_aligned.begin(), not_aligned.end(), std::back_inserter(prefixes), [&prefix_size](const auto& e) -> std::string { return std::string{e.seq().amino_acids_view().substr(0, prefix_size)}; });
     std::sort(prefixes.begin(), prefixes.end());
     const auto p_end = std::unique(prefixes.begin(), prefixes.end());
 
@@ -726,6 +813,7 @@ std::vector<std::string> Seqdb::all_hi_names() const
 
 void Seqdb::remove_hi_names()
 {
+    reset_indexes();
     for (auto& entry: mEntries) {
         for (auto& seq: entry.mSeq) {
             seq.hi_names().clear();
@@ -876,6 +964,7 @@ SeqdbEntrySeq Seqdb::find_by_seq_id(std::string_view aSeqId, ignore_not_found ig
 
 void Seqdb::build_hi_name_index()
 {
+    reset_indexes();
     mHiNameIndex.clear();
     for (auto entry_seq: *this) {
         for (const auto& hi_name: entry_seq.seq().hi_names()) {
@@ -890,6 +979,144 @@ void Seqdb::build_hi_name_index()
 
 // ----------------------------------------------------------------------
 
+const NameTrigramIndex& Seqdb::name_index() const
+{
+    if (!mNameIndex)
+        mNameIndex = std::make_unique<NameTrigramIndex>(*this);
+    return *mNameIndex;
+
+} // Seqdb::name_index
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<const seq_refs_t> Seqdb::name_regex_candidates(std::string_view aNameRegex) const
+{
+    if (auto candidates = name_index().candidates_for_regex(aNameRegex); candidates.has_value())
+        return std::make_shared<const seq_refs_t>(std::move(*candidates));
+    return {};
+
+} // Seqdb::name_regex_candidates
+
+// ----------------------------------------------------------------------
+
+std::vector<SeqdbEntrySeq> Seqdb::find_by_name_substring(std::string_view aSubstring) const
+{
+    const auto found = name_index().find_substring(aSubstring);
+    std::vector<SeqdbEntrySeq> result(found.size());
+    std::transform(found.begin(), found.end(), result.begin(), [this](const auto& ref) { return SeqdbEntrySeq(mEntries[ref.first], mEntries[ref.first].seqs()[ref.second]); });
+    return result;
+
+} // Seqdb::find_by_name_substring
+
+// ----------------------------------------------------------------------
+
+const PositionIndex& Seqdb::position_index() const
+{
+    if (!mPositionIndex)
+        mPositionIndex = std::make_unique<PositionIndex>(*this);
+    return *mPositionIndex;
+
+} // Seqdb::position_index
+
+// ----------------------------------------------------------------------
+
+std::vector<SeqdbEntrySeq> Seqdb::find_by_residues_at(const std::vector<pos_residue_t>& aTerms, sequence_type aType) const
+{
+    const auto found = position_index().find(aTerms, aType);
+    std::vector<SeqdbEntrySeq> result(found.size());
+    std::transform(found.begin(), found.end(), result.begin(), [this](const auto& ref) { return SeqdbEntrySeq(mEntries[ref.first], mEntries[ref.first].seqs()[ref.second]); });
+    return result;
+
+} // Seqdb::find_by_residues_at
+
+// ----------------------------------------------------------------------
+
+const SeqdbStatistics& Seqdb::statistics() const
+{
+    if (!mStatistics)
+        mStatistics = std::make_unique<SeqdbStatistics>(*this);
+    return *mStatistics;
+
+} // Seqdb::statistics
+
+// ----------------------------------------------------------------------
+
+const SeqNames& Seqdb::seq_names() const
+{
+    if (!mSeqNames)
+        mSeqNames = std::make_unique<SeqNames>(*this);
+    return *mSeqNames;
+
+} // Seqdb::seq_names
+
+// ----------------------------------------------------------------------
+
+const AttributeIndex& Seqdb::attribute_index() const
+{
+    if (!mAttributeIndex)
+        mAttributeIndex = std::make_unique<AttributeIndex>(*this);
+    return *mAttributeIndex;
+
+} // Seqdb::attribute_index
+
+// ----------------------------------------------------------------------
+
+const SeqdbSummary& Seqdb::summary() const
+{
+    if (!mSummary)
+        mSummary = std::make_unique<SeqdbSummary>(*this);
+    return *mSummary;
+
+} // Seqdb::summary
+
+// ----------------------------------------------------------------------
+
+std::pair<std::vector<SeqdbEntry>::const_iterator, std::vector<SeqdbEntry>::const_iterator> Seqdb::find_by_name_prefix(std::string_view aPrefix) const
+{
+      // entries are sorted by name, names starting with aPrefix follow the first name not less than aPrefix
+    const auto first = find_insertion_place(aPrefix);
+    const auto last = std::lower_bound(first, mEntries.end(), aPrefix, [](const SeqdbEntry& entry, std::string_view prefix) -> bool { return entry.name().compare(0, prefix.size(), prefix) == 0; });
+    return {first, last};
+
+} // Seqdb::find_by_name_prefix
+
+// ----------------------------------------------------------------------
+
+void Seqdb::shared_scan(std::vector<std::pair<SeqdbFilter, seq_visitor_t>> aQueries) const
+{
+    for (auto& query : aQueries)
+        query.first.prepare(*this);
+
+    std::vector<const std::pair<SeqdbFilter, seq_visitor_t>*> entry_queries; // queries whose filter accepted the current entry
+    entry_queries.reserve(aQueries.size());
+    for (size_t entry_no = 0; entry_no < mEntries.size(); ++entry_no) {
+        const auto& entry = mEntries[entry_no];
+        entry_queries.clear();
+        for (const auto& query : aQueries) {
+            if (query.first.suitable_entry(entry))
+                entry_queries.push_back(&query);
+        }
+        if (!entry_queries.empty()) {
+            for (size_t seq_no = 0; seq_no < entry.mSeq.size(); ++seq_no) {
+                const auto& seq = entry.mSeq[seq_no];
+                const SeqdbEntrySeq entry_seq(entry, seq);
+                for (const auto* query : entry_queries) {
+                    if (query->first.suitable_seq(entry, seq, entry_no, seq_no))
+                        query->second(entry_seq);
+                }
+            }
+        }
+    }
+
+    for (const auto& query : aQueries) {
+        if (query.first.report_plan())
+            std::cerr << query.first.plan()->report();
+    }
+
+} // Seqdb::shared_scan
+
+// ----------------------------------------------------------------------
+
 size_t Seqdb::match(const acmacs::chart::Antigens& aAntigens, std::vector<SeqdbEntrySeq>& aPerAntigen, std::string_view aChartVirusType, seqdb::report aReport) const
 {
     size_t matched = 0;
@@ -981,7 +1208,7 @@ void Seqdb::aa_at_positions_for_antigens(const acmacs::chart::Antigens& aAntigen
             entry = find_hi_name((*ag)->full_name_for_seqdb_matching());
         if (entry) {
             std::string aa(aPositions.size(), 'X');
-            std::transform(aPositions.begin(), aPositions.end(), aa.begin(), [&entry](size_t pos) { return entry->seq().amino_acid_at(pos, true); });
+            std::transform(aPositions.begin(), aPositions.end(), aa.begin(), [&entry](size_t pos) { return entry->seq().amino_acid_at_opt(pos).value_or('?'); });
             aa_indices[aa].push_back(ag.index());
             ++matched;
         }
@@ -995,6 +1222,7 @@ void Seqdb::aa_at_positions_for_antigens(const acmacs::chart::Antigens& aAntigen
 
 void Seqdb::load(std::string_view filename)
 {
+    reset_indexes();
     seqdb_import(filename, *this);
     mLoadedFromFilename = filename;
 
@@ -1031,15 +1259,26 @@ std::set<std::string> Seqdb::virus_types() const
 
 // ----------------------------------------------------------------------
 
-void Seqdb::detect_insertions_deletions()
+void Seqdb::detect_insertions_deletions(bool aForce, size_t aThreads)
 {
     std::cerr << "========== Deletions/insertions ==========\n";
+    reset_indexes();
+    if (aForce)
+        mIndelMasters.clear();
+    std::vector<InsertionsDeletionsDetector> detectors;
     for (std::string_view virus_type: virus_types()) {
         if (!virus_type.empty()) {
-            std::cout << "Detect insertions/deletions for " << virus_type << '\n';
-            InsertionsDeletionsDetector detector(*this, virus_type);
-            detector.detect();
+            const auto master = mIndelMasters.find(virus_type);
+            detectors.emplace_back(*this, virus_type, master != mIndelMasters.end() ? std::string_view{master->second} : std::string_view{});
         }
+    }
+      // virus types are processed one by one, each detector aligns its entries on aThreads threads
+      // (virus types are few and of very different sizes, running them concurrently too would just oversubscribe cores)
+    for (auto& detector : detectors) {
+        const auto report = detector.detect(aThreads);
+        std::cout << "Detect insertions/deletions for " << detector.mVirusType << '\n' << report;
+        if (!detector.mMaster.empty())
+            mIndelMasters[detector.mVirusType] = detector.mMaster;
     }
     std::cerr << "========== Deletions/insertions done ==========\n";
 
@@ -1047,23 +1286,214 @@ void Seqdb::detect_insertions_deletions()
 
 // ----------------------------------------------------------------------
 
-void Seqdb::update_clades(seqdb::report aReport)
+  // one line per virus type: virus type, space, master
+std::string Seqdb::indel_masters_to_string() const
 {
-    std::cerr << "========== Clades ==========\n";
-    std::map<std::string, size_t> clade_count;
-    for (auto entry_seq: *this) {
-        const auto& clades = entry_seq.seq().update_clades(entry_seq.entry().virus_type(), entry_seq.entry().lineage(), entry_seq.make_name());
-        for (const auto& clade: clades)
-            ++clade_count[clade];
+    std::string result;
+    for (const auto& [virus_type, master] : mIndelMasters)
+        result.append(virus_type).append(1, ' ').append(master).append(1, '\n');
+    return result;
+
+} // Seqdb::indel_masters_to_string
+
+// ----------------------------------------------------------------------
+
+void Seqdb::indel_masters_from_string(std::string_view aSource)
+{
+    mIndelMasters.clear();
+    for (const auto& line : acmacs::string::split(aSource, "\n")) {
+        if (const auto space = line.find(' '); space != std::string_view::npos && space > 0)
+            mIndelMasters.emplace(line.substr(0, space), line.substr(space + 1));
+        else
+            throw std::runtime_error("Invalid indel master line in seqdb: \"" + std::string{line} + "\"");
     }
+
+} // Seqdb::indel_masters_from_string
+
+// ----------------------------------------------------------------------
+
+size_t Seqdb::update_clades(seqdb::report aReport, bool aForce)
+{
+    std::cerr << "========== Clades ==========\n";
+    struct counts_t
+    {
+        size_t recomputed = 0, changed = 0;
+        std::map<std::string, size_t> clades;
+    };
+    const auto& definitions = clade_definitions(); // loaded before threads start
+      // each seq is updated by exactly one thread
+    const auto counts = parallel_reduce(
+        SeqdbFilter{}, counts_t{},
+        [&definitions, aForce](counts_t& count, SeqdbEntrySeq entry_seq) {
+            auto& seq = entry_seq.seq();
+            switch (seq.update_clades(definitions, entry_seq.entry().virus_type(), entry_seq.entry().lineage(), aForce)) {
+              case clades_update::changed:
+                  ++count.changed;
+                  [[fallthrough]];
+              case clades_update::same:
+                  ++count.recomputed;
+                  break;
+              case clades_update::up_to_date:
+                  break;
+            }
+            for (const auto& clade : seq.clades())
+                ++count.clades[clade];
+        },
+        [](counts_t& target, counts_t&& source) {
+            target.recomputed += source.recomputed;
+            target.changed += source.changed;
+            for (const auto& [clade, count] : source.clades)
+                target.clades[clade] += count;
+        });
+    if (counts.changed)
+        reset_indexes();        // clade statistics changed
+    std::cerr << "INFO: clades recomputed for " << counts.recomputed << " sequences, changed for " << counts.changed << '\n';
     if (aReport == report::yes)
-        std::cerr << "INFO: clades: " << clade_count << '\n';
+        std::cerr << "INFO: clades: " << counts.clades << '\n';
     std::cerr << "========== Clades done ==========\n";
+    return counts.recomputed;
 
 } // Seqdb::update_clades
 
 // ----------------------------------------------------------------------
 
+std::string Seqdb::realign(bool aForce, const SeqdbFilter& aFilter, seqdb::report aReport)
+{
+    return align_sequences(
+        "Realign", aFilter,
+        [aForce](SeqdbSeq& seq, Messages& messages, std::string_view name) -> std::optional<AlignAminoAcidsData> {
+            if (!aForce && seq.aligned())
+                return std::nullopt;
+              // not aligned sequence may have amino acids translated before, SeqdbSeq::align() skips it unless forced
+            return seq.align(true, messages, name);
+        },
+        aReport);
+
+} // Seqdb::realign
+
+// ----------------------------------------------------------------------
+
+std::string Seqdb::align_by_reference(seqdb::report aReport)
+{
+    const ReferenceAligner aligner(*this);
+    if (aReport == report::yes)
+        std::cerr << "INFO: reference proteins: " << aligner.number_of_references() << '\n';
+    const auto messages = align_sequences(
+        "Align by reference", SeqdbFilter{},
+        [&aligner](SeqdbSeq& seq, Messages& seq_messages, std::string_view /*name*/) -> std::optional<AlignAminoAcidsData> {
+            if (seq.aligned())
+                return std::nullopt;
+            return seq.align_by_reference(aligner, seq_messages);
+        },
+        aReport);
+
+      // keep in not_aligned_ just sequences that are still not aligned
+    std::set<std::string_view> still_not_aligned;
+    for (const auto& entry : mEntries) {
+        for (const auto& seq : entry.seqs()) {
+            if (!seq.aligned())
+                still_not_aligned.insert(seq.nucleotides_view().empty() ? seq.amino_acids_view() : seq.nucleotides_view());
+        }
+    }
+    not_aligned_.erase(std::remove_if(not_aligned_.begin(), not_aligned_.end(),
+                                      [&still_not_aligned](const auto& en) { return still_not_aligned.count(std::get<2>(en).empty() ? std::get<3>(en) : std::get<2>(en)) == 0; }),
+                       not_aligned_.end());
+    return messages;
+
+} // Seqdb::align_by_reference
+
+// ----------------------------------------------------------------------
+
+std::string Seqdb::align_sequences(std::string_view aTitle, const SeqdbFilter& aFilter, const seq_aligner_t& aAlign, seqdb::report aReport)
+{
+    struct aligned_t
+    {
+        seq_ref_t ref;
+        bool aligned_before;
+        bool aligned;
+        std::string subtype;
+        std::string lineage;
+        std::string messages;
+
+        bool operator<(const aligned_t& aNother) const { return ref < aNother.ref; }
+    };
+    using aligned_list_t = std::vector<aligned_t>;
+
+    std::cerr << "========== " << aTitle << " ==========\n";
+    seq_names();                // built before threads start, names are used for messages
+      // each seq is updated by exactly one thread, entries are updated below
+    auto aligned = parallel_reduce(
+        aFilter, aligned_list_t{},
+        [this, &aAlign](aligned_list_t& list, SeqdbEntrySeq entry_seq) {
+            Messages messages;
+            auto& seq = entry_seq.seq();
+            const bool aligned_before = seq.aligned();
+            if (const auto align_data = aAlign(seq, messages, name_of(entry_seq)); align_data.has_value())
+                list.push_back({seq_ref(entry_seq), aligned_before, seq.aligned(), align_data->subtype, align_data->lineage, messages});
+        },
+        [](aligned_list_t& target, aligned_list_t&& source) { std::move(source.begin(), source.end(), std::back_inserter(target)); });
+    std::sort(aligned.begin(), aligned.end());
+
+    Messages messages;
+    size_t newly_aligned = 0, not_aligned = 0, no_longer_aligned = 0;
+    std::vector<size_t> renamed; // entry indexes, sorted
+    for (const auto& seq_data : aligned) {
+        auto& entry = mEntries[seq_data.ref.first];
+        if (!seq_data.messages.empty())
+            messages.warning() << seq_names().name(seq_data.ref.first, seq_data.ref.second) << ": " << seq_data.messages << '\n';
+        if (seq_data.aligned) {
+            const std::string name_before{entry.name()};
+            entry.update_subtype_name(seq_data.subtype, messages); // may update entry.mName
+            entry.update_lineage(seq_data.lineage, messages);
+            if (entry.name() != name_before && (renamed.empty() || renamed.back() != seq_data.ref.first))
+                renamed.push_back(seq_data.ref.first);
+            if (!seq_data.aligned_before)
+                ++newly_aligned;
+        }
+        else {
+            ++not_aligned;
+            if (seq_data.aligned_before)
+                ++no_longer_aligned;
+        }
+    }
+    if (!renamed.empty()) {
+          // renamed entries (e.g. A/ -> A(H3N2)/) are put to their places again, if seqdb already has an entry
+          // with the new name, they are merged the same way add_sequence() does
+        std::vector<SeqdbEntry> kept, renamed_entries;
+        kept.reserve(mEntries.size() - renamed.size());
+        for (size_t entry_no = 0, renamed_no = 0; entry_no < mEntries.size(); ++entry_no) {
+            if (renamed_no < renamed.size() && renamed[renamed_no] == entry_no) {
+                renamed_entries.push_back(std::move(mEntries[entry_no]));
+                ++renamed_no;
+            }
+            else
+                kept.push_back(std::move(mEntries[entry_no]));
+        }
+        mEntries = std::move(kept);
+        for (auto& entry : renamed_entries) {
+            if (auto place = find_insertion_place(entry.name()); place != mEntries.end() && place->name() == entry.name()) {
+                messages.warning() << entry.name() << ": renamed entry merged into the existing one" << '\n';
+                place->merge(std::move(entry), messages);
+            }
+            else
+                mEntries.insert(place, std::move(entry));
+        }
+    }
+    reset_indexes();            // shifts, genes and perhaps names changed
+
+    if (aReport == report::yes) {
+        std::cerr << "INFO: processed: " << aligned.size() << " sequences, newly aligned: " << newly_aligned << ", not aligned: " << not_aligned;
+        if (no_longer_aligned)
+            std::cerr << " (were aligned before: " << no_longer_aligned << ')';
+        std::cerr << '\n';
+    }
+    std::cerr << "========== " << aTitle << " done ==========\n";
+    return messages;
+
+} // Seqdb::align_sequences
+
+// ----------------------------------------------------------------------
+
 void Seqdb::detect_b_lineage()
 {
     BLineageDetector detector(*this);
@@ -1123,10 +1553,10 @@ std::string seqdb::sequences_of_chart_for_ace_view_1(acmacs::chart::Chart& chart
     for (auto [ag_no, entry_seq] : acmacs::enumerate(matches)) {
         if (entry_seq) {
             try {
-                const auto sequence = entry_seq.seq().amino_acids(true);
-                json_antigens = to_json::v1::object_append(json_antigens, ag_no, sequence);
-                for (auto [pos, aa] : acmacs::enumerate(sequence))
-                    ++stat_per_pos[pos+1].aa_count[aa];
+                const auto sequence = entry_seq.seq().amino_acids_aligned();
+                json_antigens = to_json::v1::object_append(json_antigens, ag_no, sequence.str());
+                for (size_t pos = 0; pos < sequence.size(); ++pos)
+                    ++stat_per_pos[pos+1].aa_count[sequence[pos]];
             }
             catch (seqdb::SequenceNotAligned& err) {
                 std::cerr << "WARNING: " << err.what() << ' ' << entry_seq.entry().name() << '\n';
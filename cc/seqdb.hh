@@ -11,13 +11,24 @@
 #include <vector>
 #include <numeric>
 #include <tuple>
+#include <memory>
+#include <type_traits>
+#include <optional>
 
 #include "acmacs-base/stream.hh"
 #include "acmacs-base/name-encode.hh"
 #include "hidb-5/hidb.hh"
 #include "seqdb/sequence-shift.hh"
+#include "seqdb/aligned-view.hh"
 #include "seqdb/amino-acids.hh"
 #include "seqdb/messages.hh"
+#include "seqdb/name-index.hh"
+#include "seqdb/position-index.hh"
+#include "seqdb/filter-plan.hh"
+#include "seqdb/group-by.hh"
+#include "seqdb/summary.hh"
+#include "seqdb/seq-names.hh"
+#include "seqdb/thread-pool.hh"
 
 // ----------------------------------------------------------------------
 
@@ -27,6 +38,8 @@ namespace seqdb
 {
     class Seqdb;
     class SeqdbIterator;
+    class ReferenceAligner;
+    class CladeDefinitions;
 
     enum class report { no, yes };
 
@@ -34,6 +47,7 @@ namespace seqdb
 
     using clade_t = std::string;
     using clades_t = std::vector<clade_t>;
+    enum class clades_update { up_to_date, same, changed }; // result of SeqdbSeq::update_clades
 
 // ----------------------------------------------------------------------
 
@@ -59,7 +73,7 @@ namespace seqdb
     class SeqdbSeq
     {
      public:
-        using LabIds = std::map<std::string, std::vector<std::string>>;
+        using LabIds = std::map<std::string, std::vector<std::string>, std::less<>>;
 
         SeqdbSeq() : mGene("HA") {}
 
@@ -72,6 +86,7 @@ namespace seqdb
                     mAminoAcids = aSequence;
                 if (!aGene.empty())
                     mGene = aGene;
+                update_aligned_window();
             }
 
         // SeqdbSeq(bool aNucs, std::string_view aSequence, std::string_view aGene)
@@ -100,6 +115,8 @@ namespace seqdb
         //     }
 
         AlignAminoAcidsData align(bool aForce, Messages& aMessages, std::string_view name);
+          // for not aligned sequence, fallback when no ALIGN_RAW_DATA signature matched, see reference-aligner.hh
+        AlignAminoAcidsData align_by_reference(const ReferenceAligner& aAligner, Messages& aMessages);
 
           // returns if aNucleotides matches mNucleotides or aAminoAcids matches mAminoAcids
         bool match_update(const SeqdbSeq& aNewSeq);
@@ -109,25 +126,39 @@ namespace seqdb
         void update_gene(std::string_view aGene, Messages& aMessages, bool replace_ha = false);
         void add_reassortant(std::string_view aReassortant);
         void add_lab_id(std::string_view aLab, std::string_view aLabId);
-        const clades_t& update_clades(std::string_view aVirusType, std::string_view aLineage, std::string_view aName);
+          // adds passages, reassortants, lab ids and hi names of aSource missing here, used when merging entries
+        void merge_attributes(const SeqdbSeq& aSource);
+          // Recomputes clades of aligned sequence if its clades_hash() differs from aDefinitions.hash(), i.e. tested residues,
+          // shift, virus type, lineage or definitions changed since the last update, or aForce. Clades are not changed
+          // if there are no definitions for aVirusType and aLineage. Returns if recomputed clades differ from the previous ones.
+        clades_update update_clades(const CladeDefinitions& aDefinitions, std::string_view aVirusType, std::string_view aLineage, bool aForce = false);
+        const clades_t& update_clades(std::string_view aVirusType, std::string_view aLineage); // uses clade_definitions(), always recomputes
         const clades_t& clades() const { return mClades; }
         clades_t& clades() { return mClades; }
         bool has_clade(std::string_view aClade) const { return std::find(std::begin(mClades), std::end(mClades), aClade) != std::end(mClades); }
+          // hash of the master sequence insertions/deletions were detected against (see InsertionsDeletionsDetector::master_hash),
+          // empty if not detected yet or the sequence was aligned again since
+        std::string_view indels_master() const { return mIndelsMaster; }
+        void indels_master(std::string_view aHash) { mIndelsMaster = aHash; }
+        void indels_master(const char* str, size_t length) { mIndelsMaster.assign(str, length); }
+          // see CladeDefinitions::hash(), 0 if clades were not updated yet, stored in the file as hex
+        uint64_t clades_hash() const { return mCladesHash; }
+        void clades_hash(const char* str, size_t length); // hex, 0 if cannot be parsed
 
         bool is_short() const { return mAminoAcids.empty() ? mNucleotides.size() < (MINIMUM_SEQUENCE_AA_LENGTH * 3) : mAminoAcids.size() < MINIMUM_SEQUENCE_AA_LENGTH; }
         bool translated() const { return !mAminoAcids.empty(); }
         bool aligned() const { return mAminoAcidsShift.aligned(); }
         bool matched() const { return !mHiNames.empty(); }
 
-        bool has_lab(std::string_view aLab) const { return mLabIds.find(std::string(aLab)) != mLabIds.end(); }
+        bool has_lab(std::string_view aLab) const { return mLabIds.find(aLab) != mLabIds.end(); }
         std::string lab() const { return mLabIds.empty() ? std::string{} : mLabIds.begin()->first; }
         std::string lab_id() const { return mLabIds.empty() ? std::string{} : (mLabIds.begin()->second.empty() ? std::string{} : mLabIds.begin()->second[0]); }
-        const clades_t cdcids() const { auto i = mLabIds.find("CDC"); return i == mLabIds.end() ? clades_t{} : i->second; }
-        const std::vector<std::string> lab_ids_for_lab(std::string_view lab) const { auto i = mLabIds.find(std::string{lab}); return i == mLabIds.end() ? std::vector<std::string>{} : i->second; }
+        const clades_t cdcids() const { return cdcids_ref(); }
+        const std::vector<std::string> lab_ids_for_lab(std::string_view lab) const { return lab_ids_for_lab_ref(lab); }
         const std::vector<std::string> lab_ids() const { std::vector<std::string> r; for (const auto& lid: mLabIds) { for (const auto& id: lid.second) { r.emplace_back(lid.first + "#" + id); } } return r; }
         const LabIds& lab_ids_raw() const { return mLabIds; }
         LabIds& lab_ids_raw() { return mLabIds; }
-        bool match_labid(std::string_view lab, std::string_view id) const { auto i = mLabIds.find(std::string{lab}); return i != mLabIds.end() && std::find(i->second.begin(), i->second.end(), id) != i->second.end(); }
+        bool match_labid(std::string_view lab, std::string_view id) const { const auto& ids = lab_ids_for_lab_ref(lab); return std::find(ids.begin(), ids.end(), id) != ids.end(); }
         const auto& passages() const { return mPassages; }
         auto& passages() { return mPassages; }
         std::string passage() const { return mPassages.empty() ? std::string{} : mPassages[0]; }
@@ -139,6 +170,14 @@ namespace seqdb
         std::string gene() const { return mGene; }
         void gene(const char* str, size_t length) { mGene.assign(str, length); }
 
+          // the same as gene(), lab(), cdcids() etc. above without copying, valid while the sequence is not modified
+        std::string_view gene_view() const { return mGene; }
+        std::string_view lab_view() const { return mLabIds.empty() ? std::string_view{} : std::string_view{mLabIds.begin()->first}; }
+        std::string_view lab_id_view() const { return (mLabIds.empty() || mLabIds.begin()->second.empty()) ? std::string_view{} : std::string_view{mLabIds.begin()->second[0]}; }
+        std::string_view passage_view() const { return mPassages.empty() ? std::string_view{} : std::string_view{mPassages[0]}; }
+        const std::vector<std::string>& lab_ids_for_lab_ref(std::string_view lab) const { static const std::vector<std::string> empty; const auto found = mLabIds.find(lab); return found == mLabIds.end() ? empty : found->second; }
+        const std::vector<std::string>& cdcids_ref() const { return lab_ids_for_lab_ref("CDC"); }
+
         const std::vector<std::string>& hi_names() const { return mHiNames; }
         std::vector<std::string>& hi_names() { return mHiNames; }
         void add_hi_name(std::string_view aHiName) { mHiNames.emplace_back(aHiName); }
@@ -148,15 +187,22 @@ namespace seqdb
           // if aResize != 0, resize result by either truncating or appending X or -
         std::string amino_acids(bool aAligned, size_t aLeftPartSize = 0, size_t aResize = 0) const;
         std::string nucleotides(bool aAligned, size_t aLeftPartSize = 0, size_t aResize = 0) const;
+          // the same without copying, throw SequenceNotAligned, see AlignedView for lifetime
+        AlignedView amino_acids_aligned(size_t aLeftPartSize = 0, size_t aResize = 0) const;
+        AlignedView nucleotides_aligned(size_t aLeftPartSize = 0, size_t aResize = 0) const;
+          // non-throwing variants for passes over the whole seqdb, nullopt if sequence was not aligned
+        std::optional<AlignedView> amino_acids_aligned_opt(size_t aLeftPartSize = 0, size_t aResize = 0) const noexcept;
+        std::optional<AlignedView> nucleotides_aligned_opt(size_t aLeftPartSize = 0, size_t aResize = 0) const noexcept;
         Shift amino_acids_shift() const { return mAminoAcidsShift; } // throws if sequence was not aligned
         Shift nucleotides_shift() const { return mNucleotidesShift; }  // throws if sequence was not aligned
         // int& amino_acids_shift_raw() { return mAminoAcidsShift.raw(); }
         // int& nucleotides_shift_raw() { return mNucleotidesShift.raw(); }
-        void amino_acids_shift_raw(int shift) { mAminoAcidsShift.raw() = shift; }
+        void amino_acids_shift_raw(int shift) { mAminoAcidsShift.raw() = shift; update_aligned_window(); }
         void nucleotides_shift_raw(int shift) { mNucleotidesShift.raw() = shift; }
-        char amino_acid_at(size_t aPos, bool ignore_errors = false) const; // aPos counts from 1!
+        char amino_acid_at(size_t aPos, bool ignore_errors = false) const; // aPos counts from 1! if ignore_errors, returns '?' for not aligned sequence and invalid aPos
+        std::optional<char> amino_acid_at_opt(size_t aPos) const noexcept; // aPos counts from 1! nullopt for not aligned sequence and invalid aPos
 
-        void amino_acids(const char* str, size_t length) { mAminoAcids.assign(str, length); }
+        void amino_acids(const char* str, size_t length) { mAminoAcids.assign(str, length); update_aligned_window(); }
         void nucleotides(const char* str, size_t length) { mNucleotides.assign(str, length); }
         void annotations(const char* str, size_t length) { mAnnotations.assign(str, length); }
 
@@ -172,8 +218,10 @@ namespace seqdb
           //     }
 
         std::string amino_acids_raw() const { return mAminoAcids; }
+        std::string_view amino_acids_view() const { return mAminoAcids; } // not aligned, without copying
         size_t amino_acids_size() const { return mAminoAcids.size(); }
         std::string nucleotides_raw() const { return mNucleotides; }
+        std::string_view nucleotides_view() const { return mNucleotides; } // not aligned, without copying
         size_t nucleotides_size() const { return mNucleotides.size(); }
 
         auto& gisaid() { return mGisaid; }
@@ -190,7 +238,12 @@ namespace seqdb
         std::string mAnnotations;
         std::vector<std::string> mReassortant;
         clades_t mClades;
+        std::string mIndelsMaster;
+        uint64_t mCladesHash = 0;
         GisaidData mGisaid;
+        aligned_window_t mAminoAcidsWindow; // stop codon free part of aligned amino acids, updated whenever mAminoAcids or mAminoAcidsShift changes
+
+        void update_aligned_window() { mAminoAcidsWindow = aligned() ? longest_stop_free_window(mAminoAcids, mAminoAcidsShift) : aligned_window_t{}; }
 
         static inline std::string shift(std::string_view aSource, int aShift, char aFill)
             {
@@ -205,6 +258,9 @@ namespace seqdb
         friend class Seqdb;
         friend class SeqdbIterator;
         friend class SeqdbIteratorBase;
+        friend class SeqdbFilter;
+        friend class FilterPlan;
+        friend class SeqdbStatistics;
 
     }; // class SeqdbSeq
 
@@ -239,6 +295,8 @@ namespace seqdb
         void lineage(const char* str, size_t length) { mLineage.assign(str, length); }
         void update_lineage(std::string_view aLineage, Messages& aMessages);
         void update_subtype_name(std::string_view aSubtype, Messages& aMessages);
+          // moves sequences of aSource having the same name here, matching sequences are updated as Seqdb::add_sequence() does
+        void merge(SeqdbEntry&& aSource, Messages& aMessages);
           // returns warning message or an empty string
           // std::string add_or_update_sequence(std::string_view aSequence, std::string_view aPassage, std::string_view aReassortant, std::string_view aLab, std::string_view aLabId, std::string_view aGene);
 
@@ -279,7 +337,7 @@ namespace seqdb
         std::vector<std::string> cdcids() const
             {
                 std::vector<std::string> r;
-                std::for_each(mSeq.begin(), mSeq.end(), [&r](auto const & seq) {auto seq_cdcids = seq.cdcids(); r.insert(r.end(), std::make_move_iterator(seq_cdcids.begin()), std::make_move_iterator(seq_cdcids.end())); });
+                std::for_each(mSeq.begin(), mSeq.end(), [&r](auto const & seq) { const auto& seq_cdcids = seq.cdcids_ref(); r.insert(r.end(), seq_cdcids.begin(), seq_cdcids.end()); });
                 std::sort(r.begin(), r.end());
                 r.erase(std::unique(r.begin(), r.end()), r.end());
                 return r;
@@ -331,6 +389,9 @@ namespace seqdb
         friend class SeqdbIteratorBase;
         friend class SeqdbIterator;
         friend class ConstSeqdbIterator;
+        friend class SeqdbFilter;
+        friend class FilterPlan;
+        friend class SeqdbStatistics;
 
     }; // class SeqdbEntry
 
@@ -364,14 +425,14 @@ namespace seqdb
 
         std::string make_name(std::string_view aPassageSeparator = " ") const
             {
-                return mEntry && mSeq ? (mSeq->hi_names().empty() ? string::strip(fmt::format("{}{}{}", mEntry->name(), aPassageSeparator, mSeq->passage())) : mSeq->hi_names()[0]) : "*NOT-FOUND*";
+                return mEntry && mSeq ? (mSeq->hi_names().empty() ? string::strip(fmt::format("{}{}{}", mEntry->name(), aPassageSeparator, mSeq->passage_view())) : mSeq->hi_names()[0]) : "*NOT-FOUND*";
             }
 
         enum class encoded_t { no, yes };
           // seq_id is concatenation of sequence name and passage separeted by __
         std::string seq_id(encoded_t encoded) const
             {
-                std::string r = (mEntry && mSeq) ? string::strip(fmt::format("{}__{}", mEntry->name(), mSeq->passage())) : "*NOT-FOUND*";
+                std::string r = (mEntry && mSeq) ? string::strip(fmt::format("{}__{}", mEntry->name(), mSeq->passage_view())) : "*NOT-FOUND*";
                 if (encoded == encoded_t::yes)
                     r = name_encode(r);
                 return r;
@@ -385,116 +446,160 @@ namespace seqdb
 
 // ----------------------------------------------------------------------
 
-    class SeqdbIteratorBase : public std::iterator<std::input_iterator_tag, SeqdbEntrySeq>
+      // Conditions on entries and sequences used by SeqdbIterator and Seqdb::shared_scan
+    class SeqdbFilter
     {
      public:
-        SeqdbIteratorBase(const SeqdbIteratorBase&) = default;
-        SeqdbIteratorBase(SeqdbIteratorBase&&) = default;
-        virtual ~SeqdbIteratorBase() = default;
-
-        virtual bool operator==(const SeqdbIteratorBase& aNother) const { return mEntryNo == aNother.mEntryNo && mSeqNo == aNother.mSeqNo; }
-        virtual bool operator!=(const SeqdbIteratorBase& aNother) const { return ! operator==(aNother); }
-
-        SeqdbIteratorBase& filter_lab(std::string_view aLab) { mLab = aLab; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_labid(std::string_view aLab, std::string_view aId) { mLabId.first = aLab; mLabId.second =aId; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_subtype(std::string_view aSubtype) { mSubtype = aSubtype; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_lineage(std::string_view aLineage) { mLineage = aLineage; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_continent(std::string_view aContinent) { mContinent = aContinent; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_country(std::string_view aCountry) { mCountry = aCountry; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_aligned(bool aAligned) { mAligned = aAligned; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_gene(std::string_view aGene) { mGene = aGene; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_clade(std::string_view aClade) { mClade = aClade; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_date_range(std::string_view aBegin, std::string_view aEnd) { mBegin = aBegin; mEnd = aEnd; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_hi_name(bool aHasHiName) { mHasHiName = aHasHiName; filter_added(); return *this; }
-        SeqdbIteratorBase& filter_name_regex(std::string_view aNameRegex) { mNameMatcher.assign(std::string{aNameRegex}, std::regex::icase); mNameMatcherSet = true; filter_added(); return *this; }
-
-        virtual const Seqdb& seqdb() const = 0;
-        virtual std::string make_name(std::string_view aPassageSeparator = " ") const = 0;
-
-        SeqdbIteratorBase& operator ++ ();
-
-        void validate() const;
-
-     protected:
-        SeqdbIteratorBase() : mNameMatcherSet(false) { end(); }
-        SeqdbIteratorBase(size_t aEntryNo, size_t aSeqNo) : mEntryNo(aEntryNo), mSeqNo(aSeqNo), mAligned(false), mHasHiName(false), mNameMatcherSet(false) /*, mNameMatcher(".")*/ {}
+        SeqdbFilter& filter_lab(std::string_view aLab) { mLab = aLab; return changed(); }
+        SeqdbFilter& filter_labid(std::string_view aLab, std::string_view aId) { mLabId.first = aLab; mLabId.second = aId; return changed(); }
+        SeqdbFilter& filter_subtype(std::string_view aSubtype) { mSubtype = aSubtype; return changed(); }
+        SeqdbFilter& filter_lineage(std::string_view aLineage) { mLineage = aLineage; return changed(); }
+        SeqdbFilter& filter_continent(std::string_view aContinent) { mContinent = aContinent; return changed(); }
+        SeqdbFilter& filter_country(std::string_view aCountry) { mCountry = aCountry; return changed(); }
+        SeqdbFilter& filter_aligned(bool aAligned) { mAligned = aAligned; return changed(); }
+        SeqdbFilter& filter_gene(std::string_view aGene) { mGene = aGene; return changed(); }
+        SeqdbFilter& filter_clade(std::string_view aClade) { mClade = aClade; return changed(); }
+        SeqdbFilter& filter_date_range(std::string_view aBegin, std::string_view aEnd) { mBegin = aBegin; mEnd = aEnd; return changed(); }
+        SeqdbFilter& filter_hi_name(bool aHasHiName) { mHasHiName = aHasHiName; return changed(); }
+        SeqdbFilter& filter_name_regex(std::string_view aNameRegex)
+            {
+                mNameRegex = aNameRegex;
+                mNameMatcher = std::make_shared<const std::regex>(mNameRegex, std::regex::icase);
+                mNameCandidates.reset();
+                mNameCandidatesStale = true;
+                return changed();
+            }
+          // report filter plan and predicate timings to stderr when iteration is over
+        SeqdbFilter& report_plan(bool aReportPlan) { mReportPlan = aReportPlan; return changed(); }
 
-        bool suitable_entry() const;
-        bool suitable_seq() const;
-        bool next_seq();
-        void next_entry();
+          // Looks up name regex candidates in the name index of aSeqdb and compiles filter plan
+          // using seqdb statistics. Not prepared filter is usable but evaluates predicates in the fixed order.
+          // Predicate timings are collected only if report_plan is on and aCollectTimings is true.
+        void prepare(const Seqdb& aSeqdb, bool aCollectTimings = true);
+        const FilterPlan* plan() const { return mPlan.get(); }
+        bool report_plan() const { return mReportPlan && mPlan; }
 
-        size_t entry_no() const { return mEntryNo; }
-        size_t seq_no() const { return mSeqNo; }
+        bool suitable_entry(const SeqdbEntry& aEntry) const;
+        bool suitable_seq(const SeqdbEntry& aEntry, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const;
+          // moves aEntryNo forward to the nearest entry that may match name regex, returns false if there is no such entry
+        bool name_candidate_entry(size_t& aEntryNo, size_t aNumberOfEntries) const;
 
      private:
-        size_t mEntryNo;
-        size_t mSeqNo;
-
-          // filter
         std::string mLab;
         std::string mSubtype;
         std::string mLineage;
         std::string mContinent;
         std::string mCountry;
-        bool mAligned;
+        bool mAligned = false;
         std::string mGene;
         std::string mClade;
         std::string mBegin;
         std::string mEnd;
-        bool mHasHiName;
-        bool mNameMatcherSet;
-        std::regex mNameMatcher;
+        bool mHasHiName = false;
+        std::string mNameRegex;
+        std::shared_ptr<const std::regex> mNameMatcher; // null if name regex filter is not set
+        std::shared_ptr<const seq_refs_t> mNameCandidates; // sequences that may match mNameMatcher, null if name index cannot be used for the regex
+        bool mNameCandidatesStale = false;
         std::pair<std::string, std::string> mLabId;
+        bool mReportPlan = false;
+        std::shared_ptr<const FilterPlan> mPlan;
 
-        void end() { mEntryNo = mSeqNo = std::numeric_limits<size_t>::max(); }
-        void filter_added() { if (!suitable_entry() || !suitable_seq()) operator ++(); }
+        SeqdbFilter& changed() { mPlan.reset(); return *this; }
 
-    }; // class SeqdbIteratorBase
+        friend class FilterPlan;
+
+    }; // class SeqdbFilter
 
 // ----------------------------------------------------------------------
 
-    class SeqdbIterator : public SeqdbIteratorBase
+      // Iterator over sequences of seqdb with optional filtering. Copying is cheap: cursor and
+      // a pointer to the immutable filter shared between copies. Calling filter_* creates a new
+      // filter for this iterator (copies are not affected). End iterator has no filter.
+    class SeqdbIteratorBase
     {
      public:
-        SeqdbIterator(const SeqdbIterator&) = default;
-        SeqdbIterator(SeqdbIterator&&) = default;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = SeqdbEntrySeq;
+        using difference_type = std::ptrdiff_t;
+        using pointer = SeqdbEntrySeq*;
+        using reference = SeqdbEntrySeq;
+
+        bool operator==(const SeqdbIteratorBase& aNother) const { return mEntryNo == aNother.mEntryNo && mSeqNo == aNother.mSeqNo && mSeqdb == aNother.mSeqdb; }
+        bool operator!=(const SeqdbIteratorBase& aNother) const { return ! operator==(aNother); }
+        bool at_end() const { return mEntryNo == sEnd; }
+
+        SeqdbIteratorBase& filter_lab(std::string_view aLab) { return modify_filter([aLab](SeqdbFilter& filter) { filter.filter_lab(aLab); }); }
+        SeqdbIteratorBase& filter_labid(std::string_view aLab, std::string_view aId) { return modify_filter([aLab, aId](SeqdbFilter& filter) { filter.filter_labid(aLab, aId); }); }
+        SeqdbIteratorBase& filter_subtype(std::string_view aSubtype) { return modify_filter([aSubtype](SeqdbFilter& filter) { filter.filter_subtype(aSubtype); }); }
+        SeqdbIteratorBase& filter_lineage(std::string_view aLineage) { return modify_filter([aLineage](SeqdbFilter& filter) { filter.filter_lineage(aLineage); }); }
+        SeqdbIteratorBase& filter_continent(std::string_view aContinent) { return modify_filter([aContinent](SeqdbFilter& filter) { filter.filter_continent(aContinent); }); }
+        SeqdbIteratorBase& filter_country(std::string_view aCountry) { return modify_filter([aCountry](SeqdbFilter& filter) { filter.filter_country(aCountry); }); }
+        SeqdbIteratorBase& filter_aligned(bool aAligned) { return modify_filter([aAligned](SeqdbFilter& filter) { filter.filter_aligned(aAligned); }); }
+        SeqdbIteratorBase& filter_gene(std::string_view aGene) { return modify_filter([aGene](SeqdbFilter& filter) { filter.filter_gene(aGene); }); }
+        SeqdbIteratorBase& filter_clade(std::string_view aClade) { return modify_filter([aClade](SeqdbFilter& filter) { filter.filter_clade(aClade); }); }
+        SeqdbIteratorBase& filter_date_range(std::string_view aBegin, std::string_view aEnd) { return modify_filter([aBegin, aEnd](SeqdbFilter& filter) { filter.filter_date_range(aBegin, aEnd); }); }
+        SeqdbIteratorBase& filter_hi_name(bool aHasHiName) { return modify_filter([aHasHiName](SeqdbFilter& filter) { filter.filter_hi_name(aHasHiName); }); }
+        SeqdbIteratorBase& filter_name_regex(std::string_view aNameRegex) { return modify_filter([aNameRegex](SeqdbFilter& filter) { filter.filter_name_regex(aNameRegex); }); }
+        SeqdbIteratorBase& filter(const SeqdbFilter& aFilter) { return modify_filter([&aFilter](SeqdbFilter& filter) { filter = aFilter; }); }
+        SeqdbIteratorBase& report_plan(bool aReportPlan) { return modify_filter([aReportPlan](SeqdbFilter& filter) { filter.report_plan(aReportPlan); }); }
+
+        const Seqdb& seqdb() const { return *mSeqdb; }
+        std::string make_name(std::string_view aPassageSeparator = " ") const { return entry_seq().make_name(aPassageSeparator); }
 
-        bool operator==(const SeqdbIterator& aNother) const { return &mSeqdb == &aNother.mSeqdb && SeqdbIteratorBase::operator==(aNother); }
+        SeqdbIteratorBase& operator ++ ();
 
-        SeqdbEntrySeq operator*();
+        void validate() const;
 
-        virtual const Seqdb& seqdb() const { return mSeqdb; }
-        virtual std::string make_name(std::string_view aPassageSeparator = " ") const { return const_cast<SeqdbIterator*>(this)->operator*().make_name(aPassageSeparator); }
+     protected:
+        SeqdbIteratorBase(const Seqdb& aSeqdb) : mSeqdb(&aSeqdb), mEntryNo(sEnd), mSeqNo(sEnd) {}
+        SeqdbIteratorBase(const Seqdb& aSeqdb, size_t aEntryNo, size_t aSeqNo) : mSeqdb(&aSeqdb), mEntryNo(aEntryNo), mSeqNo(aSeqNo) { settle(); }
+
+        SeqdbEntrySeq entry_seq() const;
 
      private:
-        SeqdbIterator(Seqdb& aSeqdb) : SeqdbIteratorBase(), mSeqdb(aSeqdb) {}
-        SeqdbIterator(Seqdb& aSeqdb, size_t aEntryNo, size_t aSeqNo) : SeqdbIteratorBase(aEntryNo, aSeqNo), mSeqdb(aSeqdb) {}
+        static constexpr const size_t sEnd = std::numeric_limits<size_t>::max();
 
-        Seqdb& mSeqdb;
+        const Seqdb* mSeqdb;
+        size_t mEntryNo;
+        size_t mSeqNo;
+        std::shared_ptr<const SeqdbFilter> mFilter; // null if no filtering
 
-        friend class Seqdb;
+        bool valid() const;
+        bool suitable_entry() const { return !mFilter || mFilter->suitable_entry(entry()); }
+        bool suitable_seq() const { return !mFilter || mFilter->suitable_seq(entry(), entry().mSeq[mSeqNo], mEntryNo, mSeqNo); }
+        bool next_seq();
+        void next_entry();
+        void settle();
+        const SeqdbEntry& entry() const;
 
-    }; // class SeqdbIterator
+        void end() { mEntryNo = mSeqNo = sEnd; }
+        template <typename Modifier> SeqdbIteratorBase& modify_filter(Modifier aModifier);
 
-    class ConstSeqdbIterator : public SeqdbIteratorBase
+    }; // class SeqdbIteratorBase
+
+// ----------------------------------------------------------------------
+
+    class SeqdbIterator : public SeqdbIteratorBase
     {
      public:
-        ConstSeqdbIterator(const ConstSeqdbIterator&) = default;
-        ConstSeqdbIterator(ConstSeqdbIterator&&) = default;
+        SeqdbEntrySeq operator*() const { return entry_seq(); }
 
-        bool operator==(const ConstSeqdbIterator& aNother) const { return &mSeqdb == &aNother.mSeqdb && SeqdbIteratorBase::operator==(aNother); }
+     private:
+        SeqdbIterator(Seqdb& aSeqdb) : SeqdbIteratorBase(aSeqdb) {}
+        SeqdbIterator(Seqdb& aSeqdb, size_t aEntryNo, size_t aSeqNo) : SeqdbIteratorBase(aSeqdb, aEntryNo, aSeqNo) {}
 
-        const SeqdbEntrySeq operator*() const;
+        friend class Seqdb;
 
-        virtual const Seqdb& seqdb() const { return mSeqdb; }
-        virtual std::string make_name(std::string_view aPassageSeparator = " ") const { return operator*().make_name(aPassageSeparator); }
+    }; // class SeqdbIterator
 
-     private:
-        ConstSeqdbIterator(const Seqdb& aSeqdb) : SeqdbIteratorBase(), mSeqdb(aSeqdb) {}
-        ConstSeqdbIterator(const Seqdb& aSeqdb, size_t aEntryNo, size_t aSeqNo) : SeqdbIteratorBase(aEntryNo, aSeqNo), mSeqdb(aSeqdb) {}
+    class ConstSeqdbIterator : public SeqdbIteratorBase
+    {
+     public:
+        const SeqdbEntrySeq operator*() const { return entry_seq(); }
 
-        const Seqdb& mSeqdb;
+     private:
+        ConstSeqdbIterator(const Seqdb& aSeqdb) : SeqdbIteratorBase(aSeqdb) {}
+        ConstSeqdbIterator(const Seqdb& aSeqdb, size_t aEntryNo, size_t aSeqNo) : SeqdbIteratorBase(aSeqdb, aEntryNo, aSeqNo) {}
 
         friend class Seqdb;
 
@@ -529,6 +634,9 @@ namespace seqdb
                 return (first != mEntries.end() && aName == first->name()) ? &(*first) : nullptr;
             }
 
+          // range of entries whose names start with aPrefix, e.g. "A(H3N2)/TEXAS/"
+        std::pair<std::vector<SeqdbEntry>::const_iterator, std::vector<SeqdbEntry>::const_iterator> find_by_name_prefix(std::string_view aPrefix) const;
+
         enum class ignore_not_found { no, yes };
         SeqdbEntrySeq find_by_seq_id(std::string_view aSeqId, ignore_not_found ignore = ignore_not_found::no) const;
 
@@ -538,9 +646,31 @@ namespace seqdb
 
           // fills by_virus_type that maps virus type to the list of indices of mEntries
         std::set<std::string> virus_types() const;
-        void detect_insertions_deletions();
+          // Detects insertions/deletions in the sequences not checked against the current master of their virus type yet
+          // (see SeqdbSeq::indels_master()). Master is chosen when virus type is seen for the first time and kept in seqdb,
+          // so updating loaded seqdb checks just added and realigned sequences and the ones not matching the profile before.
+          // aForce: choose masters again, check all sequences.
+          // aThreads: threads to align entries of a virus type on (0 - the number of hardware threads), result does not depend on it.
+        void detect_insertions_deletions(bool aForce = false, size_t aThreads = 0);
+          // virus type -> master sequence (aligned amino acids), stored in the "  indel-masters" field of the file
+        const auto& indel_masters() const { return mIndelMasters; }
+        std::string indel_masters_to_string() const; // used by seqdb-export.cc
+        void indel_masters_from_string(std::string_view aSource); // used by seqdb-import.cc
         void detect_b_lineage();
-        void update_clades(report aReport);
+          // Recomputes clades of the sequences having stale clades_hash() (all sequences if aForce),
+          // returns the number of sequences recomputed, i.e. seqdb has to be saved if not 0
+        size_t update_clades(report aReport, bool aForce = false);
+          // Aligns not aligned sequences passing aFilter again on several threads (aForce: aligned sequences too, see SeqdbSeq::align),
+          // e.g. after adding signatures to ALIGN_RAW_DATA. Subtypes and lineages found are applied to entries after all
+          // threads finished, in the order of sequences, so the result does not depend on scheduling. Forced realignment
+          // removes deletions found before (- in nucleotides, in amino acids if there are no nucleotides) and aligns
+          // the sequence as it was added, detect_insertions_deletions() and update_clades() must be called afterwards.
+          // Returns messages in the order of sequences, messages of the aligner are collected there too.
+        std::string realign(bool aForce, const SeqdbFilter& aFilter = SeqdbFilter{}, enum report aReport = report::yes);
+          // Aligns sequences left not aligned by signatures against reference proteins taken from the aligned
+          // sequences of seqdb (see reference-aligner.hh) on several threads. Must be called after adding
+          // sequences and before cleanup() removes not aligned ones. Returns messages in the order of sequences.
+        std::string align_by_reference(enum report aReport = report::yes);
 
           // removes short sequences, removes entries having no sequences. returns messages
         std::string cleanup(bool remove_short_sequences);
@@ -566,7 +696,50 @@ namespace seqdb
 
         template <typename Value> std::deque<std::vector<SeqdbEntrySeq>> find_identical_sequences(Value value) const;
 
+          // Single pass over all sequences, for each query calls its visitor with every sequence passing its filter.
+          // Visitors are called in the order of sequences in seqdb, for a sequence in the order of queries.
+        using seq_visitor_t = std::function<void (const SeqdbEntrySeq&)>;
+        void shared_scan(std::vector<std::pair<SeqdbFilter, seq_visitor_t>> aQueries) const;
+
+          // Calls aFn(SeqdbEntrySeq) for every sequence passing aFilter from several threads (see parallel_for in thread-pool.hh),
+          // aFn must be safe to call concurrently for different sequences, order of calls is unspecified.
+        template <typename Fn> void parallel_for_each(const SeqdbFilter& aFilter, Fn aFn) const;
+          // Every thread accumulates sequences passing aFilter into its own copy of aInit using aMap(T& accumulator, SeqdbEntrySeq),
+          // then thread accumulators are merged using aCombine(T& target, T&& source). aInit must be neutral for aCombine
+          // (e.g. 0 or empty container), aCombine must not depend on the order of sequences.
+        template <typename T, typename Map, typename Combine> T parallel_reduce(const SeqdbFilter& aFilter, T aInit, Map aMap, Combine aCombine) const;
+
         void build_hi_name_index();
+
+          // trigram index over sequence names, built on demand
+          // reset_indexes() must be called after modifying entries directly (methods of Seqdb do it themselves)
+        const NameTrigramIndex& name_index() const;
+        std::shared_ptr<const seq_refs_t> name_regex_candidates(std::string_view aNameRegex) const;
+        std::vector<SeqdbEntrySeq> find_by_name_substring(std::string_view aSubstring) const;
+          // (aligned position, residue) index, built on demand
+        const PositionIndex& position_index() const;
+          // sequences having all the residues at the aligned positions
+        std::vector<SeqdbEntrySeq> find_by_residues_at(const std::vector<pos_residue_t>& aTerms, sequence_type aType = sequence_type::amino_acids) const;
+          // value frequencies used by filter plans, collected on demand
+        const SeqdbStatistics& statistics() const;
+          // interned attributes used by group_by, built on demand
+        const AttributeIndex& attribute_index() const;
+          // aggregates of the loaded file header (if file had them and seqdb was not modified) or computed on demand
+        const SeqdbSummary& summary() const;
+        void summary_from_header(std::string_view aSource) { if (SeqdbSummary::current_version(aSource)) mSummary = std::make_unique<SeqdbSummary>(SeqdbSummary::from_string(aSource)); } // seqdb-import.cc
+          // display names and seq_ids of all sequences, built on demand
+        const SeqNames& seq_names() const;
+          // precomputed make_name() and seq_id() of a sequence of this seqdb
+        std::string_view name_of(const SeqdbEntrySeq& aEntrySeq) const { const auto [entry_no, seq_no] = seq_ref(aEntrySeq); return seq_names().name(entry_no, seq_no); }
+        std::string_view seq_id_of(const SeqdbEntrySeq& aEntrySeq, SeqdbEntrySeq::encoded_t aEncoded) const
+            {
+                const auto [entry_no, seq_no] = seq_ref(aEntrySeq);
+                return aEncoded == SeqdbEntrySeq::encoded_t::yes ? seq_names().seq_id_encoded(entry_no, seq_no) : seq_names().seq_id(entry_no, seq_no);
+            }
+        void reset_indexes() { mNameIndex.reset(); mPositionIndex.reset(); mStatistics.reset(); mAttributeIndex.reset(); mSummary.reset(); mSeqNames.reset(); }
+
+          // counts of entries and sequences passing aFilter grouped by the keys, all groupings are made in one pass
+        std::vector<GroupByTable> group_by(const std::vector<group_keys_t>& aGroupings, const SeqdbFilter& aFilter = SeqdbFilter{}) const { return seqdb::group_by(*this, aGroupings, aFilter); }
         const SeqdbEntrySeq* find_hi_name(std::string_view aHiName) const noexcept { if (const auto it = mHiNameIndex.find(aHiName); it != mHiNameIndex.end()) return &it->second; else return nullptr; }
 
           // Matches antigens of a chart against seqdb, returns number of antigens matched.
@@ -592,9 +765,18 @@ namespace seqdb
         std::vector<SeqdbEntry> mEntries;
         const std::regex sReYearSpace = std::regex("/[12][0-9][0-9][0-9] ");
         HiNameIndex mHiNameIndex;
+        mutable std::unique_ptr<NameTrigramIndex> mNameIndex;
+        mutable std::unique_ptr<PositionIndex> mPositionIndex;
+        mutable std::unique_ptr<SeqdbStatistics> mStatistics;
+        mutable std::unique_ptr<AttributeIndex> mAttributeIndex;
+        mutable std::unique_ptr<SeqdbSummary> mSummary;
+        mutable std::unique_ptr<SeqNames> mSeqNames;
         std::string mLoadedFromFilename;
+        std::map<std::string, std::string, std::less<>> mIndelMasters;
         std::vector<std::tuple<std::string,std::string,std::string,std::string>> not_aligned_; // virus_type, name, raw nuc sequence, raw aa sequence (perhaps empty)
 
+        seq_ref_t seq_ref(const SeqdbEntrySeq& aEntrySeq) const { return {static_cast<size_t>(&aEntrySeq.entry() - mEntries.data()), static_cast<size_t>(&aEntrySeq.seq() - aEntrySeq.entry().seqs().data())}; }
+
         std::vector<SeqdbEntry>::iterator find_insertion_place(std::string_view aName)
             {
                 return std::lower_bound(mEntries.begin(), mEntries.end(), aName, [](const SeqdbEntry& entry, std::string_view name) -> bool { return entry.name() < name; });
@@ -611,6 +793,12 @@ namespace seqdb
 
           // throws LocationNotFound
         void find_in_hidb_update_country_lineage_date(hidb::AntigenPList& found, SeqdbEntry& entry) const;
+          // aFn(thread_no, SeqdbEntrySeq), returns number of threads used
+        template <typename Fn> size_t parallel_scan(const SeqdbFilter& aFilter, Fn aFn) const;
+          // aligns sequences passing aFilter on several threads using aligner (returns nullopt if sequence was skipped),
+          // applies subtypes and lineages found to entries in the order of sequences, returns messages
+        using seq_aligner_t = std::function<std::optional<AlignAminoAcidsData> (SeqdbSeq&, Messages&, std::string_view)>;
+        std::string align_sequences(std::string_view aTitle, const SeqdbFilter& aFilter, const seq_aligner_t& aAlign, enum report aReport);
         // void split_by_virus_type(std::map<std::string, std::vector<size_t>>& by_virus_type) const;
 
     }; // class Seqdb
@@ -622,87 +810,147 @@ namespace seqdb
         if (mEntryNo >= seqdb().mEntries.size() || mSeqNo >= seqdb().mEntries[mEntryNo].mSeq.size())
             throw std::out_of_range("SeqdbIterator is out of range");
 
-    } // SeqdbIteratorBase::valid
+    } // SeqdbIteratorBase::validate
 
 // ----------------------------------------------------------------------
 
-    inline SeqdbEntrySeq SeqdbIterator::operator*()
+    inline void SeqdbFilter::prepare(const Seqdb& aSeqdb, bool aCollectTimings)
     {
-        validate();
-        return SeqdbEntrySeq(mSeqdb.mEntries[entry_no()], mSeqdb.mEntries[entry_no()].mSeq[seq_no()]);
+        if (mNameMatcher && mNameCandidatesStale) {
+            mNameCandidates = aSeqdb.name_regex_candidates(mNameRegex);
+            mNameCandidatesStale = false;
+        }
+        if (mNameMatcher)
+            aSeqdb.seq_names(); // built here, not concurrently by the threads evaluating the plan
+        mPlan = std::make_shared<const FilterPlan>(*this, aSeqdb, mReportPlan && aCollectTimings);
 
-    } // SeqdbIterator::operator*
+    } // SeqdbFilter::prepare
 
 // ----------------------------------------------------------------------
 
-    inline const SeqdbEntrySeq ConstSeqdbIterator::operator*() const
+    inline bool SeqdbFilter::suitable_entry(const SeqdbEntry& aEntry) const
     {
-        validate();
-        return SeqdbEntrySeq(mSeqdb.mEntries[entry_no()], mSeqdb.mEntries[entry_no()].mSeq[seq_no()]);
+        if (mPlan)
+            return mPlan->suitable_entry(aEntry);
+        return (mSubtype.empty() || aEntry.mVirusType == mSubtype)
+                && (mLineage.empty() || aEntry.mLineage == mLineage)
+                && (mContinent.empty() || aEntry.mContinent == mContinent)
+                && (mCountry.empty() || aEntry.mCountry == mCountry)
+                && aEntry.date_within_range(mBegin, mEnd)
+                ;
 
-    } // SeqdbIterator::operator*
+    } // SeqdbFilter::suitable_entry
 
 // ----------------------------------------------------------------------
 
-// inline SeqdbIterator::ConstDereferenceType SeqdbIterator::operator*() const
-// {
-//     if (mEntryNo >= mSeqdb.mEntries.size() || mSeqNo >= mSeqdb.mEntries[mEntryNo].mSeq.size())
-//         throw std::out_of_range("SeqdbIterator is out of range");
-//     return std::make_pair(&mSeqdb.mEntries[mEntryNo], &mSeqdb.mEntries[mEntryNo].mSeq[mSeqNo]);
+    inline bool SeqdbFilter::suitable_seq(const SeqdbEntry& aEntry, const SeqdbSeq& aSeq, size_t aEntryNo, size_t aSeqNo) const
+    {
+        if (mPlan)
+            return mPlan->suitable_seq(aEntry, aSeq, aEntryNo, aSeqNo);
+        return (!mAligned || aSeq.aligned())
+                && (mGene.empty() || aSeq.mGene == mGene)
+                && (!mHasHiName || !aSeq.mHiNames.empty())
+                && (mLab.empty() || aSeq.has_lab(mLab))
+                && (mLabId.first.empty() || aSeq.match_labid(mLabId.first, mLabId.second))
+                && (mClade.empty() || aSeq.has_clade(mClade))
+                && (!mNameMatcher || ((!mNameCandidates || std::binary_search(mNameCandidates->begin(), mNameCandidates->end(), seq_ref_t{aEntryNo, aSeqNo}))
+                                      && std::regex_search(SeqdbEntrySeq(aEntry, aSeq).make_name(), *mNameMatcher)))
+                ;
 
-// } // SeqdbIterator::operator*
+    } // SeqdbFilter::suitable_seq
 
 // ----------------------------------------------------------------------
 
-    inline bool SeqdbIteratorBase::suitable_entry() const
+    inline bool SeqdbFilter::name_candidate_entry(size_t& aEntryNo, size_t aNumberOfEntries) const
     {
-        auto const & entry = seqdb().mEntries[mEntryNo];
-        return (mSubtype.empty() || entry.mVirusType == mSubtype)
-                && (mLineage.empty() || entry.mLineage == mLineage)
-                && (mContinent.empty() || entry.mContinent == mContinent)
-                && (mCountry.empty() || entry.mCountry == mCountry)
-                && entry.date_within_range(mBegin, mEnd)
-                ;
+        if (mNameMatcher && mNameCandidates) {
+            if (const auto candidate = std::lower_bound(mNameCandidates->begin(), mNameCandidates->end(), seq_ref_t{aEntryNo, 0}); candidate != mNameCandidates->end())
+                aEntryNo = candidate->first;
+            else
+                aEntryNo = aNumberOfEntries;
+        }
+        return aEntryNo < aNumberOfEntries;
 
-    } // SeqdbIterator::suitable_entry
+    } // SeqdbFilter::name_candidate_entry
 
 // ----------------------------------------------------------------------
 
-    inline bool SeqdbIteratorBase::suitable_seq() const
+    template <typename Modifier> inline SeqdbIteratorBase& SeqdbIteratorBase::modify_filter(Modifier aModifier)
     {
-        auto const & seq = seqdb().mEntries[mEntryNo].mSeq[mSeqNo];
-        return (!mAligned || seq.aligned())
-                && (mGene.empty() || seq.mGene == mGene)
-                && (!mHasHiName || !seq.mHiNames.empty())
-                && (mLab.empty() || seq.has_lab(mLab))
-                && (mLabId.first.empty() || seq.match_labid(mLabId.first, mLabId.second))
-                && (mClade.empty() || seq.has_clade(mClade))
-                && (!mNameMatcherSet || std::regex_search(make_name(), mNameMatcher))
-                ;
+        auto filter = mFilter ? std::make_shared<SeqdbFilter>(*mFilter) : std::make_shared<SeqdbFilter>();
+        aModifier(*filter);
+        filter->prepare(seqdb());
+        mFilter = std::move(filter);
+        if (!at_end())
+            settle();
+        return *this;
+
+    } // SeqdbIteratorBase::modify_filter
+
+// ----------------------------------------------------------------------
 
-    } // SeqdbIterator::suitable_seq
+    inline const SeqdbEntry& SeqdbIteratorBase::entry() const
+    {
+        return seqdb().mEntries[mEntryNo];
+
+    } // SeqdbIteratorBase::entry
+
+// ----------------------------------------------------------------------
+
+    inline SeqdbEntrySeq SeqdbIteratorBase::entry_seq() const
+    {
+        validate();
+        return SeqdbEntrySeq(entry(), entry().mSeq[mSeqNo]);
+
+    } // SeqdbIteratorBase::entry_seq
+
+// ----------------------------------------------------------------------
+
+    inline bool SeqdbIteratorBase::valid() const
+    {
+        return mEntryNo < seqdb().mEntries.size() && mSeqNo < entry().mSeq.size();
+
+    } // SeqdbIteratorBase::valid
+
+// ----------------------------------------------------------------------
+
+      // stays at the current position if it is valid and passes the filter, otherwise moves to the next suitable sequence
+    inline void SeqdbIteratorBase::settle()
+    {
+        if (mEntryNo < seqdb().mEntries.size() && suitable_entry()) {
+            if (mSeqNo < entry().mSeq.size() && suitable_seq())
+                return;
+            if (next_seq())
+                return;
+        }
+        next_entry();
+
+    } // SeqdbIteratorBase::settle
 
 // ----------------------------------------------------------------------
 
     inline bool SeqdbIteratorBase::next_seq()
     {
-        auto const & entry = seqdb().mEntries[mEntryNo];
+        const auto& seqs = entry().mSeq;
         ++mSeqNo;
-        while (mSeqNo < entry.mSeq.size() && !suitable_seq())
+        while (mSeqNo < seqs.size() && !suitable_seq())
             ++mSeqNo;
-        return mSeqNo < entry.mSeq.size();
+        return mSeqNo < seqs.size();
 
-    } // SeqdbIterator::next_seq
+    } // SeqdbIteratorBase::next_seq
 
 // ----------------------------------------------------------------------
 
     inline void SeqdbIteratorBase::next_entry()
     {
+        const auto number_of_entries = seqdb().mEntries.size();
         while (true) {
             ++mEntryNo;
-            while (mEntryNo < seqdb().mEntries.size() && !suitable_entry())
+            while ((!mFilter || mFilter->name_candidate_entry(mEntryNo, number_of_entries)) && mEntryNo < number_of_entries && !suitable_entry())
                 ++mEntryNo;
-            if (mEntryNo >= seqdb().mEntries.size()) {
+            if (mEntryNo >= number_of_entries) {
+                if (mFilter && mFilter->report_plan())
+                    std::cerr << mFilter->plan()->report();
                 end();
                 break;
             }
@@ -713,32 +961,40 @@ namespace seqdb
             }
         }
 
-    } // SeqdbIterator::next_entry
+    } // SeqdbIteratorBase::next_entry
 
 // ----------------------------------------------------------------------
 
     inline SeqdbIteratorBase& SeqdbIteratorBase::operator ++ ()
     {
-        if (!next_seq()) {
+        if (!at_end() && !next_seq())
             next_entry();
-        }
         return *this;
 
-    } // SeqdbIterator::operator ++
+    } // SeqdbIteratorBase::operator ++
 
 // ----------------------------------------------------------------------
 
     template <typename Value> std::deque<std::vector<SeqdbEntrySeq>> Seqdb::find_identical_sequences(Value value) const
     {
         std::vector<SeqdbEntrySeq> refs(begin(), end());
-        sort(refs.begin(), refs.end(), [&value](const auto& a, const auto b) { return value(a) < value(b); });
-        std::deque<std::vector<SeqdbEntrySeq>> identical = {{}};
-        for (auto previous = refs.begin(), current = previous + 1; current != refs.end(); ++current) {
-            if (value(*previous) == value(*current)) {
-                if (!value(*previous).empty()) { // empty means not aligned, ignore them
+          // values are computed once per sequence in parallel, value() (e.g. aligned nucleotides) may be costly
+        std::vector<std::pair<std::decay_t<std::invoke_result_t<Value, const SeqdbEntrySeq&>>, SeqdbEntrySeq>> keyed(refs.size());
+        parallel_for(refs.size(), [&refs, &keyed, &value](size_t first, size_t last, size_t /*thread_no*/) {
+            for (size_t no = first; no < last; ++no)
+                keyed[no] = {value(refs[no]), refs[no]};
+        });
+        std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::deque<std::vector<SeqdbEntrySeq>> identical;
+        if (keyed.empty())
+            return identical;
+        identical.emplace_back();
+        for (auto previous = keyed.begin(), current = previous + 1; current != keyed.end(); ++current) {
+            if (previous->first == current->first) {
+                if (!previous->first.empty()) { // empty means not aligned, ignore them
                     if (identical.back().empty())
-                        identical.back().push_back(*previous);
-                    identical.back().push_back(*current);
+                        identical.back().push_back(previous->second);
+                    identical.back().push_back(current->second);
                 }
             }
             else {
@@ -753,6 +1009,50 @@ namespace seqdb
 
     } // Seqdb::find_identical_sequences
 
+// ----------------------------------------------------------------------
+
+    template <typename Fn> size_t Seqdb::parallel_scan(const SeqdbFilter& aFilter, Fn aFn) const
+    {
+        SeqdbFilter filter{aFilter};
+        filter.prepare(*this, false); // predicate timings would be updated concurrently
+        const auto threads = parallel_for(mEntries.size(), [this, &filter, &aFn](size_t first, size_t last, size_t thread_no) {
+            for (size_t entry_no = first; entry_no < last; ++entry_no) {
+                const auto& entry = mEntries[entry_no];
+                if (filter.suitable_entry(entry)) {
+                    for (size_t seq_no = 0; seq_no < entry.mSeq.size(); ++seq_no) {
+                        if (filter.suitable_seq(entry, entry.mSeq[seq_no], entry_no, seq_no))
+                            aFn(thread_no, SeqdbEntrySeq(entry, entry.mSeq[seq_no]));
+                    }
+                }
+            }
+        });
+        if (filter.report_plan())
+            std::cerr << filter.plan()->report();
+        return threads;
+
+    } // Seqdb::parallel_scan
+
+// ----------------------------------------------------------------------
+
+    template <typename Fn> inline void Seqdb::parallel_for_each(const SeqdbFilter& aFilter, Fn aFn) const
+    {
+        parallel_scan(aFilter, [&aFn](size_t /*thread_no*/, SeqdbEntrySeq entry_seq) { aFn(entry_seq); });
+
+    } // Seqdb::parallel_for_each
+
+// ----------------------------------------------------------------------
+
+    template <typename T, typename Map, typename Combine> T Seqdb::parallel_reduce(const SeqdbFilter& aFilter, T aInit, Map aMap, Combine aCombine) const
+    {
+        std::vector<T> accumulators(parallel_threads(), aInit);
+        const auto threads = parallel_scan(aFilter, [&accumulators, &aMap](size_t thread_no, SeqdbEntrySeq entry_seq) { aMap(accumulators[thread_no], entry_seq); });
+        T result = std::move(accumulators.front());
+        for (size_t thread_no = 1; thread_no < threads; ++thread_no)
+            aCombine(result, std::move(accumulators[thread_no]));
+        return result;
+
+    } // Seqdb::parallel_reduce
+
 // ----------------------------------------------------------------------
 
     enum class ignore_errors { no, yes };
@@ -791,7 +1091,7 @@ inline std::ostream& operator<<(std::ostream& out, const seqdb::SeqdbEntry& entr
         out << " {";
         if (!seq.reassortant().empty())
             out << 'R' << seq.reassortant().size() << seq.reassortant() << " ";
-        out << seq.passages().size() << seq.passages() << " #" << seq.cdcids().size() << seq.cdcids() << '}';
+        out << seq.passages().size() << seq.passages() << " #" << seq.cdcids_ref().size() << seq.cdcids_ref() << '}';
     }
     return out;
 }
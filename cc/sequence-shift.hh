@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <string>
 #include <limits>
+#include <optional>
 
 // ----------------------------------------------------------------------
 
@@ -36,6 +37,8 @@ namespace seqdb
 
         bool aligned() const { return mShift != NotAligned && mShift != AlignmentFailed /* && mShift != SequenceTooShort */; }
         bool alignment_failed() const { return mShift == AlignmentFailed; }
+          // non-throwing variant of operator ShiftT() for bulk loops, nullopt if not aligned
+        std::optional<ShiftT> value_opt() const noexcept { if (aligned()) return mShift; return std::nullopt; }
 
         operator ShiftT() const
             {
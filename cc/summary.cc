@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <lzma.h>
+
+#include "seqdb/summary.hh"
+#include "seqdb/seqdb.hh"
+
+using namespace seqdb;
+
+// ----------------------------------------------------------------------
+
+static constexpr const std::string_view SEQDB_SUMMARY_VERSION{"seqdb-summary-v2"}; // v2: year only and unrecognized dates are kept as they are, entries without seqs are counted
+
+static std::string read_header(std::string_view aFilename);
+static std::optional<std::string> extract_json_string(std::string_view aSource, std::string_view aKey);
+static std::vector<std::string_view> split(std::string_view aSource, char aSeparator);
+static size_t to_size(std::string_view aSource);
+
+// ----------------------------------------------------------------------
+
+const std::vector<group_keys_t>& SeqdbSummary::groupings()
+{
+    static const std::vector<group_keys_t> groupings{
+        {group_key::subtype, group_key::lineage},
+        {group_key::subtype, group_key::aligned},
+        {group_key::subtype, group_key::hi_matched},
+        {group_key::subtype, group_key::has_date},
+        {group_key::subtype, group_key::has_clades},
+        {group_key::subtype, group_key::lineage, group_key::month, group_key::hi_matched},
+        {group_key::subtype, group_key::lineage, group_key::clade},
+        {group_key::subtype, group_key::lineage, group_key::clade_set},
+    };
+    return groupings;
+
+} // SeqdbSummary::groupings
+
+// ----------------------------------------------------------------------
+
+SeqdbSummary::SeqdbSummary(const Seqdb& aSeqdb)
+    : mEntries(aSeqdb.number_of_entries()), mTables(aSeqdb.group_by(groupings()))
+{
+} // SeqdbSummary::SeqdbSummary
+
+// ----------------------------------------------------------------------
+
+const GroupByTable& SeqdbSummary::table(const group_keys_t& aKeys) const
+{
+    if (const auto found = std::find_if(mTables.begin(), mTables.end(), [&aKeys](const auto& table) { return table.keys() == aKeys; }); found != mTables.end())
+        return *found;
+    throw std::runtime_error("SeqdbSummary: no table for the requested keys");
+
+} // SeqdbSummary::table
+
+// ----------------------------------------------------------------------
+
+bool SeqdbSummary::current_version(std::string_view aSource)
+{
+    return aSource.substr(0, aSource.find('\n')) == SEQDB_SUMMARY_VERSION;
+
+} // SeqdbSummary::current_version
+
+// ----------------------------------------------------------------------
+
+  // version line, "entries\t<number>", then for each table "table\t<key>\t<key>..." followed by
+  // rows "<value>\t<value>...\t<entries>\t<seqs>"
+std::string SeqdbSummary::to_string() const
+{
+    std::ostringstream os;
+    os << SEQDB_SUMMARY_VERSION << '\n' << "entries\t" << mEntries << '\n';
+    for (const auto& table : mTables) {
+        os << "table";
+        for (const auto key : table.keys())
+            os << '\t' << seqdb::to_string(key);
+        os << '\n';
+        for (const auto& row : table) {
+            for (size_t key_no = 0; key_no < table.keys().size(); ++key_no)
+                os << table.value(row, key_no) << '\t';
+            os << row.entries << '\t' << row.seqs << '\n';
+        }
+    }
+    return os.str();
+
+} // SeqdbSummary::to_string
+
+// ----------------------------------------------------------------------
+
+SeqdbSummary SeqdbSummary::from_string(std::string_view aSource)
+{
+    SeqdbSummary summary;
+    const auto lines = split(aSource, '\n');
+    if (lines.empty() || lines.front() != SEQDB_SUMMARY_VERSION)
+        throw std::runtime_error("SeqdbSummary: unsupported summary version");
+    for (auto line = std::next(lines.begin()); line != lines.end(); ++line) {
+        if (line->empty())
+            continue;
+        const auto fields = split(*line, '\t');
+        if (fields.front() == "entries" && fields.size() == 2) {
+            summary.mEntries = to_size(fields[1]);
+        }
+        else if (fields.front() == "table") {
+            group_keys_t keys;
+            std::transform(std::next(fields.begin()), fields.end(), std::back_inserter(keys), &group_key_from_string);
+            summary.mTables.emplace_back(keys);
+        }
+        else if (!summary.mTables.empty() && fields.size() == (summary.mTables.back().keys().size() + 2)) {
+            summary.mTables.back().add(std::vector<std::string_view>(fields.begin(), fields.end() - 2), to_size(fields[fields.size() - 2]), to_size(fields.back()));
+        }
+        else
+            throw std::runtime_error("SeqdbSummary: cannot parse line: \"" + std::string{*line} + "\"");
+    }
+    for (const auto& keys : groupings())
+        summary.table(keys);    // throws if summary has no such table
+    return summary;
+
+} // SeqdbSummary::from_string
+
+// ----------------------------------------------------------------------
+
+std::string SeqdbSummary::report() const
+{
+      // entries having at least one seq with the second key "yes", by subtype
+    const auto having = [this](group_key aKey) {
+        const auto& source = table({group_key::subtype, aKey});
+        std::map<std::string, size_t> result;
+        for (const auto& row : source) {
+            if (source.value(row, 1) == "yes")
+                result[std::string{source.value(row, 0)}] += row.entries;
+        }
+        return result;
+    };
+
+    const auto& subtype_lineage = table({group_key::subtype, group_key::lineage});
+    std::ostringstream os;
+    os << "Entries: " << mEntries << '\n';
+    os << "Virus types: " << subtype_lineage.entries_by(0) << '\n';
+    os << "Lineages: " << subtype_lineage.entries_by(1) << '\n';
+    os << "Aligned: " << having(group_key::aligned) << '\n';
+    os << "Matched: " << having(group_key::hi_matched) << '\n';
+    os << "Have dates: " << having(group_key::has_date) << '\n';
+    os << "Have clades: " << having(group_key::has_clades) << '\n';
+    return os.str();
+
+} // SeqdbSummary::report
+
+// ----------------------------------------------------------------------
+
+std::optional<SeqdbSummary> seqdb::read_summary(std::string_view aFilename)
+{
+    if (const auto source = extract_json_string(read_header(aFilename), "  summary"); source.has_value() && SeqdbSummary::current_version(*source))
+        return SeqdbSummary::from_string(*source);
+    return std::nullopt;
+
+} // seqdb::read_summary
+
+// ----------------------------------------------------------------------
+
+  // Returns the beginning of the file (decompressed if it is xz) up to and including the "data" key.
+  // Fields written before "data" (version, date, summary, indel masters) are small, the data section is not read.
+static std::string read_header(std::string_view aFilename)
+{
+    constexpr const size_t chunk_size = 64 * 1024;
+    constexpr const std::string_view data_key{"\"data\""};
+
+    std::ifstream input{std::string{aFilename}, std::ios::binary};
+    if (!input)
+        throw std::runtime_error("cannot open " + std::string{aFilename});
+    std::array<char, chunk_size> buffer;
+    const auto read_chunk = [&input, &buffer]() -> size_t { input.read(buffer.data(), buffer.size()); return static_cast<size_t>(input.gcount()); };
+
+    std::string header;
+      // returns true when data key is found
+    const auto append = [&header, data_key](const char* data, size_t size) -> bool {
+        const auto search_from = header.size() > data_key.size() ? header.size() - data_key.size() : 0;
+        header.append(data, size);
+        if (const auto found = header.find(data_key, search_from); found != std::string::npos) {
+            header.resize(found + data_key.size());
+            return true;
+        }
+        return false;
+    };
+
+    size_t size = read_chunk();
+    if (size >= 6 && std::memcmp(buffer.data(), "\xFD" "7zXZ\0", 6) == 0) {
+        lzma_stream stream = LZMA_STREAM_INIT;
+        if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+            throw std::runtime_error("lzma decoder initialization failed");
+        std::array<char, chunk_size> output;
+        stream.next_in = reinterpret_cast<const uint8_t*>(buffer.data());
+        stream.avail_in = size;
+        lzma_action action = LZMA_RUN;
+        for (bool found = false; !found; ) {
+            if (stream.avail_in == 0 && action == LZMA_RUN) {
+                size = read_chunk();
+                stream.next_in = reinterpret_cast<const uint8_t*>(buffer.data());
+                stream.avail_in = size;
+                if (size == 0)
+                    action = LZMA_FINISH;
+            }
+            stream.next_out = reinterpret_cast<uint8_t*>(output.data());
+            stream.avail_out = output.size();
+            const auto result = lzma_code(&stream, action);
+            if (result != LZMA_OK && result != LZMA_STREAM_END) {
+                lzma_end(&stream);
+                throw std::runtime_error("cannot decompress " + std::string{aFilename} + ": lzma error " + std::to_string(result));
+            }
+            found = append(output.data(), output.size() - stream.avail_out);
+            if (result == LZMA_STREAM_END)
+                break;
+        }
+        lzma_end(&stream);
+    }
+    else {
+        for (bool found = append(buffer.data(), size); !found && size > 0; found = append(buffer.data(), size))
+            size = read_chunk();
+    }
+    return header;
+
+} // read_header
+
+// ----------------------------------------------------------------------
+
+  // finds "aKey": "value" in aSource and returns unescaped value, nullopt if key was not found
+static std::optional<std::string> extract_json_string(std::string_view aSource, std::string_view aKey)
+{
+    const auto key_pos = aSource.find("\"" + std::string{aKey} + "\"");
+    if (key_pos == std::string_view::npos)
+        return std::nullopt;
+    auto pos = aSource.find_first_not_of(" \t\n\r:", key_pos + aKey.size() + 2);
+    if (pos == std::string_view::npos || aSource[pos] != '"')
+        return std::nullopt;
+
+    std::string result;
+    for (++pos; pos < aSource.size() && aSource[pos] != '"'; ++pos) {
+        if (aSource[pos] != '\\') {
+            result.append(1, aSource[pos]);
+            continue;
+        }
+        if (++pos >= aSource.size())
+            break;
+        switch (aSource[pos]) {
+          case 'n': result.append(1, '\n'); break;
+          case 't': result.append(1, '\t'); break;
+          case 'r': result.append(1, '\r'); break;
+          case 'b': result.append(1, '\b'); break;
+          case 'f': result.append(1, '\f'); break;
+          case 'u':
+              if (pos + 4 < aSource.size()) {
+                  const auto code = std::stoul(std::string{aSource.substr(pos + 1, 4)}, nullptr, 16);
+                  if (code < 0x80) {
+                      result.append(1, static_cast<char>(code));
+                  }
+                  else if (code < 0x800) {
+                      result.append(1, static_cast<char>(0xC0 | (code >> 6)));
+                      result.append(1, static_cast<char>(0x80 | (code & 0x3F)));
+                  }
+                  else {
+                      result.append(1, static_cast<char>(0xE0 | (code >> 12)));
+                      result.append(1, static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                      result.append(1, static_cast<char>(0x80 | (code & 0x3F)));
+                  }
+                  pos += 4;
+              }
+              break;
+          default: result.append(1, aSource[pos]); break; // \" \\ \/
+        }
+    }
+    if (pos >= aSource.size())
+        throw std::runtime_error("unterminated string value of \"" + std::string{aKey} + "\" in seqdb header");
+    return result;
+
+} // extract_json_string
+
+// ----------------------------------------------------------------------
+
+  // empty fields are kept
+static std::vector<std::string_view> split(std::string_view aSource, char aSeparator)
+{
+    std::vector<std::string_view> result;
+    for (size_t start = 0; start <= aSource.size(); ) {
+        const auto end = std::min(aSource.find(aSeparator, start), aSource.size());
+        result.push_back(aSource.substr(start, end - start));
+        start = end + 1;
+    }
+    return result;
+
+} // split
+
+// ----------------------------------------------------------------------
+
+static size_t to_size(std::string_view aSource)
+{
+    const std::string source{aSource};
+    char* end = nullptr;
+    const auto value = std::strtoull(source.c_str(), &end, 10);
+    if (source.empty() || end != source.c_str() + source.size())
+        throw std::runtime_error("SeqdbSummary: invalid number: \"" + source + "\"");
+    return static_cast<size_t>(value);
+
+} // to_size
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
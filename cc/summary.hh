@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+
+#include "seqdb/group-by.hh"
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+    class Seqdb;
+
+      // Aggregates computed when seqdb is saved and stored in the "  summary" field of the file
+      // header, before the data section. read_summary() gets them without reading the data.
+    class SeqdbSummary
+    {
+     public:
+        SeqdbSummary(const Seqdb& aSeqdb);
+        static SeqdbSummary from_string(std::string_view aSource); // throws std::runtime_error
+          // summaries saved by other versions are not used, they are computed from data instead
+        static bool current_version(std::string_view aSource);
+        std::string to_string() const;
+
+        size_t number_of_entries() const { return mEntries; }
+          // table of the grouping with exactly these keys, aKeys must be one of groupings()
+        const GroupByTable& table(const group_keys_t& aKeys) const;
+        static const std::vector<group_keys_t>& groupings();
+
+          // text of Seqdb::report()
+        std::string report() const;
+
+        bool operator==(const SeqdbSummary& aNother) const { return mEntries == aNother.mEntries && mTables == aNother.mTables; }
+        bool operator!=(const SeqdbSummary& aNother) const { return !operator==(aNother); }
+
+     private:
+        SeqdbSummary() = default;
+
+        size_t mEntries = 0;
+        std::vector<GroupByTable> mTables; // in the order of groupings()
+
+    }; // class SeqdbSummary
+
+      // Reads the summary from the header of seqdb file (.json or .json.xz), decompressing just
+      // the part before the data section. Returns nullopt if the file was saved without summary or with summary of another version.
+    std::optional<SeqdbSummary> read_summary(std::string_view aFilename);
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
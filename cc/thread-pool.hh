@@ -0,0 +1,93 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+// ----------------------------------------------------------------------
+
+namespace seqdb
+{
+      // number of threads to use, aThreads == 0 means the number of hardware threads
+    inline size_t parallel_threads(size_t aThreads = 0)
+    {
+        if (aThreads == 0)
+            aThreads = std::max(1U, std::thread::hardware_concurrency());
+        return aThreads;
+
+    } // parallel_threads
+
+// ----------------------------------------------------------------------
+
+      // Calls aFn(first, last, thread_no) for consecutive chunks of [0, aSize) on up to aThreads threads
+      // (the calling thread is one of them, thread_no is in [0, number of threads)). Threads claim chunks
+      // from a shared counter: a thread that finished its chunk takes the next unclaimed one, so a few
+      // costly chunks do not leave other threads idle. The first exception thrown by aFn stops claiming
+      // of new chunks and is rethrown in the calling thread after all threads finished. If a thread cannot
+      // be started, the ones started are joined and the error (std::system_error) is rethrown.
+      // Returns the number of threads used.
+    template <typename Fn> size_t parallel_for(size_t aSize, Fn aFn, size_t aThreads = 0)
+    {
+        constexpr const size_t chunks_per_thread = 16;
+        const size_t threads = std::max(size_t{1}, std::min(parallel_threads(aThreads), aSize));
+        if (threads == 1) {
+            if (aSize > 0)
+                aFn(size_t{0}, aSize, size_t{0});
+            return 1;
+        }
+
+        const size_t chunk = std::max(size_t{1}, aSize / (threads * chunks_per_thread));
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex error_access;
+
+        auto worker = [&](size_t thread_no) {
+            try {
+                for (size_t first = next.fetch_add(chunk); first < aSize && !failed; first = next.fetch_add(chunk))
+                    aFn(first, std::min(first + chunk, aSize), thread_no);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_access);
+                if (!error)
+                    error = std::current_exception();
+                failed = true;
+            }
+        };
+
+        {
+              // started workers are joined when leaving the scope, also if starting another one throws
+              // (destroying joinable std::thread calls std::terminate), failed makes them stop claiming chunks then
+            struct join_t
+            {
+                std::vector<std::thread>& workers;
+                ~join_t() { for (auto& thread : workers) thread.join(); }
+            };
+            std::vector<std::thread> workers;
+            join_t join{workers};
+            workers.reserve(threads - 1);
+            try {
+                for (size_t thread_no = 1; thread_no < threads; ++thread_no)
+                    workers.emplace_back(worker, thread_no);
+            }
+            catch (...) {
+                failed = true;
+                throw;
+            }
+            worker(0);
+        }
+        if (error)
+            std::rethrow_exception(error);
+        return threads;
+
+    } // parallel_for
+
+} // namespace seqdb
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
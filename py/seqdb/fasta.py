@@ -11,6 +11,7 @@ import logging; module_logger = logging.getLogger(__name__)
 from acmacs_base.files import read_text, write_binary
 from acmacs_base.encode_name import encode
 from . import normalize
+from seqdb_backend import SeqdbFilter, classify_sequence, normalize_sequence
 
 # ======================================================================
 
@@ -143,7 +144,9 @@ def export_from_seqdb(seqdb, filename, output_format, amino_acids, lab, virus_ty
         sequences = base_seqs + sequences
 
     if include_seq:
-        include_seqs = [get_sequence(make_entry(e1), left_part_size) for seq in include_seq for e1 in seqdb.iter_seq().filter_name_regex(seq)]
+        include_matches = [[] for seq in include_seq]
+        seqdb.shared_scan([(SeqdbFilter().filter_name_regex(seq), matches.append) for seq, matches in zip(include_seq, include_matches)])
+        include_seqs = [get_sequence(make_entry(e1), left_part_size) for matches in include_matches for e1 in matches]
         module_logger.info('include_seqs:\n  {}'.format("\n  ".join(ss["n"] for ss in include_seqs)))
         include_seqs = list(filter(lambda e1: not seq_present(seqs=sequences, e1=e1), include_seqs)) # remove already present sequences
         sequences.extend(include_seqs)
@@ -198,13 +201,13 @@ def hamming_distance(s1, s2, n1, n2):
 # ----------------------------------------------------------------------
 
 def read_from_file(filename):
-    """Yields tuple (name, sequence) for each entry in the file"""
+    """Yields tuple (name, sequence, quality) for each entry in the file, quality is SequenceClass returned by classify_sequence()"""
     yield from read_from_string(read_text(filename), filename)
 
 # ----------------------------------------------------------------------
 
 def read_from_string(source, filename):
-    """Yields tuple (name, sequence) for each entry in the string"""
+    """Yields tuple (name, sequence, quality) for each entry in the string, quality is SequenceClass returned by classify_sequence()"""
     sequence = []
     name = None
 
@@ -213,26 +216,25 @@ def read_from_string(source, filename):
             pass
         elif line[0] == '>':
             if name or sequence:
-                yield (name, _check_sequence("".join(sequence), name, filename, line_no))
+                yield (name, *_check_sequence(normalize_sequence("".join(sequence)), name, filename, line_no))
             sequence = []
             name = line[1:].strip()
         else:
             if not name:
                 raise FastaReaderError('{filename}:{line_no}: sequence without name'.format(filename=filename, line_no=line_no))
-            sequence.append(line.replace("/", "-").upper()) # / found in H1pdm sequences
+            sequence.append(line)
     if name:
-        yield (name, _check_sequence("".join(sequence), name, filename, line_no))
+        yield (name, *_check_sequence(normalize_sequence("".join(sequence)), name, filename, line_no))
 
 # ----------------------------------------------------------------------
 
-sReSequence = re.compile(r"^[A-Za-z\-~:\*\.]+$")
-
 def _check_sequence(sequence, name, filename, line_no):
     if not sequence:
         raise FastaReaderError('{filename}:{line_no}: {name!r} without sequence'.format(name=name, filename=filename, line_no=line_no))
-    if not sReSequence.match(sequence):
+    quality = classify_sequence(sequence)
+    if not quality.valid:
         raise FastaReaderError('{filename}:{line_no}: invalid sequence read: {sequence}'.format(sequence=sequence, filename=filename, line_no=line_no))
-    return sequence
+    return sequence, quality
 
 # ----------------------------------------------------------------------
 
@@ -250,28 +252,28 @@ def detect_reassortant(entry):
 # ----------------------------------------------------------------------
 
 def read_fasta(fasta_file):
-    """Returns list of dict {"name":, "sequence":}"""
+    """Returns list of dict {"name":, "sequence":, "quality":}"""
 
-    def make_entry(raw_name, sequence):
-        entry = {"sequence": sequence, "name": raw_name.upper()}
+    def make_entry(raw_name, sequence, quality):
+        entry = {"sequence": sequence, "quality": quality, "name": raw_name.upper()}
         detect_reassortant(entry)
         return entry
 
-    r = [make_entry(raw_name, sequence) for raw_name, sequence in read_from_string(read_text(fasta_file), fasta_file)]
+    r = [make_entry(raw_name, sequence, quality) for raw_name, sequence, quality in read_from_string(read_text(fasta_file), fasta_file)]
     module_logger.debug('{} sequences imported from {}'.format(len(r), fasta_file))
     return r
 
 # ----------------------------------------------------------------------
 
 def read_fasta_with_name_parsing(fasta_file, lab, virus_type, **_):
-    """Returns list of dict {"name":, "sequence":, "date":, "lab":}"""
+    """Returns list of dict {"name":, "sequence":, "quality":, "date":, "lab":}"""
     np = name_parser()
 
-    def make_entry(raw_name, sequence):
+    def make_entry(raw_name, sequence, quality):
         n_entry = np.parse(raw_name, lab=lab)
         if not n_entry:
             raise RuntimeError("Cannot parse name: {!r}".format(raw_name))
-        entry = {"sequence": sequence, "lab": lab, "virus_type": virus_type}
+        entry = {"sequence": sequence, "quality": quality, "lab": lab, "virus_type": virus_type}
         entry.update(n_entry)
         for f in ["name", "passage", "lab_id", "virus_type", "lineage"]:
             if entry.get(f):
@@ -280,7 +282,7 @@ def read_fasta_with_name_parsing(fasta_file, lab, virus_type, **_):
         return entry
 
     # module_logger.info(f'reading {fasta_file}')
-    r = [make_entry(raw_name, sequence) for raw_name, sequence in read_from_string(read_text(fasta_file), fasta_file)]
+    r = [make_entry(raw_name, sequence, quality) for raw_name, sequence, quality in read_from_string(read_text(fasta_file), fasta_file)]
     module_logger.info('{} sequences imported from {}'.format(len(r), fasta_file))
     return r
 
@@ -33,7 +33,7 @@ class FastaReaderWithCSV:
         self.csv_fields = None
         self.not_found_in_csv = 0
         name_data = {entry['fasta_id']: entry for entry in (self.read_csv_entry(csv_entry, csv_f.name) for csv_entry in csv.reader(csv_f)) if entry}
-        r = [self._update_entry(e) for e in (self.name_extract_from_csv(raw_name=raw_name, sequence=sequence, name_data=name_data) for raw_name, sequence in fasta_m.read_from_string(fasta_f.read(), fasta_f.name)) if e]
+        r = [self._update_entry(e) for e in (self.name_extract_from_csv(raw_name=raw_name, sequence=sequence, name_data=name_data) for raw_name, sequence, _ in fasta_m.read_from_string(fasta_f.read(), fasta_f.name)) if e]
         module_logger.debug('{} sequences imported ({} ignored) from {} {}'.format(len(r), self.not_found_in_csv, fasta_f.name, self.csv_name))
         return r
 
@@ -7,13 +7,18 @@ import os, re, pprint
 import logging; module_logger = logging.getLogger(__name__)
 from pathlib import Path
 from acmacs_base.files import backup_file
-from . import Seqdb, setup_dbs, fasta as fasta_m
+from . import Seqdb, setup_dbs, align_cache_open, align_cache_save, align_cache_report, fasta as fasta_m
 
 # ----------------------------------------------------------------------
 
-def create(seqdb_filename, fasta_files, db_dir, match_hidb, add_clades, save, report_all_passages, report_identical, report_not_aligned_prefixes, save_not_found_locations_to=None, verbose=False):
+def create(seqdb_filename, fasta_files, db_dir, match_hidb, add_clades, save, report_all_passages, report_identical, report_not_aligned_prefixes, save_not_found_locations_to=None, verbose=False, align_cache_filename=None):
+    """align_cache_filename: results of aligning sequences are taken from and added to this file, None: seqdb-align-cache.xz next to seqdb, empty string: no cache"""
     if db_dir is not None:
         setup_dbs(db_dir=db_dir, verbose=verbose)
+    if align_cache_filename is None:
+        align_cache_filename = str(Path(seqdb_filename).with_name("seqdb-align-cache.xz"))
+    if align_cache_filename:
+        align_cache_open(filename=align_cache_filename)
     db = Seqdb()
     db_updater = SeqdbUpdater(db, filename=seqdb_filename, load=False)
     for filename in fasta_files:
@@ -23,6 +28,9 @@ def create(seqdb_filename, fasta_files, db_dir, match_hidb, add_clades, save, re
         # pprint.pprint(data)
         db_updater.add(data)
     module_logger.info('Sequences: {} Entries: {}'.format(db.number_of_seqs(), db.number_of_entries()))
+    if align_cache_filename:
+        module_logger.info(align_cache_report())
+        align_cache_save()
     db_updater.detect_insertions_deletions()
     db_updater.detect_b_lineage()
     if report_all_passages:
@@ -32,7 +40,7 @@ def create(seqdb_filename, fasta_files, db_dir, match_hidb, add_clades, save, re
         db_updater.match_hidb(save_not_found_locations_to=save_not_found_locations_to, verbose=verbose)
         db.build_hi_name_index()          # to report duplicates
     if add_clades:
-        db_updater.add_clades()               # clades must be updated after matching with hidb, because matching provides info about B lineage
+        db_updater.add_clades(verbose=verbose) # clades must be updated after matching with hidb, because matching provides info about B lineage
     # print(db.report())
     if report_identical:
         print(db.report_identical())
@@ -66,9 +74,12 @@ class SeqdbUpdater:
     #     self.hidb = hidb
 
     def add(self, data):
-        """data is list of dicts {"date":, "lab":, "name":, "passage":, "reassortant":, "sequence":, "virus_type":, "gene":}"""
+        """data is list of dicts {"date":, "lab":, "name":, "passage":, "reassortant":, "sequence":, "quality":, "virus_type":, "gene":}, quality (SequenceClass) is optional"""
         num_added = 0
         errors = False
+        quality = [entry["quality"] for entry in data if entry.get("quality")]
+        if quality:
+            module_logger.info('Sequences with ambiguous symbols: {} with gaps: {} with stops: {} (of {})'.format(sum(1 for q in quality if q.ambiguous), sum(1 for q in quality if q.gaps), sum(1 for q in quality if q.stops), len(quality)))
         for entry in data:
             if entry.get("name"):
                 entry["name"] = self.fix_name(entry["name"])
@@ -78,7 +89,7 @@ class SeqdbUpdater:
                 if entry.get("reassortant"):
                     entry["reassortant"] = reassortant(entry["reassortant"])
                 # annotatitions?
-                module_logger.debug('before add_sequence {}'.format({k:v for k,v in entry.items() if k != "sequence"}))
+                module_logger.debug('before add_sequence {}'.format({k:v for k,v in entry.items() if k not in ["sequence", "quality"]}))
                 try:
                     message = self.seqdb.add_sequence(name=entry["name"], virus_type=entry.get("virus_type", ""), lineage=entry.get("lineage", ""),
                                             lab=entry.get("lab", ""), date=entry.get("date", ""), lab_id=entry.get("lab_id", ""),
@@ -97,15 +108,18 @@ class SeqdbUpdater:
                 module_logger.warning('Cannot add entry without name: {}'.format(entry["lab_id"]))
         if errors:
             raise RuntimeError("Errors while adding sequences")
+        messages = self.seqdb.align_by_reference()   # fallback for sequences not having alignment signatures
+        if messages:
+            module_logger.warning(messages)
         self.seqdb.report_not_aligned_after_adding()   # before doing cleanup!
         messages = self.seqdb.cleanup(remove_short_sequences=True)
         if messages:
             module_logger.warning(messages)
 
-    def add_clades(self):
+    def add_clades(self, verbose=False):
+        """recomputes clades of the sequences changed since the last update, resets seqdb indexes if any clade changed"""
         if self.seqdb.number_of_seqs():
-            for entry_seq in self.seqdb.iter_seq():
-                entry_seq.seq.update_clades(virus_type=entry_seq.entry.virus_type, lineage=entry_seq.entry.lineage, name=entry_seq.make_name())
+            self.seqdb.update_clades(verbose=verbose)
 
     def match_hidb(self, save_not_found_locations_to=None, verbose=False):
         self.seqdb.remove_hi_names()
@@ -118,8 +132,9 @@ class SeqdbUpdater:
             else:
                 module_logger.warning('Not found locations ({}):\n  {}'.format(len(not_found_locations), "\n  ".join(not_found_locations)))
 
-    def detect_insertions_deletions(self):
-        self.seqdb.detect_insertions_deletions()
+    def detect_insertions_deletions(self, force=False):
+        """just new and realigned sequences are checked unless force"""
+        self.seqdb.detect_insertions_deletions(force=force)
 
     def detect_b_lineage(self):
         self.seqdb.detect_b_lineage()